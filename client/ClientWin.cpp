@@ -28,14 +28,16 @@ extern Display *maindpy;
 
 ClientWin::ClientWin(int dpynum_, Window window_, int drawMethod_,
 	bool stereo_) : drawMethod(drawMethod_), reqDrawMethod(drawMethod_),
-	fb(NULL), cfindex(0), deadYet(false), thread(NULL), stereo(stereo_)
+	fb(NULL), cfindex(0), deadYet(false), thread(NULL), stereo(stereo_),
+	pending(0), directBytes(0)
 {
 	if(dpynum_ < 0 || dpynum_ > 65535 || !window_)
 		throw(Error("ClientWin::ClientWin()", "Invalid argument"));
 	dpynum = dpynum_;  window = window_;
 
 	#ifdef USEXV
-	for(int i = 0; i < NFRAMES; i++) xvframes[i] = NULL;
+	for(int i = 0; i < NXVFRAMES; i++) xvframes[i] = NULL;
+	xvindex = 0;
 	#endif
 	if(drawMethod == RR_DRAWAUTO) drawMethod = RR_DRAWX11;
 	if(stereo) drawMethod = RR_DRAWOGL;
@@ -54,7 +56,7 @@ ClientWin::~ClientWin(void)
 	if(thread) thread->stop();
 	delete fb;  fb = NULL;
 	#ifdef USEXV
-	for(int i = 0; i < NFRAMES; i++)
+	for(int i = 0; i < NXVFRAMES; i++)
 	{
 		if(xvframes[i])
 		{
@@ -150,19 +152,22 @@ Frame *ClientWin::getFrame(bool useXV)
 	#ifdef USEXV
 	if(useXV)
 	{
-		if(!xvframes[cfindex])
+		if(!xvframes[xvindex])
 		{
 			char dpystr[80];
 			sprintf(dpystr, ":%d.0", dpynum);
-			xvframes[cfindex] = new XVFrame(dpystr, window);
-			if(!xvframes[cfindex]) THROW("Could not allocate class instance");
+			xvframes[xvindex] = new XVFrame(dpystr, window);
+			if(!xvframes[xvindex]) THROW("Could not allocate class instance");
 		}
-		f = (Frame *)xvframes[cfindex];
+		f = (Frame *)xvframes[xvindex];
+		xvindex = (xvindex + 1) % NXVFRAMES;
 	}
 	else
 	#endif
-	f = (Frame *)&cframes[cfindex];
-	cfindex = (cfindex + 1) % NFRAMES;
+	{
+		f = (Frame *)&cframes[cfindex];
+		cfindex = (cfindex + 1) % NFRAMES;
+	}
 	cfmutex.unlock();
 	f->waitUntilComplete();
 	if(thread) thread->checkError();
@@ -193,14 +198,102 @@ void ClientWin::drawFrame(Frame *f)
 			initX11();
 		}
 	}
+	{
+		CriticalSection::SafeLock l(mutex);
+		pending++;
+	}
 	q.add(f);
 }
 
 
+// If the tile described by h contains pixels in the pixel format of the
+// window's X image, and all previously queued tiles have been drawn, then
+// lock the X image and return the address of the tile's bottom row within it,
+// along with the (negative) pitch needed to receive the tile's bottom-up rows
+// directly into the X image.  Otherwise, return NULL, in which case the tile
+// must be received into a tile buffer and queued as usual.  If this method
+// returns non-NULL, then endDirectTile() must be called once the tile has been
+// received.
+
+unsigned char *ClientWin::beginDirectTile(rrframeheader &h, PF *pf,
+	int &pitch)
+{
+	if(thread) thread->checkError();
+	if(h.flags != 0 || h.compress != RRCOMP_RGB || h.subsamp != RR_NATIVEPF
+		|| !pf)
+		return NULL;
+
+	mutex.lock();
+	try
+	{
+		if(pending == 0 && fb && !fb->isGL && !stereo)
+		{
+			FBXFrame *fbx = (FBXFrame *)fb;
+			fbx->init(h);
+			if(fbx->pf == pf && fbx->bits && h.x + h.width <= fbx->hdr.framew
+				&& h.y + h.height <= fbx->hdr.frameh)
+			{
+				pitch = -fbx->pitch;
+				return &fbx->bits[fbx->pitch * (h.y + h.height - 1) + h.x * pf->size];
+			}
+		}
+	}
+	catch(...)
+	{
+		mutex.unlock();  throw;
+	}
+	mutex.unlock();
+	return NULL;
+}
+
+
+void ClientWin::endDirectTile(rrframeheader &h)
+{
+	directBytes += h.size;
+	mutex.unlock();
+}
+
+
+// Returns true if the tile or end-of-frame marker at batch[index] will be
+// completely overwritten by a later frame in the batch whose tiles have all
+// been received.  Decoding or drawing it would thus be wasted effort.
+
+bool ClientWin::isSuperseded(Frame **batch, int nBatch, int index)
+{
+	Frame *f = batch[index];
+	int i = index, start;
+
+	while(i < nBatch && batch[i]->hdr.flags != RR_EOF) i++;
+	for(start = ++i; i < nBatch; i++)
+	{
+		Frame *f2 = batch[i];
+		if(f2->hdr.flags != RR_EOF) continue;
+		// batch[start] through batch[i] is a complete later frame.
+		if(f2->isXV == f->isXV && f2->hdr.framew == f->hdr.framew
+			&& f2->hdr.frameh == f->hdr.frameh)
+		{
+			if(f->hdr.flags == RR_EOF) return true;
+			for(int j = start; j < i; j++)
+			{
+				Frame *tile = batch[j];
+				if(tile->isXV == f->isXV && tile->hdr.flags == f->hdr.flags
+					&& tile->hdr.x == f->hdr.x && tile->hdr.y == f->hdr.y
+					&& tile->hdr.width == f->hdr.width
+					&& tile->hdr.height == f->hdr.height)
+					return true;
+			}
+		}
+		start = i + 1;
+	}
+	return false;
+}
+
+
 void ClientWin::run(void)
 {
 	Profiler pt("Total     "), pb("Blit      "), pd("Decompress");
-	Frame *f = NULL;  long bytes = 0;
+	Frame *f = NULL, *batch[NFRAMES + NXVFRAMES];  long bytes = 0;
+	int nBatch = 0, i;
 
 	try
 	{
@@ -210,54 +303,79 @@ void ClientWin::run(void)
 			q.get(&ftemp);  f = (Frame *)ftemp;  if(deadYet) break;
 			if(!f)
 				throw(Error("ClientWin::run()", "Invalid image received from queue"));
-			CriticalSection::SafeLock l(mutex);
-			#ifdef USEXV
-			if(f->isXV)
+			// Take any other tiles that are already waiting, so that tiles from
+			// frames that have fallen behind can be skipped.
+			batch[0] = f;  nBatch = 1;
+			while(nBatch < NFRAMES + NXVFRAMES)
 			{
-				if(f->hdr.flags != RR_EOF)
-				{
-					pb.startFrame();
-					((XVFrame *)f)->redraw();
-					pb.endFrame(f->hdr.width * f->hdr.height, 0, 1);
-					pt.endFrame(f->hdr.width * f->hdr.height, bytes, 1);
-					bytes = 0;
-					pt.startFrame();
-				}
+				ftemp = NULL;
+				q.get(&ftemp, true);  if(!ftemp) break;
+				batch[nBatch++] = (Frame *)ftemp;
 			}
-			else
-			#endif
+
+			for(i = 0; i < nBatch; i++)
 			{
-				if(f->hdr.flags == RR_EOF)
+				f = batch[i];
+				if(isSuperseded(batch, nBatch, i))
+				{
+					if(f->isXV != (f->hdr.flags == RR_EOF)) pt.dropFrame();
+					batch[i] = NULL;  f->signalComplete();
+					CriticalSection::SafeLock l(mutex);
+					pending--;
+					continue;
+				}
+				CriticalSection::SafeLock l(mutex);
+				pending--;
+				#ifdef USEXV
+				if(f->isXV)
 				{
-					pb.startFrame();
-					if(fb->isGL) ((GLFrame *)fb)->init(f->hdr, stereo);
-					else ((FBXFrame *)fb)->init(f->hdr);
-					if(fb->isGL) ((GLFrame *)fb)->redraw();
-					else ((FBXFrame *)fb)->redraw();
-					pb.endFrame(fb->hdr.framew * fb->hdr.frameh, 0, 1);
-					pt.endFrame(fb->hdr.framew * fb->hdr.frameh, bytes, 1);
-					bytes = 0;
-					pt.startFrame();
+					if(f->hdr.flags != RR_EOF)
+					{
+						pb.startFrame();
+						((XVFrame *)f)->redraw();
+						pb.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+						pt.endFrame(f->hdr.width * f->hdr.height, bytes, 1);
+						bytes = 0;
+						pt.startFrame();
+					}
 				}
 				else
+				#endif
 				{
-					pd.startFrame();
-					if(fb->isGL) *((GLFrame *)fb) = *((CompressedFrame *)f);
-					else *((FBXFrame *)fb) = *((CompressedFrame *)f);
-					pd.endFrame(f->hdr.width * f->hdr.height, 0,
-						(double)(f->hdr.width * f->hdr.height) /
-							(double)(f->hdr.framew * f->hdr.frameh));
-					bytes += f->hdr.size;
+					if(f->hdr.flags == RR_EOF)
+					{
+						bytes += directBytes;  directBytes = 0;
+						pb.startFrame();
+						if(fb->isGL) ((GLFrame *)fb)->init(f->hdr, stereo);
+						else ((FBXFrame *)fb)->init(f->hdr);
+						if(fb->isGL) ((GLFrame *)fb)->redraw();
+						else ((FBXFrame *)fb)->redraw();
+						pb.endFrame(fb->hdr.framew * fb->hdr.frameh, 0, 1);
+						pt.endFrame(fb->hdr.framew * fb->hdr.frameh, bytes, 1);
+						bytes = 0;
+						pt.startFrame();
+					}
+					else
+					{
+						pd.startFrame();
+						if(fb->isGL) *((GLFrame *)fb) = *((CompressedFrame *)f);
+						else *((FBXFrame *)fb) = *((CompressedFrame *)f);
+						pd.endFrame(f->hdr.width * f->hdr.height, 0,
+							(double)(f->hdr.width * f->hdr.height) /
+								(double)(f->hdr.framew * f->hdr.frameh));
+						bytes += f->hdr.size;
+					}
 				}
+				batch[i] = NULL;  f->signalComplete();
 			}
-			f->signalComplete();
 		}
 
 	}
 	catch(std::exception &e)
 	{
 		if(thread) thread->setError(e);
-		if(f) f->signalComplete();
+		for(i = 0; i < nBatch; i++)
+			if(batch[i]) batch[i]->signalComplete();
 		throw;
 	}
 }
@@ -33,6 +33,8 @@ namespace client
 			virtual ~ClientWin(void);
 			common::Frame *getFrame(bool useXV);
 			void drawFrame(common::Frame *f);
+			unsigned char *beginDirectTile(rrframeheader &h, PF *pf, int &pitch);
+			void endDirectTile(rrframeheader &h);
 			int match(int dpynum, Window window);
 			bool isStereo(void) { return stereo; }
 
@@ -40,13 +42,19 @@ namespace client
 
 			void initGL(void);
 			void initX11(void);
+			bool isSuperseded(common::Frame **batch, int nBatch, int index);
 
 			int drawMethod, reqDrawMethod;
-			static const int NFRAMES = 2;
+			// A frame is usually split into many tiles, so provide enough tile
+			// buffers that the listener thread can keep draining the socket while
+			// the previous frame is being decoded.
+			static const int NFRAMES = 16;
+			// YUV frames are not split into tiles.
+			static const int NXVFRAMES = 4;
 			common::Frame *fb;
 			common::CompressedFrame cframes[NFRAMES];  int cfindex;
 			#ifdef USEXV
-			common::XVFrame *xvframes[NFRAMES];
+			common::XVFrame *xvframes[NXVFRAMES];  int xvindex;
 			#endif
 			util::GenericQ q;
 			bool deadYet;
@@ -56,6 +64,11 @@ namespace client
 			util::CriticalSection cfmutex;
 			bool stereo;
 			util::CriticalSection mutex;
+			// The number of tiles and end-of-frame markers that have been queued
+			// but not yet drawn, and the number of bytes that were received
+			// directly into the X image since the last frame was drawn (both
+			// protected by mutex)
+			int pending;  long directBytes;
 	};
 }
 
@@ -36,6 +36,50 @@ static unsigned short DisplayNumber(Display *dpy)
 }
 
 
+// Return the pixel format of X images with the default visual of the
+// specified display, or NULL if the pixel format cannot be used for native RGB
+// tiles
+
+static PF *getNativePF(Display *dpy)
+{
+	int screen = DefaultScreen(dpy);
+	Visual *vis = DefaultVisual(dpy, screen);
+	XImage *xi = NULL;
+	PF *nativePF = NULL;
+
+	if(vis->c_class != TrueColor) return NULL;
+	if((xi = XCreateImage(dpy, vis, DefaultDepth(dpy, screen), ZPixmap, 0, NULL,
+		1, 1, 32, 0)) == NULL)
+		return NULL;
+	unsigned long rmask = xi->red_mask, gmask = xi->green_mask,
+		bmask = xi->blue_mask;
+	int ps = xi->bits_per_pixel / 8;
+	if((xi->byte_order == MSBFirst && LittleEndian())
+		|| (xi->byte_order == LSBFirst && !LittleEndian()))
+	{
+		if(ps == 4)
+		{
+			rmask = BYTESWAP(rmask);  gmask = BYTESWAP(gmask);
+			bmask = BYTESWAP(bmask);
+		}
+		else
+		{
+			rmask = BYTESWAP24(rmask);  gmask = BYTESWAP24(gmask);
+			bmask = BYTESWAP24(bmask);
+		}
+	}
+	XDestroyImage(xi);
+	for(int i = 0; i < PIXELFORMATS; i++)
+	{
+		PF *pf = pf_get(i);
+		if(rmask == pf->rmask && gmask == pf->gmask && bmask == pf->bmask
+			&& ps == pf->size && pf->bpc == 8)
+			nativePF = pf;
+	}
+	return nativePF;
+}
+
+
 #define ENDIANIZE(h) \
 { \
 	if(!LittleEndian()) \
@@ -67,6 +111,33 @@ static unsigned short DisplayNumber(Display *dpy)
 	} \
 }
 
+#define ENDIANIZE_DGRAM(h) \
+{ \
+	if(!LittleEndian()) \
+	{ \
+		h.frameid = BYTESWAP(h.frameid); \
+		h.tileid = BYTESWAP16(h.tileid); \
+		h.frag = BYTESWAP16(h.frag); \
+		h.nfrags = BYTESWAP16(h.nfrags); \
+		h.len = BYTESWAP16(h.len); \
+		h.token = BYTESWAP(h.token); \
+	} \
+}
+
+#define ENDIANIZE_REFRESH(r) \
+{ \
+	if(!LittleEndian()) \
+	{ \
+		r.frameid = BYTESWAP(r.frameid); \
+		r.winid = BYTESWAP(r.winid); \
+		r.framew = BYTESWAP16(r.framew); \
+		r.frameh = BYTESWAP16(r.frameh); \
+		r.len = BYTESWAP16(r.len); \
+	} \
+}
+
+#define TILEMAPSIZE  ((RR_DGRAMEOF + 7) / 8)
+
 #define CONVERT_HEADER(h1, h) \
 { \
 	h.size = h1.size; \
@@ -134,7 +205,7 @@ void VGLTransReceiver::run(void)
 			socket = listenSocket->accept();  if(deadYet) break;
 			vglout.println("++ %sConnection from %s.", doSSL ? "SSL " : "",
 				socket->remoteName());
-			listener = new Listener(socket, drawMethod);
+			listener = new Listener(socket, drawMethod, ipv6);
 			continue;
 		}
 		catch(std::exception &e)
@@ -179,12 +250,25 @@ void VGLTransReceiver::Listener::run(void)
 			recv((char *)&v, sizeof_rrversion);
 			if(strncmp(v.id, "VGL", 3) || v.major < 1)
 				THROW("Error reading server version");
+			if(v.major > 2 || (v.major == 2 && v.minor >= 3))
+			{
+				// Images drawn using OpenGL are always packed RGB, so it is pointless
+				// to ask the server for native RGB tiles.
+				unsigned char id = RR_NATIVEPF;
+				if(drawMethod != RR_DRAWOGL) nativePF = getNativePF(maindpy);
+				if(nativePF) id = nativePF->id;
+				send((char *)&id, 1);
+			}
 		}
 
 		char *env = NULL;
 		if((env = getenv("VGL_VERBOSE")) != NULL && strlen(env) > 0
 			&& !strncmp(env, "1", 1))
+		{
 			vglout.println("Server version: %d.%d", v.major, v.minor);
+			if(nativePF)
+				vglout.println("Native pixel format: %s", nativePF->name);
+		}
 		vglout.flush();
 
 		while(1)
@@ -205,6 +289,10 @@ void VGLTransReceiver::Listener::run(void)
 				{
 					recv((char *)&h, sizeof_rrframeheader);
 					ENDIANIZE(h);
+					if(h.flags == RR_UDP)
+					{
+						initUDP();  continue;
+					}
 				}
 				bool stereo = (h.flags == RR_LEFT || h.flags == RR_RIGHT);
 				unsigned short dpynum =
@@ -212,6 +300,31 @@ void VGLTransReceiver::Listener::run(void)
 					h.dpynum : DisplayNumber(maindpy);
 				ERRIFNOT(w = addWindow(dpynum, h.winid, stereo));
 
+				// If possible, receive native RGB tiles directly into the window's
+				// X image rather than into a tile buffer.
+				if(nativePF && h.flags == 0 && h.compress == RRCOMP_RGB
+					&& h.subsamp == RR_NATIVEPF)
+				{
+					unsigned char *dst = NULL;  int pitch = 0;
+					if(h.size != (unsigned int)h.width * h.height * nativePF->size)
+						THROW("Native RGB tile size mismatch");
+					try
+					{
+						dst = w->beginDirectTile(h, nativePF, pitch);
+					}
+					catch(...) { if(w) deleteWindow(w);  throw; }
+					if(dst)
+					{
+						try
+						{
+							recv((char *)dst, h.width * nativePF->size, pitch, h.height);
+						}
+						catch(...) { w->endDirectTile(h);  throw; }
+						w->endDirectTile(h);
+						f = NULL;  continue;
+					}
+				}
+
 				if(!stereo || h.flags == RR_LEFT || !f)
 				{
 					try
@@ -229,7 +342,7 @@ void VGLTransReceiver::Listener::run(void)
 				}
 				else
 				#endif
-				((CompressedFrame *)f)->init(h, h.flags);
+				((CompressedFrame *)f)->init(h, h.flags, nativePF);
 				if(h.flags != RR_EOF)
 					recv((char *)(h.flags == RR_RIGHT ? f->rbits : f->bits), h.size);
 
@@ -332,3 +445,345 @@ void VGLTransReceiver::Listener::recv(char *buf, int len)
 		throw;
 	}
 }
+
+
+void VGLTransReceiver::Listener::recv(char *buf, int rowLen, int pitch,
+	int rows)
+{
+	try
+	{
+		if(socket) socket->recv(buf, rowLen, pitch, rows);
+	}
+	catch(...)
+	{
+		vglout.println("Error receiving data from server.  Server may have disconnected.");
+		vglout.println("   (this is normal if the application exited.)");
+		throw;
+	}
+}
+
+
+void VGLTransReceiver::Listener::initUDP(void)
+{
+	unsigned short port = 0;
+
+	if(!udpListener)
+	{
+		try
+		{
+			udpListener = new UDPListener(this, ipv6);
+		}
+		catch(std::exception &e)
+		{
+			vglout.println("Could not set up UDP mode-- %s", e.what());
+		}
+	}
+	if(udpListener) port = udpListener->getPort();
+	if(port) vglout.println("++ Using UDP port %d for %s", port,
+		remoteName ? remoteName : "server");
+	unsigned short portLE = port;
+	if(!LittleEndian()) portLE = BYTESWAP16(portLE);
+	send((char *)&portLE, 2);
+	if(!port) return;
+
+	// The server replies with the port from which it will send datagrams and
+	// the token that they will contain.
+	unsigned char reply[6];
+	recv((char *)reply, 6);
+	unsigned short serverPort = reply[0] | (reply[1] << 8);
+	unsigned int token = reply[2] | (reply[3] << 8) | (reply[4] << 16) |
+		((unsigned int)reply[5] << 24);
+	udpListener->setPeer(serverPort, token);
+}
+
+
+const double VGLTransReceiver::Listener::UDPListener::FRAMEDEADLINE = 0.1;
+
+
+VGLTransReceiver::Listener::UDPListener::UDPListener(Listener *parent_,
+	bool ipv6) : parent(parent_), socket(NULL), thread(NULL), deadYet(false),
+	port(0), token(0), frameID(0), inFrame(false), haveFrameID(false),
+	lastDgramTime(0.), tiles(NULL), nTiles(0), eofTile(NULL), tilesDrawn(NULL),
+	haveHeader(false)
+{
+	try
+	{
+		if(!(tilesDrawn = (unsigned char *)calloc(TILEMAPSIZE, 1)))
+			THROW("Memory allocation error");
+		socket = new UDPSocket(ipv6);
+		// Discard stray datagrams from hosts other than the server at the other
+		// end of the TCP connection.  Datagrams are authenticated (weakly) by
+		// the session token that the server sends over the TCP connection.
+		port = socket->bind(0, parent->remoteName);
+	}
+	catch(...)
+	{
+		free(tilesDrawn);  delete socket;
+		throw;
+	}
+	thread = new Thread(this);
+	thread->start();
+}
+
+
+VGLTransReceiver::Listener::UDPListener::~UDPListener(void)
+{
+	deadYet = true;
+	if(thread) { thread->stop();  delete thread;  thread = NULL; }
+	freeTiles();
+	free(tiles);  tiles = NULL;
+	free(tilesDrawn);  tilesDrawn = NULL;
+	delete socket;  socket = NULL;
+}
+
+
+void VGLTransReceiver::Listener::UDPListener::setPeer(unsigned short port_,
+	unsigned int token_)
+{
+	socket->setPeerPort(port_);
+	CriticalSection::SafeLock l(mutex);
+	token = token_;
+}
+
+
+void VGLTransReceiver::Listener::UDPListener::run(void)
+{
+	char buf[65536];
+
+	while(!deadYet)
+	{
+		try
+		{
+			int len = socket->recv(buf, 65536, FRAMEDEADLINE / 2.);
+			if(deadYet) break;
+			if(len > 0) processDgram(buf, len);
+			if(inFrame && GetTime() - lastDgramTime > FRAMEDEADLINE) endFrame();
+		}
+		catch(std::exception &e)
+		{
+			if(!deadYet) vglout.println("%s-- %s", GET_METHOD(e), e.what());
+		}
+	}
+}
+
+
+void VGLTransReceiver::Listener::UDPListener::processDgram(char *buf,
+	int len)
+{
+	rrdgramheader dh;  rrframeheader h;
+	const int headerSize = sizeof_rrdgramheader + sizeof_rrframeheader;
+
+	if(len < headerSize) return;
+	memcpy(&dh, buf, sizeof_rrdgramheader);
+	ENDIANIZE_DGRAM(dh);
+	memcpy(&h, &buf[sizeof_rrdgramheader], sizeof_rrframeheader);
+	ENDIANIZE(h);
+	if(dh.len > len - headerSize || dh.len > RR_DGRAMPAYLOAD || dh.nfrags == 0
+		|| dh.frag >= dh.nfrags)
+		return;
+	{
+		// Discard all datagrams until the server has sent the token.
+		CriticalSection::SafeLock l(mutex);
+		if(!token || dh.token != token) return;
+	}
+	if((dh.tileid == RR_DGRAMEOF) != (h.flags == RR_EOF)) return;
+
+	// Tiles from frames older than the newest one are useless.
+	if(haveFrameID && (int)(dh.frameid - frameID) < 0) return;
+	if(haveFrameID && dh.frameid != frameID) endFrame();
+	else if(haveFrameID && !inFrame) return;
+	if(!inFrame)
+	{
+		frameID = dh.frameid;  haveFrameID = true;  inFrame = true;
+		memset(tilesDrawn, 0, TILEMAPSIZE);
+	}
+	lastDgramTime = GetTime();
+
+	Tile *t = NULL;
+	if(dh.tileid == RR_DGRAMEOF)
+	{
+		if(!(t = getTile(eofTile, h, dh.nfrags))) return;
+	}
+	else
+	{
+		int index = 2 * dh.tileid + (h.flags == RR_RIGHT ? 1 : 0);
+		if(index >= nTiles)
+		{
+			Tile **newTiles = (Tile **)realloc(tiles, sizeof(Tile *) * (index + 1));
+			if(!newTiles) THROW("Memory allocation error");
+			tiles = newTiles;
+			memset(&tiles[nTiles], 0, sizeof(Tile *) * (index + 1 - nTiles));
+			nTiles = index + 1;
+		}
+		if(!(t = getTile(tiles[index], h, dh.nfrags))) return;
+		if(!haveHeader)
+		{
+			lastHeader = h;  haveHeader = true;
+		}
+	}
+
+	unsigned int offset = dh.frag * RR_DGRAMPAYLOAD;
+	if(t->fragRecv[dh.frag] || offset + dh.len > t->hdr.size) return;
+	memcpy(&t->bits[offset], &buf[headerSize], dh.len);
+	t->fragRecv[dh.frag] = 1;  t->fragsRecv++;
+	if(t->fragsRecv < t->nfrags) return;
+
+	if(dh.tileid == RR_DGRAMEOF) endFrame();
+	else drawTile(dh.tileid);
+}
+
+
+VGLTransReceiver::Listener::UDPListener::Tile *
+	VGLTransReceiver::Listener::UDPListener::getTile(Tile *&t,
+	rrframeheader &hdr, int nfrags)
+{
+	if(!t)
+	{
+		// Never trust the tile size in a datagram.  Reject any tile that would
+		// not fit in the buffer that CompressedFrame::init() allocates for it, so
+		// drawTile() cannot overflow that buffer.
+		if(hdr.flags == RR_EOF)
+		{
+			if(hdr.size > TILEMAPSIZE) return NULL;
+		}
+		else
+		{
+			if(hdr.compress != RRCOMP_RGB && hdr.compress != RRCOMP_JPEG)
+				return NULL;
+			if(hdr.compress == RRCOMP_RGB && hdr.subsamp == RR_NATIVEPF)
+			{
+				if(!parent->nativePF
+					|| hdr.size != (unsigned int)hdr.width * hdr.height *
+						parent->nativePF->size)
+					return NULL;
+			}
+			else
+			{
+				unsigned long maxSize = CompressedFrame::bufSize(hdr);
+				if(maxSize == 0 || maxSize == (unsigned long)-1 || hdr.size > maxSize)
+					return NULL;
+			}
+		}
+		int expectedFrags = (hdr.size + RR_DGRAMPAYLOAD - 1) / RR_DGRAMPAYLOAD;
+		if(expectedFrags < 1) expectedFrags = 1;
+		if(nfrags != expectedFrags) return NULL;
+		t = new Tile;
+		t->hdr = hdr;  t->nfrags = nfrags;  t->fragsRecv = 0;
+		t->bits = (unsigned char *)malloc(hdr.size > 0 ? hdr.size : 1);
+		t->fragRecv = (unsigned char *)calloc(nfrags, 1);
+		if(!t->bits || !t->fragRecv)
+		{
+			free(t->bits);  free(t->fragRecv);  delete t;  t = NULL;
+			THROW("Memory allocation error");
+		}
+	}
+	else if(t->nfrags != nfrags || t->hdr.size != hdr.size) return NULL;
+	return t;
+}
+
+
+void VGLTransReceiver::Listener::UDPListener::drawTile(int tileID)
+{
+	Tile *t = 2 * tileID < nTiles ? tiles[2 * tileID] : NULL;
+	Tile *rt = 2 * tileID + 1 < nTiles ? tiles[2 * tileID + 1] : NULL;
+
+	if(!t || t->fragsRecv < t->nfrags) return;
+	bool stereo = (t->hdr.flags == RR_LEFT);
+	if(stereo && (!rt || rt->fragsRecv < rt->nfrags)) return;
+	if(tilesDrawn[tileID / 8] & (1 << (tileID % 8))) return;
+
+	ClientWin *w = NULL;
+	ERRIFNOT(w = parent->addWindow(DisplayNumber(maindpy), t->hdr.winid,
+		stereo));
+	try
+	{
+		CompressedFrame *cf = (CompressedFrame *)w->getFrame(false);
+		cf->init(t->hdr, t->hdr.flags, parent->nativePF);
+		memcpy(cf->bits, t->bits, t->hdr.size);
+		if(stereo)
+		{
+			cf->init(rt->hdr, RR_RIGHT, parent->nativePF);
+			memcpy(cf->rbits, rt->bits, rt->hdr.size);
+		}
+		w->drawFrame(cf);
+	}
+	catch(...) { parent->deleteWindow(w);  throw; }
+	tilesDrawn[tileID / 8] |= (1 << (tileID % 8));
+}
+
+
+// Draw whatever tiles of the current frame arrived, and ask the server to
+// resend the ones that didn't.  If the end-of-frame marker was lost, then we
+// don't know which tiles were sent, so ask for the whole frame.
+
+void VGLTransReceiver::Listener::UDPListener::endFrame(void)
+{
+	unsigned char missing[TILEMAPSIZE];
+	rrframeheader h;  rrrefresh r;
+	int len = 0;
+
+	if(!inFrame) return;
+	inFrame = false;
+
+	bool haveEOF = eofTile && eofTile->fragsRecv == eofTile->nfrags;
+	if(haveEOF) h = eofTile->hdr;
+	else if(haveHeader) h = lastHeader;
+	else { freeTiles();  return; }
+	h.flags = RR_EOF;  h.size = 0;
+
+	try
+	{
+		ClientWin *w = NULL;
+		ERRIFNOT(w = parent->addWindow(DisplayNumber(maindpy), h.winid));
+		try
+		{
+			CompressedFrame *cf = (CompressedFrame *)w->getFrame(false);
+			cf->init(h, RR_EOF);
+			w->drawFrame(cf);
+		}
+		catch(...) { parent->deleteWindow(w);  throw; }
+
+		if(haveEOF)
+		{
+			int bitmapSize = min((int)eofTile->hdr.size, TILEMAPSIZE);
+			for(int i = 0; i < bitmapSize; i++)
+			{
+				missing[i] = eofTile->bits[i] & ~tilesDrawn[i];
+				if(missing[i]) len = i + 1;
+			}
+		}
+		if(!haveEOF || len > 0)
+		{
+			r.frameid = frameID;  r.winid = h.winid;
+			r.framew = h.framew;  r.frameh = h.frameh;
+			r.len = len;
+			ENDIANIZE_REFRESH(r);
+			parent->send((char *)&r, sizeof_rrrefresh);
+			if(len > 0) parent->send((char *)missing, len);
+		}
+	}
+	catch(...)
+	{
+		freeTiles();  throw;
+	}
+	freeTiles();
+}
+
+
+void VGLTransReceiver::Listener::UDPListener::freeTiles(void)
+{
+	for(int i = 0; i < nTiles; i++)
+	{
+		if(tiles[i])
+		{
+			free(tiles[i]->bits);  free(tiles[i]->fragRecv);
+			delete tiles[i];  tiles[i] = NULL;
+		}
+	}
+	if(eofTile)
+	{
+		free(eofTile->bits);  free(eofTile->fragRecv);
+		delete eofTile;  eofTile = NULL;
+	}
+	haveHeader = false;
+}
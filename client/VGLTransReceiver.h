@@ -16,6 +16,7 @@
 #define __VGLTRANSRECEIVER_H__
 
 #include "Socket.h"
+#include "UDPSocket.h"
 #include "ClientWin.h"
 #include "Log.h"
 
@@ -51,9 +52,9 @@ namespace client
 		{
 			public:
 
-				Listener(util::Socket *socket_, int drawMethod_) :
+				Listener(util::Socket *socket_, int drawMethod_, bool ipv6_) :
 					drawMethod(drawMethod_), nwin(0), socket(socket_), thread(NULL),
-					remoteName(NULL)
+					remoteName(NULL), ipv6(ipv6_), nativePF(NULL), udpListener(NULL)
 				{
 					memset(windows, 0, sizeof(ClientWin *) * MAXWIN);
 					if(socket) remoteName = socket->remoteName();
@@ -65,6 +66,7 @@ namespace client
 				{
 					int i;
 
+					delete udpListener;  udpListener = NULL;
 					winMutex.lock(false);
 					for(i = 0; i < nwin; i++)
 					{
@@ -79,10 +81,12 @@ namespace client
 
 				void send(char *buf, int len);
 				void recv(char *buf, int len);
+				void recv(char *buf, int rowLen, int pitch, int rows);
 
 			private:
 
 				void run(void);
+				void initUDP(void);
 
 				int drawMethod;
 				ClientWin *windows[MAXWIN];
@@ -93,6 +97,60 @@ namespace client
 				util::Socket *socket;
 				util::Thread *thread;
 				const char *remoteName;
+				bool ipv6;
+				// The pixel format that the server was told to use for native RGB
+				// tiles (protocol v2.3 and later)
+				PF *nativePF;
+
+			// Receives and reassembles tiles sent using the UDP mode of the VGL
+			// Transport, draws whatever tiles of the newest frame arrive, and asks
+			// the server to resend any tiles that were lost.
+			class UDPListener : public util::Runnable
+			{
+				public:
+
+					UDPListener(Listener *parent, bool ipv6);
+					virtual ~UDPListener(void);
+					unsigned short getPort(void) { return port; }
+					// Discard datagrams that do not originate from the specified port on
+					// the server or that do not contain the specified session token
+					void setPeer(unsigned short port, unsigned int token);
+
+				private:
+
+					typedef struct
+					{
+						rrframeheader hdr;
+						unsigned char *bits, *fragRecv;
+						int nfrags, fragsRecv;
+					} Tile;
+
+					void run(void);
+					void processDgram(char *buf, int len);
+					Tile *getTile(Tile *&t, rrframeheader &hdr, int nfrags);
+					void drawTile(int tileID);
+					void endFrame(void);
+					void freeTiles(void);
+
+					// Frames that have not received a datagram for this long (in seconds)
+					// are drawn with the tiles that have arrived.
+					static const double FRAMEDEADLINE;
+
+					Listener *parent;
+					util::UDPSocket *socket;
+					util::Thread *thread;
+					bool deadYet;
+					unsigned short port;
+					unsigned int token;  util::CriticalSection mutex;
+					unsigned int frameID;  bool inFrame, haveFrameID;
+					double lastDgramTime;
+					// Index 2 * tileID = left eye or mono, 2 * tileID + 1 = right eye
+					Tile **tiles;  int nTiles;
+					Tile *eofTile;
+					unsigned char *tilesDrawn;
+					bool haveHeader;  rrframeheader lastHeader;
+			};
+			UDPListener *udpListener;
 		};
 	};
 }
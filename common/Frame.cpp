@@ -39,7 +39,8 @@ static int tjpf[PIXELFORMATS] =
 // Uncompressed frame
 
 Frame::Frame(bool primary_) : bits(NULL), rbits(NULL), pitch(0), flags(0),
-	pf(pf_get(-1)), isGL(false), isXV(false), stereo(false), primary(primary_)
+	pf(pf_get(-1)), isGL(false), isXV(false), stereo(false), gammaLUT(NULL),
+	gammaLUT10(NULL), gammaLUT16(NULL), primary(primary_)
 {
 	memset(&hdr, 0, sizeof(rrframeheader));
 	ready.wait();
@@ -143,6 +144,17 @@ Frame *Frame::getTile(int x, int y, int width, int height)
 }
 
 
+bool Frame::isComparable(Frame *last)
+{
+	return last && hdr.width == last->hdr.width
+		&& hdr.height == last->hdr.height && hdr.framew == last->hdr.framew
+		&& hdr.frameh == last->hdr.frameh && hdr.qual == last->hdr.qual
+		&& hdr.subsamp == last->hdr.subsamp && pf->id == last->pf->id
+		&& pf->size == last->pf->size && hdr.winid == last->hdr.winid
+		&& hdr.dpynum == last->hdr.dpynum;
+}
+
+
 bool Frame::tileEquals(Frame *last, int x, int y, int width, int height)
 {
 	bool bu = (flags & FRAME_BOTTOMUP);
@@ -151,11 +163,7 @@ bool Frame::tileEquals(Frame *last, int x, int y, int width, int height)
 		|| (y + height) > hdr.height)
 		throw Error("Frame::tileEquals", "Argument out of range");
 
-	if(last && hdr.width == last->hdr.width && hdr.height == last->hdr.height
-		&& hdr.framew == last->hdr.framew && hdr.frameh == last->hdr.frameh
-		&& hdr.qual == last->hdr.qual && hdr.subsamp == last->hdr.subsamp
-		&& pf->id == last->pf->id && pf->size == last->pf->size
-		&& hdr.winid == last->hdr.winid && hdr.dpynum == last->hdr.dpynum)
+	if(isComparable(last))
 	{
 		if(bits && last->bits)
 		{
@@ -191,6 +199,128 @@ bool Frame::tileEquals(Frame *last, int x, int y, int width, int height)
 }
 
 
+void Frame::setGamma(unsigned char *lut, unsigned short *lut10,
+	unsigned short *lut16)
+{
+	gammaLUT = lut;  gammaLUT10 = lut10;  gammaLUT16 = lut16;
+	if(lut && lut10 && lut16) flags |= FRAME_GAMMA;
+	else flags &= ~FRAME_GAMMA;
+}
+
+
+// Apply any post-readback processing that was deferred (gamma correction
+// and/or the VirtualGL logo) to the specified tile, and compare the tile with
+// the same tile in the previous frame.  This is done one row at a time, so
+// each row is compared while it is still in the CPU cache.  Returns true if
+// last is non-NULL and the tile is identical to the same tile in last.
+
+bool Frame::postProcess(Frame *last, int x, int y, int width, int height)
+{
+	bool bu = (flags & FRAME_BOTTOMUP), equal = isComparable(last);
+
+	if(x < 0 || y < 0 || width < 1 || height < 1 || (x + width) > hdr.width
+		|| (y + height) > hdr.height)
+		throw Error("Frame::postProcess", "Argument out of range");
+
+	for(int buf = 0; buf < 2; buf++)
+	{
+		unsigned char *frameBits = buf ? rbits : bits, *lastBits = NULL;
+		if(!frameBits || (buf && !stereo)) continue;
+		if(equal) lastBits = buf ? last->rbits : last->bits;
+
+		for(int i = 0; i < height; i++)
+		{
+			int row = bu ? hdr.height - y - height + i : y + i;
+			unsigned char *ptr = &frameBits[pitch * row + pf->size * x];
+
+			if(flags & FRAME_GAMMA) gammaRow(ptr, width);
+			if(flags & FRAME_LOGO)
+				logoRow(ptr, x, bu ? hdr.height - row - 1 : row, width);
+			if(equal && lastBits && memcmp(ptr,
+				&lastBits[last->pitch * row + pf->size * x], pf->size * width))
+				equal = false;
+		}
+	}
+	return equal;
+}
+
+
+void Frame::gammaRow(unsigned char *ptr, int width)
+{
+	if(pf->bpc == 10)
+	{
+		unsigned int *pixel = (unsigned int *)ptr;
+		while(width--)
+		{
+			unsigned int r = gammaLUT10[(*pixel >> pf->rshift) & 1023];
+			unsigned int g = gammaLUT10[(*pixel >> pf->gshift) & 1023];
+			unsigned int b = gammaLUT10[(*pixel >> pf->bshift) & 1023];
+			*pixel++ = (r << pf->rshift) | (g << pf->gshift) | (b << pf->bshift);
+		}
+	}
+	else
+	{
+		// Correct two components at a time using the 16-bit lookup table
+		int n = width * pf->size;
+		if((size_t)ptr & 1)
+		{
+			*ptr = gammaLUT[*ptr];  ptr++;  n--;
+		}
+		unsigned short *ptr16 = (unsigned short *)ptr;
+		for(; n > 1; n -= 2, ptr16++) *ptr16 = gammaLUT16[*ptr16];
+		if(n)
+		{
+			ptr = (unsigned char *)ptr16;
+			*ptr = gammaLUT[*ptr];
+		}
+	}
+}
+
+
+// Draw the portion of the VirtualGL logo that intersects the specified row
+// segment.  y is the row number relative to the top of the frame.
+
+void Frame::logoRow(unsigned char *ptr, int x, int y, int width)
+{
+	int logoHeight = min(VGLLOGO_HEIGHT, hdr.height - 1);
+	int logoWidth = min(VGLLOGO_WIDTH, hdr.width - 1);
+	if(logoHeight < 1 || logoWidth < 1) return;
+	int logoX = hdr.width - logoWidth - 1, logoY = hdr.height - logoHeight - 1;
+	if(y < logoY || y >= logoY + logoHeight) return;
+	int startX = max(x, logoX), endX = min(x + width, logoX + logoWidth);
+	if(startX >= endX) return;
+
+	unsigned char *logoptr =
+		&vgllogo[(y - logoY) * VGLLOGO_WIDTH + startX - logoX];
+	ptr += (startX - x) * pf->size;
+	switch(pf->size)
+	{
+		case 3:
+			for(int i = startX; i < endX; i++, ptr += 3)
+			{
+				if(*(logoptr++))
+				{
+					ptr[pf->rindex] ^= 113;  ptr[pf->gindex] ^= 162;
+					ptr[pf->bindex] ^= 117;
+				}
+			}
+			break;
+		case 4:
+		{
+			unsigned int mask, *pixel = (unsigned int *)ptr;
+			pf->setRGB((unsigned char *)&mask, 113, 162, 117);
+			for(int i = startX; i < endX; i++, pixel++)
+			{
+				if(*(logoptr++)) *pixel ^= mask;
+			}
+			break;
+		}
+		default:
+			THROW("Invalid pixel format");
+	}
+}
+
+
 void Frame::makeAnaglyph(Frame &r, Frame &g, Frame &b)
 {
 	int i, j;
@@ -295,79 +425,29 @@ void Frame::decompressRGB(Frame &f, int width, int height, bool rightEye)
 	{
 		srcptr = &srcptr[(height - 1) * f.pitch];  srcStride = -srcStride;
 	}
-	pf_get(PF_RGB)->convert(srcptr, width, srcStride, height, dstptr, dstStride,
-		pf);
+	// If the tile is in the native pixel format of this frame, then this is
+	// just a row-by-row copy.
+	f.pf->convert(srcptr, width, srcStride, height, dstptr, dstStride, pf);
 }
 
 
-#define DRAWLOGO() \
-	switch(pf->size) \
-	{ \
-		case 3: \
-		{ \
-			for(int j = 0; j < height; j++, rowptr += stride) \
-			{ \
-				unsigned char *pixel = rowptr; \
-				logoptr2 = logoptr; \
-				for(int i = 0; i < width; i++, pixel += pf->size) \
-				{ \
-					if(*(logoptr2++)) \
-					{ \
-						pixel[pf->rindex] ^= 113;  pixel[pf->gindex] ^= 162; \
-						pixel[pf->bindex] ^= 117; \
-					} \
-				} \
-				logoptr += VGLLOGO_WIDTH; \
-			} \
-			break; \
-		} \
-		case 4: \
-		{ \
-			unsigned int mask; \
-			pf->setRGB((unsigned char *)&mask, 113, 162, 117); \
-			for(int j = 0; j < height; j++, rowptr += stride) \
-			{ \
-				unsigned int *pixel = (unsigned int *)rowptr; \
-				logoptr2 = logoptr; \
-				for(int i = 0; i < width; i++, pixel++) \
-				{ \
-					if(*(logoptr2++)) *pixel ^= mask; \
-				} \
-				logoptr += VGLLOGO_WIDTH; \
-			} \
-			break; \
-		} \
-		default: \
-			THROW("Invalid pixel format"); \
-	}
-
-
 void Frame::addLogo(void)
 {
-	unsigned char *rowptr, *logoptr = vgllogo, *logoptr2;
+	bool bu = (flags & FRAME_BOTTOMUP);
 
 	if(!bits || hdr.width < 1 || hdr.height < 1) return;
 
 	int height = min(VGLLOGO_HEIGHT, hdr.height - 1);
 	int width = min(VGLLOGO_WIDTH, hdr.width - 1);
-	int stride = flags & FRAME_BOTTOMUP ? -pitch : pitch;
 	if(height < 1 || width < 1) return;
-	if(flags & FRAME_BOTTOMUP)
-		rowptr = &bits[pitch * height + (hdr.width - width - 1) * pf->size];
-	else
-		rowptr = &bits[pitch * (hdr.height - height - 1) +
-			(hdr.width - width - 1) * pf->size];
-	DRAWLOGO()
-
-	if(!rbits) return;
-	logoptr = vgllogo;
-	if(flags & FRAME_BOTTOMUP)
-		rowptr = &rbits[pitch * height + (hdr.width - width - 1) * pf->size];
-	else
-		rowptr = &rbits[pitch * (hdr.height - height - 1) +
-			(hdr.width - width - 1) * pf->size];
-	logoptr = vgllogo;
-	DRAWLOGO()
+	int x = hdr.width - width - 1;
+
+	for(int y = hdr.height - height - 1; y < hdr.height - 1; y++)
+	{
+		int row = bu ? hdr.height - y - 1 : y;
+		logoRow(&bits[pitch * row + pf->size * x], x, y, width);
+		if(rbits) logoRow(&rbits[pitch * row + pf->size * x], x, y, width);
+	}
 }
 
 
@@ -401,7 +481,8 @@ void Frame::checkHeader(rrframeheader &h)
 
 // Compressed frame
 
-CompressedFrame::CompressedFrame(void) : Frame(), tjhnd(NULL)
+CompressedFrame::CompressedFrame(void) : Frame(), jpegOpt(RRJPEG_ACCURATEDCT),
+	tjhnd(NULL)
 {
 	if(!(tjhnd = tjInitCompress())) THROW(tjGetErrorStr());
 	pf = pf_get(PF_RGB);
@@ -450,8 +531,6 @@ void CompressedFrame::compressYUV(Frame &f)
 
 void CompressedFrame::compressJPEG(Frame &f)
 {
-	int tjflags = 0;
-
 	if(f.hdr.qual > 100 || f.hdr.subsamp > 16 || !IS_POW2(f.hdr.subsamp))
 		throw(Error("JPEG compressor", "Invalid argument"));
 	if(f.pf->bpc != 8)
@@ -459,24 +538,57 @@ void CompressedFrame::compressJPEG(Frame &f)
 			"JPEG compression requires 8 bits per component"));
 
 	init(f.hdr, f.stereo ? RR_LEFT : 0);
-	if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
-	unsigned long size;
-	TRY_TJ(tjCompress2(tjhnd, f.bits, f.hdr.width, f.pitch, f.hdr.height,
-		tjpf[f.pf->id], &bits, &size, TJSUBSAMP(f.hdr.subsamp), f.hdr.qual,
-		tjflags | TJFLAG_NOREALLOC));
-	hdr.size = (unsigned int)size;
+	encodeJPEG(f, f.bits, &bits, hdr.size);
 	if(f.stereo && f.rbits)
 	{
 		init(f.hdr, RR_RIGHT);
-		if(rbits)
-			TRY_TJ(tjCompress2(tjhnd, f.rbits, f.hdr.width, f.pitch, f.hdr.height,
-				tjpf[f.pf->id], &rbits, &size, TJSUBSAMP(f.hdr.subsamp), f.hdr.qual,
-				tjflags | TJFLAG_NOREALLOC));
-		rhdr.size = (unsigned int)size;
+		if(rbits) encodeJPEG(f, f.rbits, &rbits, rhdr.size);
 	}
 }
 
 
+// Huffman table optimization without progressive mode can only be requested
+// through the TurboJPEG 3 API, and progressive mode requires TurboJPEG 2.0 or
+// later.  With older versions of TurboJPEG, the unsupported options fall back
+// to baseline JPEG with the accurate DCT.
+
+void CompressedFrame::encodeJPEG(Frame &f, unsigned char *srcBits,
+	unsigned char **dstBits, unsigned int &size)
+{
+	#ifdef TJ_NUMINIT
+
+	size_t jpegSize = 0;
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_QUALITY, f.hdr.qual));
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_SUBSAMP, TJSUBSAMP(f.hdr.subsamp)));
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_BOTTOMUP,
+		(f.flags & FRAME_BOTTOMUP) ? 1 : 0));
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_NOREALLOC, 1));
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_FASTDCT, jpegOpt == RRJPEG_FASTDCT));
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_OPTIMIZE, jpegOpt == RRJPEG_OPTIMIZE));
+	TRY_TJ3(tjhnd, tj3Set(tjhnd, TJPARAM_PROGRESSIVE,
+		jpegOpt == RRJPEG_PROGRESSIVE));
+	TRY_TJ3(tjhnd, tj3Compress8(tjhnd, srcBits, f.hdr.width, f.pitch,
+		f.hdr.height, tjpf[f.pf->id], dstBits, &jpegSize));
+
+	#else
+
+	int tjflags = TJFLAG_NOREALLOC;
+	unsigned long jpegSize = 0;
+	if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
+	if(jpegOpt == RRJPEG_FASTDCT) tjflags |= TJFLAG_FASTDCT;
+	#ifdef TJFLAG_PROGRESSIVE
+	if(jpegOpt == RRJPEG_PROGRESSIVE) tjflags |= TJFLAG_PROGRESSIVE;
+	#endif
+	TRY_TJ(tjCompress2(tjhnd, srcBits, f.hdr.width, f.pitch, f.hdr.height,
+		tjpf[f.pf->id], dstBits, &jpegSize, TJSUBSAMP(f.hdr.subsamp), f.hdr.qual,
+		tjflags));
+
+	#endif
+
+	size = (unsigned int)jpegSize;
+}
+
+
 void CompressedFrame::compressRGB(Frame &f)
 {
 	unsigned char *srcptr;
@@ -486,55 +598,77 @@ void CompressedFrame::compressRGB(Frame &f)
 		throw(Error("RGB compressor",
 			"RGB encoding requires 8 bits per component"));
 
-	int dstPitch = f.hdr.width * 3;
+	// If the tile is tagged with RR_NATIVEPF, then its pixel format matches
+	// that of the client, and the rows are sent without converting them.
+	init(f.hdr, f.stereo ? RR_LEFT : 0, f.pf);
+	int dstPitch = f.hdr.width * pf->size;
 	int srcStride = bu ? f.pitch : -f.pitch;
-	init(f.hdr, f.stereo ? RR_LEFT : 0);
 	srcptr = bu ? f.bits : &f.bits[f.pitch * (f.hdr.height - 1)];
 	f.pf->convert(srcptr, f.hdr.width, srcStride, f.hdr.height, bits, dstPitch,
-		pf_get(PF_RGB));
+		pf);
 	hdr.size = dstPitch * f.hdr.height;
 
 	if(f.stereo && f.rbits)
 	{
-		init(f.hdr, RR_RIGHT);
+		init(f.hdr, RR_RIGHT, f.pf);
 		if(rbits)
 		{
 			srcptr = bu ? f.rbits : &f.rbits[f.pitch * (f.hdr.height - 1)];
 			f.pf->convert(srcptr, f.hdr.width, srcStride, f.hdr.height, rbits,
-				dstPitch, pf_get(PF_RGB));
+				dstPitch, pf);
 			rhdr.size = dstPitch * f.hdr.height;
 		}
 	}
 }
 
 
-void CompressedFrame::init(rrframeheader &h, int buffer)
+// RGB tiles are not compressed, so they can be larger than the worst-case
+// JPEG image.
+
+unsigned long CompressedFrame::bufSize(rrframeheader &h)
+{
+	if(h.compress == RRCOMP_RGB) return (unsigned long)h.width * h.height * 4;
+	return tjBufSize(h.width, h.height, h.subsamp);
+}
+
+
+void CompressedFrame::init(rrframeheader &h, int buffer, PF *nativePF)
 {
 	checkHeader(h);
 	if(h.flags == RR_EOF) { hdr = h;  return; }
+	pf = pf_get(PF_RGB);
+	if(h.compress == RRCOMP_RGB && h.subsamp == RR_NATIVEPF)
+	{
+		if(!nativePF || nativePF->bpc != 8 || nativePF->size < 3)
+			throw(Error("RGB decoder", "Invalid native pixel format"));
+		pf = nativePF;
+	}
 	switch(buffer)
 	{
 		case RR_LEFT:
-			if(h.width != hdr.width || h.height != hdr.height || !bits)
+			if(h.width != hdr.width || h.height != hdr.height
+				|| h.compress != hdr.compress || h.subsamp != hdr.subsamp || !bits)
 			{
 				delete [] bits;
-				bits = new unsigned char[tjBufSize(h.width, h.height, h.subsamp)];
+				bits = new unsigned char[bufSize(h)];
 			}
 			hdr = h;  hdr.flags = RR_LEFT;  stereo = true;
 			break;
 		case RR_RIGHT:
-			if(h.width != rhdr.width || h.height != rhdr.height || !rbits)
+			if(h.width != rhdr.width || h.height != rhdr.height
+				|| h.compress != rhdr.compress || h.subsamp != rhdr.subsamp || !rbits)
 			{
 				delete [] rbits;
-				rbits = new unsigned char[tjBufSize(h.width, h.height, h.subsamp)];
+				rbits = new unsigned char[bufSize(h)];
 			}
 			rhdr = h;  rhdr.flags = RR_RIGHT;  stereo = true;
 			break;
 		default:
-			if(h.width != hdr.width || h.height != hdr.height || !bits)
+			if(h.width != hdr.width || h.height != hdr.height
+				|| h.compress != hdr.compress || h.subsamp != hdr.subsamp || !bits)
 			{
 				delete [] bits;
-				bits = new unsigned char[tjBufSize(h.width, h.height, h.subsamp)];
+				bits = new unsigned char[bufSize(h)];
 			}
 			hdr = h;  hdr.flags = 0;  stereo = false;
 			break;
@@ -608,19 +742,21 @@ FBXFrame::~FBXFrame(void)
 void FBXFrame::init(rrframeheader &h)
 {
 	checkHeader(h);
-	int usexshm = 1;  char *env = NULL;
+	int flags = FBX_SHM;  char *env = NULL;
 	if((env = getenv("VGL_USEXSHM")) != NULL && strlen(env) > 0
 		&& !strcmp(env, "0"))
-		usexshm = 0;
+		flags &= ~FBX_SHM;
+	if((env = getenv("VGL_PRESENT")) != NULL && !strcmp(env, "1"))
+		flags |= FBX_PRESENT;
 	{
 		CriticalSection::SafeLock l(mutex);
-		TRY_FBX(fbx_init(&fb, wh, h.framew, h.frameh, usexshm));
+		TRY_FBX(fbx_init(&fb, wh, h.framew, h.frameh, flags));
 	}
 	if(h.framew > fb.width || h.frameh > fb.height)
 	{
 		XSync(wh.dpy, False);
 		CriticalSection::SafeLock l(mutex);
-		TRY_FBX(fbx_init(&fb, wh, h.framew, h.frameh, usexshm));
+		TRY_FBX(fbx_init(&fb, wh, h.framew, h.frameh, flags));
 	}
 	hdr = h;
 	if(hdr.framew > fb.width) hdr.framew = fb.width;
@@ -740,19 +876,23 @@ XVFrame &XVFrame::operator= (Frame &f)
 }
 
 
+// The XvImage is drawn asynchronously (see redraw()), so this waits until the
+// X server has finished reading the image before handing it out again.
+
 void XVFrame::init(rrframeheader &h)
 {
 	checkHeader(h);
 	{
 		CriticalSection::SafeLock l(mutex);
-		TRY_FBXV(fbxv_init(&fb, dpy, win, h.framew, h.frameh, I420_PLANAR, 0));
+		TRY_FBXV(fbxv_init(&fb, dpy, win, h.framew, h.frameh, I420_PLANAR, 1));
 	}
 	if(h.framew > fb.xvi->width || h.frameh > fb.xvi->height)
 	{
 		XSync(dpy, False);
 		CriticalSection::SafeLock l(mutex);
-		TRY_FBXV(fbxv_init(&fb, dpy, win, h.framew, h.frameh, I420_PLANAR, 0));
+		TRY_FBXV(fbxv_init(&fb, dpy, win, h.framew, h.frameh, I420_PLANAR, 1));
 	}
+	TRY_FBXV(fbxv_sync(&fb));
 	hdr = h;
 	if(hdr.framew > fb.xvi->width) hdr.framew = fb.xvi->width;
 	if(hdr.frameh > fb.xvi->height) hdr.frameh = fb.xvi->height;
@@ -762,9 +902,21 @@ void XVFrame::init(rrframeheader &h)
 }
 
 
+// If the MIT-SHM extension is available, then this returns as soon as the
+// request has been sent, and the X server scales and color-converts the image
+// while the next frame is being encoded into another XVFrame.
+
 void XVFrame::redraw(void)
 {
 	TRY_FBXV(fbxv_write(&fb, 0, 0, 0, 0, 0, 0, hdr.framew, hdr.frameh));
 }
 
+
+// Wait until the X server has finished drawing the frame
+
+void XVFrame::sync(void)
+{
+	TRY_FBXV(fbxv_sync(&fb));
+}
+
 #endif
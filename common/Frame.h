@@ -27,6 +27,13 @@
 
 // Flags
 #define FRAME_BOTTOMUP  1  // Bottom-up bitmap (as opposed to top-down)
+// Gamma correction has not yet been applied (see Frame::postProcess())
+#define FRAME_GAMMA  2
+// The VirtualGL logo has not yet been drawn (see Frame::postProcess())
+#define FRAME_LOGO  4
+// A copy of the frame should be saved once it has been compressed (see
+// server/FrameCapture.h)
+#define FRAME_CAPTURE  8
 
 
 // Uncompressed frame
@@ -46,6 +53,9 @@ namespace common
 			void deInit(void);
 			Frame *getTile(int x, int y, int width, int height);
 			bool tileEquals(Frame *last, int x, int y, int width, int height);
+			bool postProcess(Frame *last, int x, int y, int width, int height);
+			void setGamma(unsigned char *lut, unsigned short *lut10,
+				unsigned short *lut16);
 			void makeAnaglyph(Frame &r, Frame &g, Frame &b);
 			void makePassive(Frame &stf, int mode);
 			void signalReady(void) { ready.signal(); }
@@ -67,6 +77,12 @@ namespace common
 
 			void dumpHeader(rrframeheader &);
 			void checkHeader(rrframeheader &);
+			bool isComparable(Frame *last);
+			void gammaRow(unsigned char *ptr, int width);
+			void logoRow(unsigned char *ptr, int x, int y, int width);
+
+			unsigned char *gammaLUT;
+			unsigned short *gammaLUT10, *gammaLUT16;
 
 			util::Event ready;
 			util::Event complete;
@@ -90,12 +106,20 @@ namespace common
 			void compressYUV(Frame &f);
 			void compressJPEG(Frame &f);
 			void compressRGB(Frame &f);
-			void init(rrframeheader &h, int buffer);
+			void init(rrframeheader &h, int buffer, PF *nativePF = NULL);
+			// Returns the size of the buffer that init() allocates for a tile with
+			// the specified header, or (unsigned long)-1 if the header is invalid
+			static unsigned long bufSize(rrframeheader &h);
 
 			rrframeheader rhdr;
+			// JPEG encoder options (see enum rrjpegopt in rr.h)
+			int jpegOpt;
 
 		private:
 
+			void encodeJPEG(Frame &f, unsigned char *srcBits,
+				unsigned char **dstBits, unsigned int &size);
+
 			tjhandle tjhnd;
 			friend class FBXFrame;
 	};
@@ -148,6 +172,7 @@ namespace common
 			XVFrame &operator= (Frame &f);
 			void init(rrframeheader &h);
 			void redraw(void);
+			void sync(void);
 
 		private:
 
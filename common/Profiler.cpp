@@ -27,7 +27,7 @@ using namespace common;
 
 Profiler::Profiler(const char *name_, double interval_) : interval(interval_),
 	mbytes(0.0), mpixels(0.0), totalTime(0.0), start(0.0), frames(0),
-	lastFrame(0.0)
+	lastFrame(0.0), dropped(0), threads(0), note(NULL)
 {
 	profile = false;  char *ev = NULL;
 	setName(name_);  freestr = false;
@@ -98,8 +98,24 @@ void Profiler::endFrame(long pixels, long bytes, double incFrames)
 				mbytes * 8.0 / totalTime, mpixels * 3. / mbytes);
 			i = strlen(temps);
 		}
+		if(dropped)
+		{
+			snprintf(&temps[i], 255 - i, "- %ld dropped", dropped);
+			i = strlen(temps);
+		}
+		if(threads)
+		{
+			snprintf(&temps[i], 255 - i, "- %d thread%s", threads,
+				threads > 1 ? "s" : "");
+			i = strlen(temps);
+		}
+		if(note)
+		{
+			snprintf(&temps[i], 255 - i, "- %s", note);
+			i = strlen(temps);
+		}
 		vglout.PRINT("%s\n", temps);
-		totalTime = 0.;  mpixels = 0.;  frames = 0.;  mbytes = 0.;
+		totalTime = 0.;  mpixels = 0.;  frames = 0.;  mbytes = 0.;  dropped = 0;
 		lastFrame = now;
 	}
 }
@@ -30,12 +30,19 @@ namespace common
 			void setName(const char *name);
 			void startFrame(void);
 			void endFrame(long pixels, long bytes, double incFrames);
+			void dropFrame(void) { dropped++; }
+			void setThreads(int threads_) { threads = threads_; }
+			// The note is not copied, so it must outlive the profiler.
+			void setNote(const char *note_) { note = note_; }
 
 		private:
 
 			char *name;
 			double interval;
 			double mbytes, mpixels, totalTime, start, frames, lastFrame;
+			long dropped;
+			int threads;
+			const char *note;
 			bool profile;
 			util::Timer timer;
 			bool freestr;
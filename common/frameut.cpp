@@ -33,7 +33,8 @@ using namespace common;
 #define BORDER  0
 #define NUMWIN  1
 
-bool useGL = false, useXV = false, doRgbBench = false, useRGB = false,
+bool useGL = false, useXV = false, doRgbBench = false, doJPEGBench = false,
+	useRGB = false,
 	addLogo = false, anaglyph = false, check = false;
 
 
@@ -556,14 +557,17 @@ int cmpFrame(unsigned char *buf, int width, int height, Frame &dst)
 
 void rgbBench(char *filename)
 {
-	unsigned char *buf;  int width, height, dstbu;
+	unsigned char *buf;  int width, height, dstbu, native;
 	CompressedFrame src;  Frame dst;  int dstformat;
 
 	for(dstformat = 0; dstformat < PIXELFORMATS - 1; dstformat++)
 	{
 		PF *dstpf = pf_get(dstformat);
-		for(dstbu = 0; dstbu < 2; dstbu++)
+		for(int i = 0; i < 4; i++)
 		{
+			// Native RGB tiles are already in the destination pixel format.
+			native = i / 2;  dstbu = i % 2;
+			if(native && dstpf->bpc != 8) continue;
 			if(bmp_load(filename, &buf, &width, 1, &height, PF_RGB,
 				BMPORN_BOTTOMUP) == -1)
 				THROW(bmp_geterr());
@@ -571,13 +575,16 @@ void rgbBench(char *filename)
 			memset(&hdr, 0, sizeof(hdr));
 			hdr.width = hdr.framew = width;
 			hdr.height = hdr.frameh = height;
-			hdr.compress = RRCOMP_RGB;  hdr.size = width * 3 * height;
-			src.init(hdr, hdr.flags);
-			memcpy(src.bits, buf, width * 3 * height);
+			hdr.compress = RRCOMP_RGB;
+			if(native) hdr.subsamp = RR_NATIVEPF;
+			hdr.size = width * (native ? dstpf->size : 3) * height;
+			src.init(hdr, hdr.flags, dstpf);
+			pf_get(PF_RGB)->convert(buf, width, width * 3, height, src.bits,
+				width * src.pf->size, src.pf);
 			dst.init(hdr, dstpf->id, dstbu ? FRAME_BOTTOMUP : 0);
 			memset(dst.bits, 0, dst.pitch * dst.hdr.frameh);
-			fprintf(stderr, "RGB (BOTTOM-UP) -> %s (%s)\n", dstpf->name,
-				dstbu ? "BOTTOM-UP" : "TOP-DOWN");
+			fprintf(stderr, "%s (BOTTOM-UP) -> %s (%s)\n", native ? "NATIVE" : "RGB",
+				dstpf->name, dstbu ? "BOTTOM-UP" : "TOP-DOWN");
 			double tStart, tTotal = 0.;  int iter = 0;
 			do
 			{
@@ -597,6 +604,99 @@ void rgbBench(char *filename)
 }
 
 
+// Benchmark the JPEG encoder options that VGL_JPEGOPT can select.  The frame
+// is compressed in 256x256 tiles at quality 95 with 4:4:4 subsampling (the
+// VGL Transport defaults), using one compression thread.  For each option
+// other than the accurate DCT, the link bandwidth at which the option delivers
+// frames as quickly as the accurate DCT is also reported.
+
+#define BENCHTILE  256
+
+void jpegBench(char *filename)
+{
+	static const char *optName[RR_JPEGOPT] =
+	{
+		"Fast DCT", "Accurate DCT", "Optimized Huffman", "Progressive"
+	};
+	unsigned char *buf, *dstBuf;  int width, height, opt;
+	double encTime[RR_JPEGOPT], bytes[RR_JPEGOPT];
+	bool tested[RR_JPEGOPT];
+	Frame src;  CompressedFrame dst;  tjhandle tjhnd;
+
+	if(bmp_load(filename, &buf, &width, 1, &height, PF_RGB,
+		BMPORN_BOTTOMUP) == -1)
+		THROW(bmp_geterr());
+	if((dstBuf = (unsigned char *)malloc(BENCHTILE * BENCHTILE * 3)) == NULL)
+		THROW("Memory allocation error");
+	if(!(tjhnd = tjInitDecompress())) THROW(tjGetErrorStr());
+	src.init(buf, width, width * 3, height, PF_RGB, FRAME_BOTTOMUP);
+	src.hdr.compress = RRCOMP_JPEG;  src.hdr.qual = 95;  src.hdr.subsamp = 1;
+
+	for(opt = 0; opt < RR_JPEGOPT; opt++)
+	{
+		tested[opt] = false;
+		#ifndef TJ_NUMINIT
+		if(opt == RRJPEG_OPTIMIZE) continue;
+		#endif
+		#ifndef TJFLAG_PROGRESSIVE
+		if(opt == RRJPEG_PROGRESSIVE) continue;
+		#endif
+		double tStart, tEnc = 0., tDec = 0.;  int iter = 0;
+		dst.jpegOpt = opt;  bytes[opt] = 0.;
+		do
+		{
+			for(int y = 0; y < height; y += BENCHTILE)
+			{
+				for(int x = 0; x < width; x += BENCHTILE)
+				{
+					Frame *tile = src.getTile(x, y, min(BENCHTILE, width - x),
+						min(BENCHTILE, height - y));
+					tStart = GetTime();
+					dst = *tile;
+					tEnc += GetTime() - tStart;
+					tStart = GetTime();
+					TRY_TJ(tjDecompress2(tjhnd, dst.bits, dst.hdr.size, dstBuf,
+						dst.hdr.width, 0, dst.hdr.height, TJPF_RGB, 0));
+					tDec += GetTime() - tStart;
+					if(iter == 0) bytes[opt] += (double)dst.hdr.size;
+					delete tile;
+				}
+			}
+			iter++;
+		} while(tEnc < 1.);
+		encTime[opt] = tEnc / (double)iter;  tested[opt] = true;
+		fprintf(stderr, "%-17s: %f Mpixels/sec encode, %f Mpixels/sec decode, %.2f:1 compression\n",
+			optName[opt], (double)width * (double)height * (double)iter /
+			1000000. / tEnc, (double)width * (double)height * (double)iter /
+			1000000. / tDec, (double)width * (double)height * 3. / bytes[opt]);
+	}
+	fprintf(stderr, "\n");
+
+	// Compressing and sending a frame takes encTime + bytes * 8 / bandwidth
+	// seconds.
+	for(opt = 0; opt < RR_JPEGOPT; opt++)
+	{
+		if(!tested[opt] || opt == RRJPEG_ACCURATEDCT) continue;
+		double dTime = encTime[opt] - encTime[RRJPEG_ACCURATEDCT];
+		double dBits = (bytes[RRJPEG_ACCURATEDCT] - bytes[opt]) * 8.;
+		if(dTime <= 0. && dBits >= 0.)
+			fprintf(stderr, "%-17s: Always faster than Accurate DCT\n",
+				optName[opt]);
+		else if(dTime >= 0. && dBits <= 0.)
+			fprintf(stderr, "%-17s: Never faster than Accurate DCT\n",
+				optName[opt]);
+		else
+			fprintf(stderr, "%-17s: Faster than Accurate DCT %s %f Mbits/sec\n",
+				optName[opt], dTime > 0. ? "below" : "above",
+				dBits / dTime / 1000000.);
+	}
+
+	tjDestroy(tjhnd);
+	free(dstBuf);
+	free(buf);
+}
+
+
 void usage(char **argv)
 {
 	fprintf(stderr, "\nUSAGE: %s [options]\n\n", argv[0]);
@@ -608,6 +708,8 @@ void usage(char **argv)
 	fprintf(stderr, "-anaglyph = Test anaglyph creation\n");
 	fprintf(stderr, "-rgbbench <filename> = Benchmark the decoding of RGB-encoded frames.\n");
 	fprintf(stderr, "                       <filename> should be a BMP or PPM file.\n");
+	fprintf(stderr, "-jpegbench <filename> = Benchmark the JPEG encoder options.\n");
+	fprintf(stderr, "                        <filename> should be a BMP or PPM file.\n");
 	fprintf(stderr, "-v = Verbose output (may affect benchmark results)\n");
 	fprintf(stderr, "-check = Check correctness of pixel paths (implies -rgb)\n\n");
 	exit(1);
@@ -648,6 +750,10 @@ int main(int argc, char **argv)
 		{
 			fileName = argv[++i];  doRgbBench = true;
 		}
+		else if(!stricmp(argv[i], "-jpegbench") && i < argc - 1)
+		{
+			fileName = argv[++i];  doJPEGBench = true;
+		}
 		else if(!stricmp(argv[i], "-v")) verbose = true;
 		else if(!stricmp(argv[i], "-check")) { check = true;  useRGB = true; }
 		else usage(argv);
@@ -656,6 +762,7 @@ int main(int argc, char **argv)
 	try
 	{
 		if(doRgbBench) { rgbBench(fileName);  exit(0); }
+		if(doJPEGBench) { jpegBench(fileName);  exit(0); }
 
 		ERRIFNOT(XInitThreads());
 		if(!(dpy = XOpenDisplay(0)))
@@ -17,7 +17,7 @@
 #define __RR_H
 
 #define RR_MAJOR_VERSION  2
-#define RR_MINOR_VERSION  1
+#define RR_MINOR_VERSION  3
 
 /* Argh! */
 #if !defined(__SUNPRO_CC) && !defined(__SUNPRO_C)
@@ -88,9 +88,71 @@ enum
   RR_EOF = 1,  /* this tile is an End-of-Frame marker and contains no real
                   image data */
   RR_LEFT,     /* this tile goes to the left buffer of a stereo frame */
-  RR_RIGHT     /* this tile goes to the right buffer of a stereo frame */
+  RR_RIGHT,    /* this tile goes to the right buffer of a stereo frame */
+  RR_UDP       /* request that the client switch to the UDP mode of the VGL
+                  Transport (protocol v2.2 and later) */
 };
 
+/* UDP mode of the VGL Transport (protocol v2.2 and later):
+
+   The server sends a header with flags == RR_UDP over the TCP connection, and
+   the client replies with the UDP port on which it is listening
+   (unsigned short, little endian), or 0 if it cannot use UDP.  If the port is
+   nonzero, then the server replies with the UDP port from which it will send
+   datagrams (unsigned short, little endian) and a randomly-generated session
+   token (unsigned int, little endian.)  The client discards datagrams that do
+   not originate from that port or that do not contain the session token.
+   Thereafter, each tile is split into datagrams, each of which consists of an
+   rrdgramheader, the tile's rrframeheader, and up to RR_DGRAMPAYLOAD bytes of
+   the tile's image data.  The end of each frame is signaled by a "tile" with
+   tileid == RR_DGRAMEOF, whose image data is a bitmap of the tile IDs that
+   were sent in the frame.  The client sends an rrrefresh structure, followed
+   by a bitmap of missing tile IDs, over the TCP connection to request that
+   the server resend tiles that were lost. */
+
+typedef struct _rrdgramheader
+{
+  unsigned int frameid;    /* Sequence number of the frame */
+  unsigned short tileid;   /* Index of the tile within the frame */
+  unsigned short frag;     /* Index of this datagram within the tile */
+  unsigned short nfrags;   /* Number of datagrams in the tile */
+  unsigned short len;      /* Number of bytes of image data in this
+                              datagram */
+  unsigned int token;      /* Session token that the server sent over the TCP
+                              connection */
+} rrdgramheader;
+#define sizeof_rrdgramheader  16
+
+typedef struct _rrrefresh
+{
+  unsigned int frameid;    /* Sequence number of the frame in which tiles
+                              were lost */
+  unsigned int winid;      /* The X window ID of that frame */
+  unsigned short framew;   /* The width of that frame (in pixels) */
+  unsigned short frameh;   /* The height of that frame (in pixels) */
+  unsigned short len;      /* Size (in bytes) of the bitmap that follows, or 0
+                              if the entire frame should be resent */
+} rrrefresh;
+#define sizeof_rrrefresh  14
+
+#define RR_DGRAMEOF  0xFFFF
+/* Keep datagrams below the typical Internet path MTU */
+#define RR_DGRAMPAYLOAD  \
+  (1400 - sizeof_rrdgramheader - sizeof_rrframeheader)
+
+/* Native RGB encoding (protocol v2.3 and later):
+
+   After the client and server have exchanged rrversion structures, a client
+   that supports protocol v2.3 or later sends the server one additional byte
+   containing the ID of the pixel format (see pf.h) used by its X display, or
+   255 if it cannot accept tiles in a native pixel format.  The server may then
+   send RRCOMP_RGB tiles whose subsamp field is RR_NATIVEPF.  Such tiles contain
+   pixels in the client's pixel format rather than packed RGB, so neither the
+   server nor the client has to convert them.  As with packed RGB tiles, the
+   rows are stored bottom-up with no padding. */
+
+#define RR_NATIVEPF  255
+
 /* Transport types */
 #define RR_TRANSPORTOPT  3
 enum rrtrans
@@ -109,6 +171,23 @@ enum rrcomp
 #define RR_READBACKOPT  3
 enum rrread { RRREAD_NONE = 0, RRREAD_SYNC, RRREAD_PBO };
 
+/* 3D X server/EGL device selection policies (used when VGL_DISPLAY contains
+   a list of devices) */
+#define RR_DPYPOLICYOPT  3
+enum rrdpypolicy { RRDPY_LEASTLOADED = 0, RRDPY_ROUNDROBIN, RRDPY_NUMA };
+
+/* Frame capture formats (see VGL_CAPTUREFORMAT) */
+#define RR_CAPTUREOPT  3
+enum rrcapture { RRCAPTURE_PPM = 0, RRCAPTURE_BMP, RRCAPTURE_Y4M };
+
+/* JPEG encoder options, in order of increasing CPU usage and (usually)
+   decreasing compressed size */
+#define RR_JPEGOPT  4
+enum rrjpegopt
+{
+  RRJPEG_FASTDCT = 0, RRJPEG_ACCURATEDCT, RRJPEG_OPTIMIZE, RRJPEG_PROGRESSIVE
+};
+
 static const enum rrtrans _Trans[RR_COMPRESSOPT] =
 {
   RRTRANS_X11, RRTRANS_VGL, RRTRANS_VGL, RRTRANS_XV, RRTRANS_VGL
@@ -151,6 +230,9 @@ enum rrstereo
 /* (the algorithms don't scale beyond 3) */
 #define MAXPROCS  4
 
+/* Maximum number of frames that can be in the VGL Transport pipeline */
+#define MAXPIPELINE  4
+
 #define MAXSTR  256
 
 /* Faker configuration */
@@ -158,16 +240,22 @@ typedef struct _FakerConfig
 {
   char allowindirect;
   char autotest;
+  char capture[MAXSTR];
+  int captureformat;
+  int captureinterval;
   char client[MAXSTR];
   int compress;
   char config[MAXSTR];
   char defaultfbconfig[MAXSTR];
+  char dirtyrect;
   char dlsymloader;
+  int dpypolicy;
   char egl;
   #ifdef EGLBACKEND
   char egllib[MAXSTR];
   #endif
   double flushdelay;
+  char fontcache[MAXSTR];
   int forcealpha;
   double fps;
   double gamma;
@@ -181,10 +269,13 @@ typedef struct _FakerConfig
   char guikeyseq[MAXSTR];
   unsigned int guimod;
   char interframe;
+  int jpegopt;
   char localdpystring[MAXSTR];
   char log[MAXSTR];
   char logo;
+  char nativergb;
   int np;
+  int pipeline;
   int port;
   char probeglx;
   int qual;
@@ -203,6 +294,7 @@ typedef struct _FakerConfig
   char transport[MAXSTR];
   char transvalid[RR_TRANSPORTOPT];
   char trapx11;
+  char udp;
   char vendor[MAXSTR];
   char verbose;
   char wm;
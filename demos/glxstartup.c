@@ -0,0 +1,140 @@
+/* Copyright (C)2026 D. R. Commander
+ *
+ * This library is free software and may be redistributed and/or modified under
+ * the terms of the wxWindows Library License, Version 3.1 or (at your option)
+ * any later version.  The full license is in the LICENSE.txt file included
+ * with this distribution.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * wxWindows Library License for more details.
+ */
+
+/* This program measures the startup overhead of short-lived OpenGL
+   applications.  It launches a number of back-to-back child processes, each
+   of which opens the X display, creates a window and an OpenGL context, draws
+   and swaps a single frame, and exits.  Run it with vglrun to measure the
+   overhead that VirtualGL adds to each process, and set VGL_PROFILE=1 to make
+   each child print a breakdown of the VirtualGL Faker's startup time. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <GL/glx.h>
+
+
+#define THROW(m) { \
+	fprintf(stderr, "ERROR (%d): %s\n", __LINE__, m);  exit(1); \
+}
+
+
+static double getTime(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec * 0.000001;
+}
+
+
+static int runChild(void)
+{
+	Display *dpy;
+	XVisualInfo *vis;
+	XSetWindowAttributes swa;
+	Window win;
+	GLXContext ctx;
+	int attribs[] = { GLX_RGBA, GLX_DOUBLEBUFFER, GLX_RED_SIZE, 8,
+		GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None };
+
+	if((dpy = XOpenDisplay(NULL)) == NULL) THROW("Could not open display");
+	if((vis = glXChooseVisual(dpy, DefaultScreen(dpy), attribs)) == NULL)
+		THROW("Could not obtain a suitable visual");
+
+	swa.border_pixel = 0;
+	swa.background_pixel = 0;
+	swa.colormap = XCreateColormap(dpy, RootWindow(dpy, vis->screen),
+		vis->visual, AllocNone);
+	if((win = XCreateWindow(dpy, RootWindow(dpy, vis->screen), 0, 0, 256, 256,
+		0, vis->depth, InputOutput, vis->visual,
+		CWBorderPixel | CWBackPixel | CWColormap,
+		&swa)) == 0)
+		THROW("Could not create window");
+	XMapWindow(dpy, win);
+	XSync(dpy, False);
+
+	if((ctx = glXCreateContext(dpy, vis, NULL, True)) == NULL)
+		THROW("Could not create context");
+	if(!glXMakeCurrent(dpy, win, ctx))
+		THROW("Could not make context current");
+	glClearColor(0., 0., 1., 0.);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glXSwapBuffers(dpy, win);
+	glFinish();
+
+	glXMakeCurrent(dpy, 0, 0);
+	glXDestroyContext(dpy, ctx);
+	XDestroyWindow(dpy, win);
+	XFree(vis);
+	XCloseDisplay(dpy);
+	return 0;
+}
+
+
+static void usage(char **argv)
+{
+	fprintf(stderr, "\nUSAGE: %s [-n <iterations>]\n\n", argv[0]);
+	fprintf(stderr, "-n <iterations> = Number of child processes to launch (default: 20)\n\n");
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	int i, n = 20, status;
+	double minTime = -1., maxTime = 0., totalTime = 0.;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-child")) return runChild();
+		else if(!strcmp(argv[i], "-n") && i < argc - 1)
+		{
+			n = atoi(argv[++i]);
+			if(n < 1) usage(argv);
+		}
+		else usage(argv);
+	}
+
+	/* Each iteration is a separate exec() so that the VirtualGL Faker, if
+	   preloaded, is initialized from scratch. */
+	for(i = 0; i < n; i++)
+	{
+		pid_t pid;
+		double t = getTime(), elapsed;
+
+		if((pid = fork()) < 0) THROW("Could not fork child process");
+		if(pid == 0)
+		{
+			execl("/proc/self/exe", argv[0], "-child", (char *)NULL);
+			execlp(argv[0], argv[0], "-child", (char *)NULL);
+			fprintf(stderr, "ERROR: Could not execute %s\n", argv[0]);
+			_exit(1);
+		}
+		if(waitpid(pid, &status, 0) < 0) THROW("Could not wait for child process");
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			THROW("Child process failed");
+		elapsed = getTime() - t;
+		if(minTime < 0. || elapsed < minTime) minTime = elapsed;
+		if(elapsed > maxTime) maxTime = elapsed;
+		totalTime += elapsed;
+	}
+
+	printf("Process startup time (%d iterations):\n", n);
+	printf("min = %.3f ms, avg = %.3f ms, max = %.3f ms\n",
+		minTime * 1000., totalTime / (double)n * 1000., maxTime * 1000.);
+	return 0;
+}
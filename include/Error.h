@@ -158,5 +158,10 @@ namespace util
 	if((f) == -1) \
 		throw(util::Error(__FUNCTION__, tjGetErrorStr(), __LINE__)); \
 }
+#define TRY_TJ3(handle, f) \
+{ \
+	if((f) == -1) \
+		throw(util::Error(__FUNCTION__, tj3GetErrorStr(handle), __LINE__)); \
+}
 
 #endif  // __ERROR_H__
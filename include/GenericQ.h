@@ -27,11 +27,14 @@ namespace util
 		public:
 
 			typedef void (*SpoilCallback)(void *);
+			typedef bool (*MatchCallback)(void *item, void *newItem);
 
 			GenericQ(void);
 			~GenericQ(void);
 			void add(void *item);
 			void spoil(void *item, SpoilCallback spoilCallback);
+			void spoil(void *item, SpoilCallback spoilCallback,
+				MatchCallback matchCallback);
 			void get(void **item, bool nonBlocking = false);
 			void release(void);
 			int items(void);
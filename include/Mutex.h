@@ -84,6 +84,55 @@ namespace util
 	};
 
 
+	// Read/write lock.  Any number of threads can hold the lock for reading at
+	// the same time, so readers never block each other.  Waiting writers take
+	// precedence over new readers, so the lock is not recursive, and a thread
+	// that holds it must not try to acquire it again.
+	class ReadWriteLock
+	{
+		public:
+
+			ReadWriteLock(void);
+			~ReadWriteLock(void);
+			void readLock(void);
+			void readUnlock(void);
+			void writeLock(void);
+			void writeUnlock(void);
+
+			class SafeReadLock
+			{
+				public:
+
+					SafeReadLock(ReadWriteLock &rwl_) : rwl(rwl_) { rwl.readLock(); }
+					~SafeReadLock() { rwl.readUnlock(); }
+
+				private:
+
+					ReadWriteLock &rwl;
+			};
+
+			class SafeWriteLock
+			{
+				public:
+
+					SafeWriteLock(ReadWriteLock &rwl_) : rwl(rwl_) { rwl.writeLock(); }
+					~SafeWriteLock() { rwl.writeUnlock(); }
+
+				private:
+
+					ReadWriteLock &rwl;
+			};
+
+		private:
+
+			#ifdef _WIN32
+			SRWLOCK rwlock;
+			#else
+			pthread_rwlock_t rwlock;
+			#endif
+	};
+
+
 	class Semaphore
 	{
 		public:
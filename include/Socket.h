@@ -28,6 +28,10 @@
 	#if !defined(HAVE_DEVURANDOM) && !defined(_WIN32)
 		#include <openssl/rand.h>
 	#endif
+	// Kernel TLS offload requires OpenSSL v3.0 or later, built with KTLS support
+	#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+		#define USEKTLS
+	#endif
 #endif
 
 #include "Error.h"
@@ -154,11 +158,23 @@ namespace util
 			Socket *accept(void);
 			void send(char *buf, int len);
 			void recv(char *buf, int len);
+			void recv(char *buf, int rowLen, int pitch, int rows);
 			const char *remoteName(void);
+			#ifdef USESSL
+			// Request kernel TLS offload for subsequent connections.  This is
+			// silently ignored if the kernel or OpenSSL does not support it or if
+			// the negotiated cipher cannot be offloaded.
+			void setKTLS(bool ktls_) { ktls = ktls_; }
+			bool isKTLSSend(void) { return ktlsSend; }
+			bool isKTLSRecv(void) { return ktlsRecv; }
+			#endif
 
 		private:
 
 			unsigned short setupListener(unsigned short port, bool reuseAddr);
+			#ifdef USESSL
+			void checkKTLS(void);
+			#endif
 
 			#ifdef USESSL
 
@@ -176,6 +192,7 @@ namespace util
 			static CriticalSection cryptoLock[CRYPTO_NUM_LOCKS];
 			#endif
 			bool doSSL;  SSL_CTX *sslctx;  SSL *ssl;
+			bool ktls, ktlsSend, ktlsRecv;
 
 			#endif
 
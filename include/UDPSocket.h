@@ -0,0 +1,78 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __UDPSOCKET_H__
+#define __UDPSOCKET_H__
+
+#include "Socket.h"
+#include "Thread.h"
+
+
+namespace util
+{
+	// Connected datagram socket, used by the UDP mode of the VGL Transport.
+	//
+	// For testing purposes, outgoing datagrams can be randomly dropped and/or
+	// delayed by setting VGL_UDPLOSS to a loss percentage (0-100) and/or
+	// VGL_UDPLATENCY to a one-way latency in milliseconds.
+
+	class UDPSocket : public Runnable
+	{
+		public:
+
+			UDPSocket(bool ipv6);
+			~UDPSocket(void);
+			void close(void);
+			// If peerName is specified, then datagrams that do not originate from
+			// that host (numeric address) are discarded by recv().
+			unsigned short bind(unsigned short port, const char *peerName = NULL);
+			// If port is nonzero, then datagrams from the peer host that do not
+			// originate from that port are also discarded by recv().
+			void setPeerPort(unsigned short port);
+			void connect(const char *serverName, unsigned short port);
+			// Returns the local port to which the socket is bound
+			unsigned short getPort(void);
+			void send(char *buf, int len);
+			// Returns the number of bytes received, or 0 if no datagram was
+			// received within the specified timeout (in seconds)
+			int recv(char *buf, int len, double timeout);
+			// Returns a random nonzero session token
+			static unsigned int newToken(void);
+
+		private:
+
+			typedef struct DelayedDgramStruct
+			{
+				char *buf;  int len;  double due;
+				struct DelayedDgramStruct *next;
+			} DelayedDgram;
+
+			void run(void);
+			void sendNow(char *buf, int len);
+			double random(void);
+
+			SOCKET sd;
+			bool ipv6;
+			double lossRate, latency;
+			unsigned int seed;
+			struct sockaddr_storage peer;
+			bool restrictPeer;
+			unsigned short peerPort;
+			DelayedDgram *start, *end;
+			CriticalSection mutex;
+			Semaphore hasDgram;
+			Thread *thread;
+			bool deadYet;
+	};
+}
+
+#endif  // __UDPSOCKET_H__
@@ -52,9 +52,17 @@ typedef struct
 	Display *dpy;  Drawable d;  Visual *v;
 } fbx_wh;
 
+/* Number of pixmaps in the swap chain used with the X Present extension */
+#define FBX_PRESENTPIXMAPS  3
+
 #endif  /* _WIN32 */
 
 
+/* Flags for fbx_init() */
+#define FBX_SHM  1
+#define FBX_PRESENT  2
+
+
 typedef struct _fbx_struct
 {
 	int width, height, pitch;
@@ -73,6 +81,11 @@ typedef struct _fbx_struct
 	XImage *xi;
 	Pixmap pm;
 	int pixmap;
+	int present, presentPending, presentIdle[FBX_PRESENTPIXMAPS];
+	Pixmap presentPm[FBX_PRESENTPIXMAPS];
+	unsigned int presentEID, presentSerial;
+	unsigned long long presentMSC;
+	void *presentEvents;
 	#endif
 } fbx_struct;
 
@@ -88,7 +101,7 @@ extern "C" {
 
 /*
   fbx_init
-  (fbx_struct *fb, fbx_wh wh, int width, int height, int useShm)
+  (fbx_struct *fb, fbx_wh wh, int width, int height, int flags)
 
   fb = Address of fbx_struct (must be pre-allocated by user)
   wh = Handle to the window that you wish to read from or write to.  On
@@ -99,7 +112,20 @@ extern "C" {
           of window
   height = Height of buffer (in pixels) that you wish to create.  0 = use
            height of window
-  useShm = Use MIT-SHM extension, if available (Unix only.)
+  flags = Bitwise OR of zero or more of the following (Unix only):
+          FBX_SHM = Use the MIT-SHM extension, if available.  For backward
+                    compatibility, this is the same as passing 1.
+          FBX_PRESENT = Use the X Present extension, if available, to
+                        synchronize fbx_write() with the vertical refresh of
+                        the display.  The buffer is copied into one of a small
+                        chain of pixmaps, which is then presented to the window
+                        at the next vertical refresh.  Instead of waiting for
+                        the X server to finish drawing, fbx_write() waits only
+                        until the buffer has been copied into the pixmap, and
+                        it blocks longer only if more than one frame is already
+                        waiting to be presented, so the write rate is paced by
+                        the refresh rate.  This flag has no effect if the
+                        drawable is a Pixmap.
 
   NOTES:
   -- fbx_init() is idempotent.  If you call it multiple times, it will
@@ -117,7 +143,7 @@ extern "C" {
   fb->pitch = bytes in each scanline of the buffer
   fb->bits = address of the start of the buffer
 */
-int fbx_init(fbx_struct *fb, fbx_wh wh, int width, int height, int useShm);
+int fbx_init(fbx_struct *fb, fbx_wh wh, int width, int height, int flags);
 
 
 /*
@@ -159,6 +185,11 @@ int fbx_read(fbx_struct *fb, int x, int y);
          drawable area)
   width = width of region you wish to blit (0 = whole bitmap)
   height = height of region you wish to blit (0 = whole bitmap)
+
+  NOTE: If the X Present extension is being used, then only writes of the
+  whole bitmap to the upper left corner of the drawable are presented.  Other
+  writes wait for all pending presentations to complete and are then drawn
+  directly.
 */
 int fbx_write(fbx_struct *fb, int srcX, int srcY, int dstX, int dstY,
 	int width, int height);
@@ -43,7 +43,7 @@ typedef struct _fbxv_struct
 	Display *dpy;  Window win;
 	int shm, reqwidth, reqheight, port, doexpose;
 	#ifdef USESHM
-	XShmSegmentInfo shminfo;  int xattach;
+	XShmSegmentInfo shminfo;  int xattach, shmevent, pending;
 	#endif
 	GC xgc;
 	XvImage *xvi;
@@ -101,11 +101,26 @@ int fbxv_init(fbxv_struct *fb, Display *dpy, Window win, int width, int height,
          drawn (relative to the window's client area)
   dstWidth, dstHeight = width and height of the window region into which the
                         image should be drawn
+
+  NOTE: if the MIT-SHM extension is in use, then this function returns without
+  waiting for the X server to finish drawing the image, so fbxv_sync() must be
+  called before fb->xvi->data is modified again.
 */
 int fbxv_write(fbxv_struct *fb, int srcX, int srcY, int srcWidth,
 	int srcHeight, int dstX, int dstY, int dstWidth, int dstHeight);
 
 
+/*
+  This routine waits until the X server has finished reading the X Video image
+  stored in fb, if a previous call to fbxv_write() is still drawing it.  The
+  X server notifies the application when it is finished, so this usually
+  returns immediately, without a round trip to the X server.
+
+  fb = Address of fbxv_struct previously initialized by a call to fbxv_init()
+*/
+int fbxv_sync(fbxv_struct *fb);
+
+
 /*
   Frees the X Video image associated with fb (if any), then frees the memory
   used by fb.
@@ -0,0 +1,292 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "BlitPool.h"
+#include "Frame.h"
+#include "vglutil.h"
+#ifdef USEHELGRIND
+	#include <valgrind/helgrind.h>
+#endif
+
+extern "C" void _vgl_disableFaker(void);
+extern "C" void _vgl_enableFaker(void);
+
+using namespace util;
+using namespace server;
+
+
+BlitClient::BlitClient(void) : prev(NULL), next(NULL), nextQueued(NULL),
+	queued(false), busy(false), removing(false)
+{
+	removed.wait();
+}
+
+
+BlitPool *BlitPool::instance = NULL;
+CriticalSection BlitPool::instanceMutex;
+
+// The frame buffers of a client are reclaimed if it has not requested a frame
+// for IDLETIME seconds.  Reallocating them costs a few milliseconds, so this
+// is long enough that a window that is redrawn interactively keeps its frame
+// buffers.
+const double BlitPool::IDLETIME = 2.0;
+const double BlitPool::SWEEPINTERVAL = 1.0;
+
+
+BlitPool *BlitPool::getInstance(void)
+{
+	#ifdef USEHELGRIND
+	ANNOTATE_BENIGN_RACE_SIZED(&instance, sizeof(BlitPool *), );
+	#endif
+	if(instance == NULL)
+	{
+		CriticalSection::SafeLock l(instanceMutex);
+		if(instance == NULL) instance = new BlitPool;
+	}
+	return instance;
+}
+
+
+BlitPool::BlitPool(void) : clients(NULL), queueStart(NULL), queueEnd(NULL),
+	numWorkers(0), busyWorkers(0), numQueued(0), lastSweep(GetTime()),
+	deadYet(false)
+{
+	// The blits are mostly bound by the 2D X server, so there is little to be
+	// gained from using more than a few threads.  At least two are used so
+	// that a worker that is throttling the frame rate of one window (VGL_FPS)
+	// does not block the others.
+	maxWorkers = min(max(NumProcs(), 2), MAXWORKERS);
+	for(int i = 0; i < MAXWORKERS; i++)
+	{
+		workers[i] = NULL;  threads[i] = NULL;
+	}
+}
+
+
+void BlitPool::kill(void)
+{
+	int n;
+
+	{
+		CriticalSection::SafeLock l(mutex);
+		if(deadYet) return;
+		deadYet = true;
+		n = numWorkers;
+	}
+	for(int i = 0; i < n; i++) hasWork.post();
+	for(int i = 0; i < n; i++)
+	{
+		threads[i]->stop();
+		delete threads[i];  threads[i] = NULL;
+		delete workers[i];  workers[i] = NULL;
+	}
+}
+
+
+void BlitPool::add(BlitClient *client)
+{
+	if(!client) THROW("Invalid argument");
+	CriticalSection::SafeLock l(mutex);
+	client->prev = NULL;  client->next = clients;
+	if(clients) clients->prev = client;
+	clients = client;
+}
+
+
+void BlitPool::remove(BlitClient *client)
+{
+	bool wait;
+
+	if(!client) THROW("Invalid argument");
+	{
+		CriticalSection::SafeLock l(mutex);
+		if(client->prev) client->prev->next = client->next;
+		else if(clients == client) clients = client->next;
+		if(client->next) client->next->prev = client->prev;
+		client->prev = client->next = NULL;
+
+		if(client->queued)
+		{
+			BlitClient *c = queueStart, *prevQueued = NULL;
+			while(c && c != client)
+			{
+				prevQueued = c;  c = c->nextQueued;
+			}
+			if(c)
+			{
+				if(prevQueued) prevQueued->nextQueued = c->nextQueued;
+				else queueStart = c->nextQueued;
+				if(queueEnd == c) queueEnd = prevQueued;
+				numQueued--;
+			}
+			client->queued = false;  client->nextQueued = NULL;
+		}
+		wait = client->busy;
+		if(wait) client->removing = true;
+	}
+	if(wait)
+	{
+		client->removed.wait();
+		// The worker signals the event while holding the pool mutex, so this
+		// ensures that it is finished with the client before the client is
+		// destroyed.
+		CriticalSection::SafeLock l(mutex);
+	}
+}
+
+
+// The pool mutex must be locked.
+
+void BlitPool::enqueue(BlitClient *client)
+{
+	client->queued = true;  client->nextQueued = NULL;
+	if(queueEnd) queueEnd->nextQueued = client;
+	else queueStart = client;
+	queueEnd = client;
+	numQueued++;
+	hasWork.post();
+}
+
+
+// The pool mutex must be locked.
+
+BlitClient *BlitPool::dequeue(void)
+{
+	BlitClient *client = queueStart;
+
+	if(client)
+	{
+		queueStart = client->nextQueued;
+		if(!queueStart) queueEnd = NULL;
+		client->queued = false;  client->nextQueued = NULL;
+		numQueued--;
+	}
+	return client;
+}
+
+
+void BlitPool::schedule(BlitClient *client)
+{
+	if(!client) THROW("Invalid argument");
+	CriticalSection::SafeLock l(mutex);
+	if(deadYet) THROW("Blit pool has been shut down");
+
+	// If the client is busy, then the worker that is servicing it will requeue
+	// it when it is finished.
+	if(client->queued || client->busy) return;
+	enqueue(client);
+
+	if(numQueued > numWorkers - busyWorkers && numWorkers < maxWorkers)
+	{
+		workers[numWorkers] = new Worker(this);
+		threads[numWorkers] = new Thread(workers[numWorkers]);
+		threads[numWorkers]->start();
+		numWorkers++;
+	}
+}
+
+
+void BlitPool::sweep(void)
+{
+	GenericQ idleFrames;
+
+	{
+		CriticalSection::SafeLock l(mutex);
+		sweepLocked(idleFrames);
+	}
+	deleteFrames(idleFrames);
+}
+
+
+// The pool mutex must be locked.  Deleting a frame tears down its X resources
+// and shared memory segment, which may require round trips to the 2D X server,
+// so the idle frames are only collected here.  The caller must pass them to
+// deleteFrames() after unlocking the pool mutex.
+
+void BlitPool::sweepLocked(GenericQ &idleFrames)
+{
+	double now = GetTime();
+
+	if(now - lastSweep < SWEEPINTERVAL) return;
+	lastSweep = now;
+	for(BlitClient *c = clients; c; c = c->next)
+		if(!c->busy) c->reclaim(now, IDLETIME, idleFrames);
+}
+
+
+void BlitPool::deleteFrames(GenericQ &idleFrames)
+{
+	void *ptr = NULL;
+
+	while(idleFrames.get(&ptr, true), ptr != NULL)
+	{
+		delete (common::Frame *)ptr;  ptr = NULL;
+	}
+}
+
+
+void BlitPool::work(void)
+{
+	GenericQ idleFrames;
+
+	while(1)
+	{
+		BlitClient *client;
+
+		hasWork.wait();
+		{
+			CriticalSection::SafeLock l(mutex);
+			if(deadYet) return;
+			// The client may have been removed since it was queued.
+			if(!(client = dequeue())) continue;
+			client->busy = true;  busyWorkers++;
+		}
+
+		try
+		{
+			client->blit();
+		}
+		catch(std::exception &e)
+		{
+			client->lastError = e;
+		}
+
+		{
+			CriticalSection::SafeLock l(mutex);
+			client->busy = false;  busyWorkers--;
+			if(client->removing) client->removed.signal();
+			else
+			{
+				// Go to the back of the line, so that the other clients get a turn
+				if(client->hasPending()) enqueue(client);
+				sweepLocked(idleFrames);
+			}
+		}
+		deleteFrames(idleFrames);
+	}
+}
+
+
+void BlitPool::Worker::run(void)
+{
+	_vgl_disableFaker();
+	try
+	{
+		pool->work();
+	}
+	catch(...)
+	{
+		_vgl_enableFaker();
+		throw;
+	}
+	_vgl_enableFaker();
+}
@@ -0,0 +1,129 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __BLITPOOL_H__
+#define __BLITPOOL_H__
+
+#include "Thread.h"
+#include "Mutex.h"
+#include "GenericQ.h"
+
+
+namespace server
+{
+	// A transport that draws its frames using the blit pool.  Each client
+	// maintains its own frame queue.  The pool guarantees that blit() is never
+	// called for the same client from more than one worker thread at a time,
+	// so frames from the same window are always drawn in order.
+
+	class BlitClient
+	{
+		public:
+
+			BlitClient(void);
+			virtual ~BlitClient(void) {}
+
+		protected:
+
+			// Draw the next queued frame, if any.  This is called from a worker
+			// thread.
+			virtual void blit(void) = 0;
+			// Return true if there are frames waiting to be drawn
+			virtual bool hasPending(void) = 0;
+			// Detach the client's frame buffers and add them to idleFrames if the
+			// client has not been used for at least idleTime seconds.  This is never
+			// called while blit() is executing.  It is called with the pool mutex
+			// locked, so the pool deletes the frames after unlocking it.
+			virtual void reclaim(double now, double idleTime,
+				util::GenericQ &idleFrames) = 0;
+
+			void checkError(void) { if(lastError) throw lastError; }
+
+			util::Error lastError;
+
+		private:
+
+			BlitClient *prev, *next, *nextQueued;
+			bool queued, busy, removing;
+			util::Event removed;
+			friend class BlitPool;
+	};
+
+
+	// This class maintains a process-wide pool of worker threads that draw the
+	// frames for all X11 and XV Transport instances, so the number of threads
+	// scales with the number of windows that are actively drawing rather than
+	// the number of windows that exist.  Clients with pending frames are
+	// serviced in round-robin order, one frame at a time, so a window with a
+	// high frame rate cannot starve the others.  Worker threads are created on
+	// demand, up to a limit, and the frame buffers of clients that have been
+	// idle for a while are periodically reclaimed.
+
+	class BlitPool
+	{
+		public:
+
+			static BlitPool *getInstance(void);
+			static bool isAlloc(void) { return instance != NULL; }
+
+			void add(BlitClient *client);
+			// Unregister a client, waiting for any frame that is currently being
+			// drawn on its behalf to finish.  This must be called from the
+			// destructor of the derived class.
+			void remove(BlitClient *client);
+			// Notify the pool that the client has a new frame to draw
+			void schedule(BlitClient *client);
+			// Reclaim the frame buffers of idle clients, if enough time has elapsed
+			// since the last sweep
+			void sweep(void);
+			void kill(void);
+
+		private:
+
+			BlitPool(void);
+			~BlitPool(void) { kill(); }
+			void enqueue(BlitClient *client);
+			BlitClient *dequeue(void);
+			void sweepLocked(util::GenericQ &idleFrames);
+			static void deleteFrames(util::GenericQ &idleFrames);
+			void work(void);
+
+			class Worker : public util::Runnable
+			{
+				public:
+
+					Worker(BlitPool *pool_) : pool(pool_) {}
+					void run(void);
+
+				private:
+
+					BlitPool *pool;
+			};
+
+			static const int MAXWORKERS = 4;
+			static const double IDLETIME, SWEEPINTERVAL;
+
+			static BlitPool *instance;
+			static util::CriticalSection instanceMutex;
+
+			util::CriticalSection mutex;
+			util::Semaphore hasWork;
+			BlitClient *clients, *queueStart, *queueEnd;
+			Worker *workers[MAXWORKERS];
+			util::Thread *threads[MAXWORKERS];
+			int maxWorkers, numWorkers, busyWorkers, numQueued;
+			double lastSweep;
+			bool deadYet;
+	};
+}
+
+#endif  // __BLITPOOL_H__
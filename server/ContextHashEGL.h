@@ -25,6 +25,9 @@ typedef struct
 	GLsizei nDrawBufs;
 	GLenum drawBufs[16], readBuf;
 	GLuint drawFBO, readFBO;
+	// The context hash holds one reference, and each thread that caches the
+	// attributes as part of its current state holds another.
+	int refCount;
 } EGLContextAttribs;
 
 
@@ -60,6 +63,7 @@ namespace backend
 				for(int i = 0; i < 16; i++) attribs->drawBufs[i] = GL_NONE;
 				attribs->readBuf = GL_NONE;
 				attribs->drawFBO = attribs->readFBO = 0;
+				attribs->refCount = 1;
 				HASH::add(ctx, NULL, attribs);
 			}
 
@@ -70,6 +74,27 @@ namespace backend
 				return 0;
 			}
 
+			EGLContextAttribs *findAttribs(EGLContext ctx)
+			{
+				if(!ctx) return NULL;
+				return HASH::find(ctx, NULL);
+			}
+
+			// Returns the context attributes with a reference taken on behalf of the
+			// caller, which must pass them to release() when finished with them
+			EGLContextAttribs *findAttribsRef(EGLContext ctx)
+			{
+				if(!ctx) return NULL;
+				return HASH::findRef(ctx, NULL);
+			}
+
+			static void release(EGLContextAttribs *attribs)
+			{
+				if(attribs
+					&& __atomic_sub_fetch(&attribs->refCount, 1, __ATOMIC_ACQ_REL) == 0)
+					delete attribs;
+			}
+
 			void setDrawBuffers(EGLContext ctx, GLsizei n, const GLenum *bufs)
 			{
 				if(n < 0 || n > 16 || !bufs) THROW("Invalid argument");
@@ -159,10 +184,14 @@ namespace backend
 				HASH::kill();
 			}
 
+			void ref(EGLContextAttribs *attribs)
+			{
+				__atomic_add_fetch(&attribs->refCount, 1, __ATOMIC_RELAXED);
+			}
+
 			void detach(HashEntry *entry)
 			{
-				EGLContextAttribs *attribs = entry ? entry->value : NULL;
-				delete attribs;
+				release(entry ? entry->value : NULL);
 			}
 
 			bool compare(EGLContext key1, void * key2, HashEntry *entry)
@@ -0,0 +1,340 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "DeviceBroker.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Error.h"
+#include "vglutil.h"
+
+using namespace faker;
+
+
+// If another process holds the registry lock for longer than this, then the
+// caller gives up, and the first device in the list is used.
+const double DeviceBroker::LOCKTIMEOUT = 2.0;
+
+
+DeviceBroker::DeviceBroker(const char *shmName) : fd(-1), reg(NULL)
+{
+	if(!shmName) THROW("Invalid argument");
+	TRY_UNIX(fd = shm_open(shmName, O_RDWR | O_CREAT, 0666));
+	// The registry is shared by all users, so the umask must not restrict its
+	// permissions.  This fails harmlessly if another user created it.
+	fchmod(fd, 0666);
+	reg = new Registry;
+	memset(reg, 0, sizeof(Registry));
+}
+
+
+DeviceBroker::~DeviceBroker(void)
+{
+	try
+	{
+		release();
+	}
+	catch(...) {}
+	delete reg;
+	close(fd);
+}
+
+
+// Lock the registry and read it into private memory.  Any user can hold the
+// lock, so the lock is not waited for indefinitely.
+
+void DeviceBroker::lock(void)
+{
+	struct flock fl;
+	double start = GetTime();
+
+	memset(&fl, 0, sizeof(struct flock));
+	fl.l_type = F_WRLCK;  fl.l_whence = SEEK_SET;
+	while(fcntl(fd, F_SETLK, &fl) == -1)
+	{
+		if(errno != EINTR && errno != EACCES && errno != EAGAIN) THROW_UNIX();
+		if(GetTime() - start >= LOCKTIMEOUT)
+			THROW("Timed out waiting for the registry lock");
+		usleep(10000);
+	}
+	try
+	{
+		load();
+	}
+	catch(...)
+	{
+		unlock();  throw;
+	}
+}
+
+
+void DeviceBroker::unlock(void)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(struct flock));
+	fl.l_type = F_UNLCK;  fl.l_whence = SEEK_SET;
+	fcntl(fd, F_SETLK, &fl);
+}
+
+
+// Any user can modify the registry, so its contents are copied into private
+// memory and validated rather than being accessed in place.  A registry that
+// is truncated or unrecognized is reinitialized.  The registry must be locked.
+
+void DeviceBroker::load(void)
+{
+	ssize_t bytes;
+
+	while((bytes = pread(fd, reg, sizeof(Registry), 0)) == -1)
+	{
+		if(errno != EINTR) THROW_UNIX();
+	}
+	if(bytes != (ssize_t)sizeof(Registry) || reg->magic != MAGIC)
+	{
+		memset(reg, 0, sizeof(Registry));
+		reg->magic = MAGIC;
+	}
+	for(int i = 0; i < MAXSESSIONS; i++)
+	{
+		Session &s = reg->sessions[i];
+		if(s.pid <= 0)
+		{
+			s.pid = 0;  s.device[0] = 0;
+		}
+		else s.device[MAXSTR - 1] = 0;
+	}
+}
+
+
+// The registry must be locked.
+
+void DeviceBroker::save(void)
+{
+	ssize_t bytes;
+
+	while((bytes = pwrite(fd, reg, sizeof(Registry), 0)) == -1)
+	{
+		if(errno != EINTR) THROW_UNIX();
+	}
+	if(bytes != (ssize_t)sizeof(Registry))
+		THROW("Could not write the registry");
+}
+
+
+// Remove the sessions belonging to processes that no longer exist.  The
+// registry must be locked.
+
+void DeviceBroker::purge(void)
+{
+	for(int i = 0; i < MAXSESSIONS; i++)
+	{
+		Session &s = reg->sessions[i];
+		if(s.pid <= 0) continue;
+		if(kill(s.pid, 0) == -1 && errno == ESRCH)
+		{
+			s.pid = 0;  s.device[0] = 0;
+		}
+	}
+}
+
+
+// The registry must be locked.
+
+int DeviceBroker::countSessions(const char *device)
+{
+	int count = 0;
+
+	for(int i = 0; i < MAXSESSIONS; i++)
+	{
+		Session &s = reg->sessions[i];
+		if(s.pid > 0 && !strncmp(s.device, device, MAXSTR)) count++;
+	}
+	return count;
+}
+
+
+int DeviceBroker::select(char **devices, int numDevices, int policy,
+	const int *nodes, int localNode)
+{
+	pid_t pid = getpid();
+	int i, j, selected = 0;
+
+	if(!devices || numDevices < 1) THROW("Invalid argument");
+
+	lock();
+	try
+	{
+		purge();
+		// A process that selects a device again gives up its previous session.
+		for(i = 0; i < MAXSESSIONS; i++)
+		{
+			if(reg->sessions[i].pid == pid)
+			{
+				reg->sessions[i].pid = 0;  reg->sessions[i].device[0] = 0;
+			}
+		}
+
+		if(policy == RRDPY_ROUNDROBIN)
+			selected = reg->nextDevice % (unsigned int)numDevices;
+		else
+		{
+			// With the NUMA policy, only the devices attached to the local NUMA node
+			// are considered, unless there aren't any.
+			bool localOnly = false;
+			if(policy == RRDPY_NUMA && nodes && localNode >= 0)
+			{
+				for(i = 0; i < numDevices; i++)
+					if(nodes[i] == localNode) localOnly = true;
+			}
+
+			// Ties are broken in round-robin order, so that processes that start at
+			// the same time do not all pile onto the first device.
+			int minSessions = INT_MAX;
+			for(j = 0; j < numDevices; j++)
+			{
+				i = (reg->nextDevice + j) % (unsigned int)numDevices;
+				if(localOnly && nodes[i] != localNode) continue;
+				int sessions = countSessions(devices[i]);
+				if(sessions < minSessions)
+				{
+					minSessions = sessions;  selected = i;
+				}
+			}
+		}
+		reg->nextDevice++;
+
+		// If the registry is full, then the session simply isn't counted.
+		for(i = 0; i < MAXSESSIONS; i++)
+		{
+			Session &s = reg->sessions[i];
+			if(s.pid > 0) continue;
+			strncpy(s.device, devices[selected], MAXSTR - 1);
+			s.device[MAXSTR - 1] = 0;
+			s.pid = pid;
+			break;
+		}
+		save();
+	}
+	catch(...)
+	{
+		unlock();  throw;
+	}
+	unlock();
+
+	return selected;
+}
+
+
+void DeviceBroker::release(void)
+{
+	pid_t pid = getpid();
+
+	lock();
+	bool found = false;
+	for(int i = 0; i < MAXSESSIONS; i++)
+	{
+		if(reg->sessions[i].pid == pid)
+		{
+			reg->sessions[i].pid = 0;  reg->sessions[i].device[0] = 0;
+			found = true;
+		}
+	}
+	try
+	{
+		if(found) save();
+	}
+	catch(...)
+	{
+		unlock();  throw;
+	}
+	unlock();
+}
+
+
+int DeviceBroker::getSessions(const char *device)
+{
+	int count;
+
+	if(!device) THROW("Invalid argument");
+	lock();
+	purge();
+	count = countSessions(device);
+	unlock();
+	return count;
+}
+
+
+// Return the NUMA node to which a DRI device is attached, or -1 if it is
+// unknown (which is always the case for 3D X servers.)
+
+int DeviceBroker::getDeviceNode(const char *device)
+{
+	int node = -1;
+
+	#ifdef __linux__
+	char path[PATH_MAX];
+	const char *name;
+	FILE *file;
+
+	if(!device || strncmp(device, "/dev/dri/", 9)) return -1;
+	name = &device[9];
+	if(strchr(name, '/')) return -1;
+	snprintf(path, PATH_MAX, "/sys/class/drm/%s/device/numa_node", name);
+	if((file = fopen(path, "r")) != NULL)
+	{
+		if(fscanf(file, "%d", &node) != 1) node = -1;
+		fclose(file);
+	}
+	#endif
+
+	return node;
+}
+
+
+// Return the NUMA node on which the calling thread is currently running, or
+// -1 if it is unknown
+
+int DeviceBroker::getLocalNode(void)
+{
+	int node = -1;
+
+	#ifdef __linux__
+	char path[PATH_MAX];
+	int cpu;
+	DIR *dir;
+	struct dirent *entry;
+
+	if((cpu = sched_getcpu()) < 0) return -1;
+	snprintf(path, PATH_MAX, "/sys/devices/system/cpu/cpu%d", cpu);
+	if((dir = opendir(path)) == NULL) return -1;
+	while((entry = readdir(dir)) != NULL)
+	{
+		if(!strncmp(entry->d_name, "node", 4)
+			&& sscanf(&entry->d_name[4], "%d", &node) == 1)
+			break;
+		node = -1;
+	}
+	closedir(dir);
+	#endif
+
+	return node;
+}
@@ -0,0 +1,90 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __DEVICEBROKER_H__
+#define __DEVICEBROKER_H__
+
+#include <stdlib.h>
+#include <sys/types.h>
+#include "rr.h"
+
+
+#define DEFAULT_BROKERSHM  "/VirtualGL-devices"
+
+namespace faker
+{
+	// This class selects a 3D X server or EGL device for the calling process
+	// from a list of candidates.  The number of VirtualGL sessions (processes)
+	// using each device is tracked in a registry that lives in POSIX shared
+	// memory, so all instances of the VirtualGL Faker on the host, regardless
+	// of which user is running them, see the same counts.  Access to the
+	// registry is serialized with an fcntl() lock, which the O/S releases if a
+	// process dies while holding it.  Since any user can hold the lock or
+	// modify the registry, the lock is acquired with a timeout, and the registry
+	// is validated each time it is read.  Sessions belonging to processes that
+	// have exited without unregistering are purged whenever the registry is
+	// accessed.  The counts are advisory and are never trusted for anything
+	// other than choosing a device.
+
+	class DeviceBroker
+	{
+		public:
+
+			DeviceBroker(const char *shmName = DEFAULT_BROKERSHM);
+			~DeviceBroker(void);
+
+			// Select one of numDevices devices according to policy (see enum
+			// rrdpypolicy in rr.h), register the calling process as a session on
+			// that device, and return its index.  nodes, if non-NULL, gives the NUMA
+			// node of each device (-1 if unknown), and localNode is the NUMA node
+			// on which the calling process is running (-1 if unknown.)
+			int select(char **devices, int numDevices, int policy,
+				const int *nodes = NULL, int localNode = -1);
+			// Unregister the calling process
+			void release(void);
+			// Return the number of live sessions on the specified device
+			int getSessions(const char *device);
+
+			static int getDeviceNode(const char *device);
+			static int getLocalNode(void);
+
+		private:
+
+			static const int MAXSESSIONS = 1024;
+			static const double LOCKTIMEOUT;
+			static const unsigned int MAGIC = 0x42474C56;  // "VGLB"
+
+			typedef struct
+			{
+				pid_t pid;
+				char device[MAXSTR];
+			} Session;
+
+			typedef struct
+			{
+				unsigned int magic, nextDevice;
+				Session sessions[MAXSESSIONS];
+			} Registry;
+
+			void lock(void);
+			void unlock(void);
+			void load(void);
+			void save(void);
+			void purge(void);
+			int countSessions(const char *device);
+
+			int fd;
+			Registry *reg;
+	};
+}
+
+#endif  // __DEVICEBROKER_H__
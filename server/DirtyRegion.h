@@ -0,0 +1,141 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// This class accumulates the region of an off-screen drawable that may have
+// been rendered into since the last readback, and it keeps a short history of
+// those regions so that a pooled frame buffer, which still contains the pixels
+// from the readback that last used it, can be brought up to date by reading
+// back only the regions that have changed since then.  The class is not
+// thread-safe.  The caller must serialize access to it.
+
+#ifndef __DIRTYREGION_H__
+#define __DIRTYREGION_H__
+
+#include <limits.h>
+
+
+namespace faker
+{
+	class DirtyRegion
+	{
+		public:
+
+			DirtyRegion(void) : seq(0), src(NULL), buf(0), width(0), height(0)
+			{
+				reset();
+			}
+
+			// Force the next readback into any frame buffer to be a full readback
+			void reset(void)
+			{
+				for(int i = 0; i < NSLOTS; i++)
+				{
+					slots[i].frame = slots[i].bits = NULL;  slots[i].seq = 0;
+				}
+				addFull();
+			}
+
+			// Add a rectangle, in OpenGL window coordinates, to the region that has
+			// been rendered into since the last readback
+			void add(int x, int y, int w, int h)
+			{
+				if(w <= 0 || h <= 0) return;
+				if(x < cur.x0) cur.x0 = x;
+				if(y < cur.y0) cur.y0 = y;
+				if(x + w > cur.x1) cur.x1 = x + w;
+				if(y + h > cur.y1) cur.y1 = y + h;
+			}
+
+			void addFull(void)
+			{
+				cur.x0 = cur.y0 = 0;  cur.x1 = cur.y1 = INT_MAX;
+			}
+
+			// Called once per readback.  src identifies the off-screen drawable,
+			// buf is the OpenGL buffer being read, frame and bits identify the frame
+			// buffer that is receiving the pixels, and width and height are the
+			// dimensions of the readback.  Returns the rectangle that must be read
+			// back in order to bring the frame buffer up to date (which may be
+			// empty or may be the whole frame.)
+			void get(const void *src_, int buf_, const void *frame,
+				const void *bits, int width_, int height_, int &x, int &y, int &w,
+				int &h)
+			{
+				if(src_ != src || buf_ != buf || width_ != width || height_ != height)
+				{
+					reset();
+					src = src_;  buf = buf_;  width = width_;  height = height_;
+				}
+
+				history[seq % NHISTORY] = cur;
+				seq++;
+				cur.x0 = cur.y0 = INT_MAX;  cur.x1 = cur.y1 = INT_MIN;
+
+				Slot *slot = NULL, *oldest = &slots[0];
+				for(int i = 0; i < NSLOTS; i++)
+				{
+					if(slots[i].frame == frame && slots[i].bits == bits)
+						slot = &slots[i];
+					if(!slots[i].frame || slots[i].seq < oldest->seq)
+						oldest = &slots[i];
+				}
+
+				Rect r;
+				if(!slot || seq - slot->seq > NHISTORY)
+				{
+					r.x0 = r.y0 = 0;  r.x1 = r.y1 = INT_MAX;
+					if(!slot) slot = oldest;
+				}
+				else
+				{
+					r.x0 = r.y0 = INT_MAX;  r.x1 = r.y1 = INT_MIN;
+					for(unsigned int i = slot->seq; i != seq; i++)
+					{
+						Rect &hr = history[i % NHISTORY];
+						if(hr.x0 < r.x0) r.x0 = hr.x0;
+						if(hr.y0 < r.y0) r.y0 = hr.y0;
+						if(hr.x1 > r.x1) r.x1 = hr.x1;
+						if(hr.y1 > r.y1) r.y1 = hr.y1;
+					}
+				}
+				slot->frame = frame;  slot->bits = bits;  slot->seq = seq;
+
+				if(r.x0 < 0) r.x0 = 0;
+				if(r.y0 < 0) r.y0 = 0;
+				if(r.x1 > width) r.x1 = width;
+				if(r.y1 > height) r.y1 = height;
+				if(r.x0 >= r.x1 || r.y0 >= r.y1) { x = y = w = h = 0;  return; }
+				x = r.x0;  y = r.y0;  w = r.x1 - r.x0;  h = r.y1 - r.y0;
+			}
+
+		private:
+
+			// The history must be at least as deep as the frame pool, or frames
+			// that are reused round-robin will always be read back in full.
+			static const int NHISTORY = 8, NSLOTS = 4;
+
+			typedef struct { int x0, y0, x1, y1; } Rect;
+			typedef struct
+			{
+				const void *frame, *bits;
+				unsigned int seq;
+			} Slot;
+
+			Rect cur, history[NHISTORY];
+			Slot slots[NSLOTS];
+			unsigned int seq;
+			const void *src;
+			int buf, width, height;
+	};
+}
+
+#endif  // __DIRTYREGION_H__
@@ -26,7 +26,7 @@ GLXDrawable FakePbuffer::nextID = 1;
 
 FakePbuffer::FakePbuffer(Display *dpy_, VGLFBConfig config_,
 	const int *glxAttribs) : dpy(dpy_), config(config_), id(0), fbo(0),
-	rbod(0), width(0), height(0)
+	rbod(0), width(0), height(0), refCount(1)
 {
 	for(int i = 0; i < 4; i++) rboc[i] = 0;
 
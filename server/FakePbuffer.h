@@ -41,6 +41,20 @@ namespace backend
 			void setReadBuffer(GLenum readBuf, bool deferred);
 			void swap(void);
 
+			// FakePbuffer instances are reference counted, so that an instance that
+			// is cached as part of another thread's current state is not deleted
+			// until that thread releases it.  The Pbuffer hash holds the initial
+			// reference.
+			void addRef(void)
+			{
+				__atomic_add_fetch(&refCount, 1, __ATOMIC_RELAXED);
+			}
+
+			void release(void)
+			{
+				if(__atomic_sub_fetch(&refCount, 1, __ATOMIC_ACQ_REL) == 0) delete this;
+			}
+
 		private:
 
 			void destroy(bool errorCheck);
@@ -51,6 +65,7 @@ namespace backend
 			// 0 = front left, 1 = back left, 2 = front right, 3 = back right
 			GLuint fbo, rboc[4], rbod;
 			int width, height;
+			int refCount;
 			static util::CriticalSection idMutex;
 			static GLXDrawable nextID;
 	};
@@ -0,0 +1,281 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "FontHash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "Log.h"
+#include "fakerconfig.h"
+
+using namespace faker;
+
+FontHash *FontHash::instance = NULL;
+util::CriticalSection FontHash::instanceMutex;
+
+#define HASH  Hash<char *, char *, FontGlyphs *>
+
+
+// The persistent cache contains one file per font.  The file begins with
+// a magic number, the X server identifier, and the font name, followed by one
+// record (character code, metrics, and bitmap) per glyph.  The file is only
+// ever read by the host that wrote it, so native byte order is used.
+
+static const char magic[8] = { 'V', 'G', 'L', 'G', 'L', 'Y', 'P', 'H' };
+
+
+FontGlyphs *FontHash::find(Display *dpy, const char *name)
+{
+	char server[MAXSTR];
+	FontGlyphs *glyphs = NULL;
+
+	if(!dpy || !name) THROW("Invalid argument");
+
+	// Glyphs rendered by the same X server release using the same font name
+	// should be identical, irrespective of the display string used to reach
+	// the X server.
+	snprintf(server, MAXSTR, "%s %d", ServerVendor(dpy), VendorRelease(dpy));
+
+	util::CriticalSection::SafeLock l(mutex);
+	if((glyphs = HASH::find(server, (char *)name)) == NULL)
+	{
+		glyphs = new FontGlyphs(server, name);
+		if(strlen(fconfig.fontcache) > 0) glyphs->load(fconfig.fontcache);
+		HASH::add(strdup(server), strdup(name), glyphs);
+	}
+	return glyphs;
+}
+
+
+FontGlyphs::FontGlyphs(const char *server_, const char *name_) : dirty(false)
+{
+	server = strdup(server_);  name = strdup(name_);
+	memset(pages, 0, sizeof(Glyph **) * 256);
+}
+
+
+FontGlyphs::~FontGlyphs(void)
+{
+	for(int i = 0; i < 256; i++)
+	{
+		if(!pages[i]) continue;
+		for(int j = 0; j < 256; j++) free(pages[i][j]);
+		free(pages[i]);
+	}
+	free(server);  free(name);
+}
+
+
+// Return the cached bitmap for character c, provided that the glyph metrics
+// match those reported by the X server.
+
+const unsigned char *FontGlyphs::find(unsigned int c, XCharStruct *cs)
+{
+	util::CriticalSection::SafeLock l(mutex);
+	Glyph *glyph;
+
+	if(c > 65535 || !pages[c >> 8] || !(glyph = pages[c >> 8][c & 0xff]))
+		return NULL;
+	if(glyph->lbearing != cs->lbearing || glyph->rbearing != cs->rbearing
+		|| glyph->ascent != cs->ascent || glyph->descent != cs->descent)
+		return NULL;
+	return glyph->bits;
+}
+
+
+const unsigned char *FontGlyphs::add(unsigned int c, XCharStruct *cs,
+	const unsigned char *bits)
+{
+	util::CriticalSection::SafeLock l(mutex);
+	Glyph *glyph;
+	int size = bitmapSize(cs);
+
+	if(c > 65535 || size < 1) THROW("Invalid argument");
+	if(!pages[c >> 8])
+	{
+		if((pages[c >> 8] = (Glyph **)calloc(256, sizeof(Glyph *))) == NULL)
+			THROW("Memory allocation error");
+	}
+	if((glyph = pages[c >> 8][c & 0xff]) != NULL)
+	{
+		// Glyphs are never replaced, because callers may be using the old bitmap.
+		// If the metrics changed, then the new bitmap simply isn't cached.
+		if(glyph->lbearing == cs->lbearing && glyph->rbearing == cs->rbearing
+			&& glyph->ascent == cs->ascent && glyph->descent == cs->descent)
+			return glyph->bits;
+		return NULL;
+	}
+	if((glyph = (Glyph *)malloc(sizeof(Glyph) + size)) == NULL)
+		THROW("Memory allocation error");
+	glyph->lbearing = cs->lbearing;  glyph->rbearing = cs->rbearing;
+	glyph->ascent = cs->ascent;  glyph->descent = cs->descent;
+	memcpy(glyph->bits, bits, size);
+	pages[c >> 8][c & 0xff] = glyph;
+	dirty = true;
+	return glyph->bits;
+}
+
+
+char *FontGlyphs::getFileName(const char *dir)
+{
+	// 64-bit FNV-1a hash of the X server identifier and font name
+	unsigned long long hash = 14695981039346656037ULL;
+	const char *strs[2] = { server, name };
+	char *fileName;
+
+	for(int i = 0; i < 2; i++)
+	{
+		for(const char *ptr = strs[i]; ; ptr++)
+		{
+			hash = (hash ^ (unsigned char)*ptr) * 1099511628211ULL;
+			if(!*ptr) break;
+		}
+	}
+	if((fileName = (char *)malloc(strlen(dir) + 32)) == NULL)
+		THROW("Memory allocation error");
+	sprintf(fileName, "%s/%016llx.glyphs", dir, hash);
+	return fileName;
+}
+
+
+static bool readString(FILE *file, const char *expected)
+{
+	unsigned int len;
+	char buf[MAXSTR];
+
+	if(fread(&len, sizeof(len), 1, file) != 1 || len != strlen(expected)
+		|| len >= MAXSTR || fread(buf, 1, len, file) != len)
+		return false;
+	return !memcmp(buf, expected, len);
+}
+
+
+static bool writeString(FILE *file, const char *str)
+{
+	unsigned int len = strlen(str);
+
+	return fwrite(&len, sizeof(len), 1, file) == 1
+		&& fwrite(str, 1, len, file) == len;
+}
+
+
+// Load the glyphs for this font from the persistent cache.  A missing,
+// truncated, or mismatched cache file is not an error.  The glyphs simply have
+// to be rasterized again.
+
+void FontGlyphs::load(const char *dir)
+{
+	char *fileName = getFileName(dir), buf[8];
+	FILE *file;
+
+	if((file = fopen(fileName, "rb")) == NULL)
+	{
+		free(fileName);  return;
+	}
+	if(fread(buf, 1, 8, file) == 8 && !memcmp(buf, magic, 8)
+		&& readString(file, server) && readString(file, name))
+	{
+		unsigned int c;
+		XCharStruct cs;
+		unsigned char *bits = NULL;
+		short metrics[4];
+
+		memset(&cs, 0, sizeof(XCharStruct));
+		while(fread(&c, sizeof(c), 1, file) == 1
+			&& fread(metrics, sizeof(short), 4, file) == 4)
+		{
+			cs.lbearing = metrics[0];  cs.rbearing = metrics[1];
+			cs.ascent = metrics[2];  cs.descent = metrics[3];
+			int size = bitmapSize(&cs);
+			if(c > 65535 || size < 1 || size > 65536) break;
+			unsigned char *newBits = (unsigned char *)realloc(bits, size);
+			if(!newBits) break;
+			bits = newBits;
+			if(fread(bits, 1, size, file) != (size_t)size) break;
+			add(c, &cs, bits);
+		}
+		free(bits);
+		if(fconfig.verbose)
+			vglout.println("[VGL] Loaded cached glyphs for font %s from %s", name,
+				fileName);
+	}
+	fclose(file);
+	free(fileName);
+	dirty = false;
+}
+
+
+// Write all of the glyphs for this font to the persistent cache.  The file
+// is written under a temporary name and then renamed, so that concurrent
+// processes never see a partially-written file.  The cache directory may be
+// shared, so the temporary file is created exclusively rather than following
+// an existing file or symlink with the same name.
+
+void FontGlyphs::save(const char *dir)
+{
+	util::CriticalSection::SafeLock l(mutex);
+	char *fileName, *tempName;
+	FILE *file = NULL;
+	int fd;
+	bool ok;
+
+	if(!dirty) return;
+	fileName = getFileName(dir);
+	if((tempName = (char *)malloc(strlen(fileName) + 16)) == NULL)
+	{
+		free(fileName);  THROW("Memory allocation error");
+	}
+	sprintf(tempName, "%s.%d", fileName, (int)getpid());
+	if((fd = open(tempName, O_WRONLY | O_CREAT | O_EXCL, 0666)) < 0
+		|| (file = fdopen(fd, "wb")) == NULL)
+	{
+		if(fd >= 0) { close(fd);  unlink(tempName); }
+		if(fconfig.verbose)
+			vglout.println("[VGL] WARNING: Could not write glyph cache file %s",
+				tempName);
+		free(tempName);  free(fileName);  dirty = false;
+		return;
+	}
+	ok = fwrite(magic, 1, 8, file) == 8 && writeString(file, server)
+		&& writeString(file, name);
+	for(unsigned int i = 0; i < 256 && ok; i++)
+	{
+		if(!pages[i]) continue;
+		for(unsigned int j = 0; j < 256 && ok; j++)
+		{
+			Glyph *glyph = pages[i][j];
+			if(!glyph) continue;
+			unsigned int c = (i << 8) | j;
+			short metrics[4] = { glyph->lbearing, glyph->rbearing, glyph->ascent,
+				glyph->descent };
+			XCharStruct cs;
+			cs.lbearing = glyph->lbearing;  cs.rbearing = glyph->rbearing;
+			cs.ascent = glyph->ascent;  cs.descent = glyph->descent;
+			size_t size = bitmapSize(&cs);
+			ok = fwrite(&c, sizeof(c), 1, file) == 1
+				&& fwrite(metrics, sizeof(short), 4, file) == 4
+				&& fwrite(glyph->bits, 1, size, file) == size;
+		}
+	}
+	if(fclose(file) != 0) ok = false;
+	if(!ok || rename(tempName, fileName) != 0)
+	{
+		unlink(tempName);
+		if(fconfig.verbose)
+			vglout.println("[VGL] WARNING: Could not write glyph cache file %s",
+				fileName);
+	}
+	free(tempName);  free(fileName);
+	dirty = false;
+}
@@ -0,0 +1,119 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __FONTHASH_H__
+#define __FONTHASH_H__
+
+#include <X11/Xlib.h>
+#include "Hash.h"
+
+
+namespace faker
+{
+	// The glyph bitmaps that glXUseXFont() has rasterized for a particular X
+	// font, in the format expected by glBitmap().  Glyphs are only ever added,
+	// so a pointer returned by find() remains valid until the cache is
+	// destroyed.
+
+	class FontGlyphs
+	{
+		public:
+
+			FontGlyphs(const char *server, const char *name);
+			~FontGlyphs(void);
+			const unsigned char *find(unsigned int c, XCharStruct *cs);
+			const unsigned char *add(unsigned int c, XCharStruct *cs,
+				const unsigned char *bits);
+			void load(const char *dir);
+			void save(const char *dir);
+
+		private:
+
+			typedef struct
+			{
+				short lbearing, rbearing, ascent, descent;
+				unsigned char bits[1];
+			} Glyph;
+
+			static int bitmapSize(XCharStruct *cs)
+			{
+				return (cs->rbearing - cs->lbearing + 7) / 8 *
+					(cs->ascent + cs->descent);
+			}
+
+			char *getFileName(const char *dir);
+
+			char *server, *name;
+			// Glyphs are stored in 256 pages of 256 glyphs each, which are
+			// allocated on demand.
+			Glyph **pages[256];
+			bool dirty;
+			util::CriticalSection mutex;
+	};
+}
+
+
+#define HASH  Hash<char *, char *, FontGlyphs *>
+
+// This maps an X server identifier and a font name to the glyph bitmaps that
+// have been rasterized for that font
+
+namespace faker
+{
+	class FontHash : public HASH
+	{
+		public:
+
+			static FontHash *getInstance(void)
+			{
+				if(instance == NULL)
+				{
+					util::CriticalSection::SafeLock l(instanceMutex);
+					if(instance == NULL) instance = new FontHash;
+				}
+				return instance;
+			}
+
+			static bool isAlloc(void) { return instance != NULL; }
+
+			FontGlyphs *find(Display *dpy, const char *name);
+
+		private:
+
+			~FontHash(void)
+			{
+				HASH::kill();
+			}
+
+			bool compare(char *key1, char *key2, HashEntry *entry)
+			{
+				return !strcmp(key1, entry->key1) && !strcmp(key2, entry->key2);
+			}
+
+			void detach(HashEntry *entry)
+			{
+				free(entry->key1);
+				free(entry->key2);
+				delete entry->value;
+			}
+
+			static FontHash *instance;
+			static util::CriticalSection instanceMutex;
+	};
+}
+
+#undef HASH
+
+
+#define fonthash  (*(faker::FontHash::getInstance()))
+
+#endif  // __FONTHASH_H__
@@ -0,0 +1,428 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "FrameCapture.h"
+#include "fakerconfig.h"
+#include "vglutil.h"
+#include "Log.h"
+#include "bmp.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#ifdef USEHELGRIND
+	#include <valgrind/helgrind.h>
+#endif
+
+using namespace util;
+using namespace common;
+using namespace server;
+
+
+static int killToken = 0;
+
+
+FrameCapture::Item::~Item(void)
+{
+	while(tiles)
+	{
+		Tile *next = tiles->next;
+		delete [] tiles->bits;  delete tiles;
+		tiles = next;
+	}
+}
+
+
+void FrameCapture::Item::addTile(CompressedFrame &cf)
+{
+	if(cf.hdr.compress != RRCOMP_JPEG || !cf.bits || cf.hdr.size < 1) return;
+
+	Tile *tile = new Tile;
+	tile->hdr = cf.hdr;
+	tile->bits = new unsigned char[cf.hdr.size];
+	memcpy(tile->bits, cf.bits, cf.hdr.size);
+	CriticalSection::SafeLock l(mutex);
+	tile->next = tiles;  tiles = tile;
+}
+
+
+FrameCapture *FrameCapture::instance = NULL;
+CriticalSection FrameCapture::instanceMutex;
+volatile sig_atomic_t FrameCapture::signalCount = 0;
+
+
+FrameCapture *FrameCapture::getInstance(void)
+{
+	#ifdef USEHELGRIND
+	ANNOTATE_BENIGN_RACE_SIZED(&instance, sizeof(FrameCapture *), );
+	#endif
+	if(instance == NULL)
+	{
+		CriticalSection::SafeLock l(instanceMutex);
+		if(instance == NULL) instance = new FrameCapture;
+	}
+	return instance;
+}
+
+
+FrameCapture::FrameCapture(void) : thread(NULL), numQueued(0), seq(0),
+	dropped(0), deadYet(false), yuv(NULL), yuvSize(0), streams(NULL),
+	tjhnd(NULL)
+{
+	struct sigaction sa, oldsa;
+
+	// Don't take SIGUSR2 away from an application that uses it.
+	if(sigaction(SIGUSR2, NULL, &oldsa) == 0 && oldsa.sa_handler == SIG_DFL
+		&& !(oldsa.sa_flags & SA_SIGINFO))
+	{
+		memset(&sa, 0, sizeof(struct sigaction));
+		sa.sa_handler = handleSignal;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR2, &sa, NULL);
+	}
+	else
+		vglout.println("[VGL] WARNING: The application handles SIGUSR2, so frames will be captured\n[VGL]    only at the interval specified by VGL_CAPTUREINTERVAL.");
+	if(fconfig.verbose)
+		vglout.println("[VGL] Capturing frames to %s (%s)", fconfig.capture,
+			fconfig.captureformat == RRCAPTURE_Y4M ? "Y4M" :
+			fconfig.captureformat == RRCAPTURE_BMP ? "BMP" : "PPM");
+	#ifdef USEHELGRIND
+	ANNOTATE_BENIGN_RACE_SIZED(&signalCount, sizeof(sig_atomic_t), );
+	#endif
+}
+
+
+void FrameCapture::handleSignal(int sig)
+{
+	signalCount = signalCount + 1;
+}
+
+
+void FrameCapture::kill(void)
+{
+	Thread *t;
+
+	{
+		CriticalSection::SafeLock l(mutex);
+		if(deadYet) return;
+		deadYet = true;
+		t = thread;  thread = NULL;
+	}
+	if(t)
+	{
+		// The token is queued behind any frames that have not yet been written,
+		// so they are written before the capture thread exits.
+		q.add(&killToken);
+		t->stop();
+		delete t;
+	}
+	if(dropped > 0 && fconfig.verbose)
+		vglout.println("[VGL] %u captured frames were dropped because the capture queue was full",
+			dropped);
+}
+
+
+bool FrameCapture::select(Selector &sel)
+{
+	bool selected = false;
+	int signals = signalCount;
+
+	if(fconfig.captureinterval > 0
+		&& sel.count++ % fconfig.captureinterval == 0)
+		selected = true;
+	if(signals != sel.signalCount)
+	{
+		sel.signalCount = signals;  selected = true;
+	}
+	return selected;
+}
+
+
+FrameCapture::Item *FrameCapture::reserve(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	if(deadYet) return NULL;
+	if(numQueued >= MAXQUEUED)
+	{
+		dropped++;  return NULL;
+	}
+	if(!thread)
+	{
+		thread = new Thread(this);
+		thread->start();
+	}
+	numQueued++;
+	return new Item(++seq);
+}
+
+
+void FrameCapture::capture(Frame &f, unsigned int winid)
+{
+	Item *item = reserve();
+
+	if(item) submit(item, f, winid);
+}
+
+
+void FrameCapture::submit(Item *item, Frame &f, unsigned int winid)
+{
+	if(!item) return;
+	// A capture problem should never disrupt the application, so any error is
+	// reported and the frame is dropped.
+	try
+	{
+		item->winid = winid;
+		copyFrame(item->frame, f);
+	}
+	catch(std::exception &e)
+	{
+		vglout.println("[VGL] WARNING: Could not capture frame %u:", item->seq);
+		vglout.println("[VGL]    %s", e.what());
+		discard(item);
+		return;
+	}
+	q.add(item);
+}
+
+
+void FrameCapture::discard(Item *item)
+{
+	if(!item) return;
+	delete item;
+	CriticalSection::SafeLock l(mutex);
+	numQueued--;
+}
+
+
+void FrameCapture::copyFrame(Frame &dst, Frame &src)
+{
+	if(!src.bits || src.hdr.width < 1 || src.hdr.height < 1)
+		THROW("Frame not initialized");
+
+	rrframeheader hdr = src.hdr;
+	hdr.x = hdr.y = 0;
+	hdr.framew = hdr.width;  hdr.frameh = hdr.height;
+	hdr.size = 0;
+	dst.init(hdr, src.pf->id, src.flags & FRAME_BOTTOMUP, false);
+	for(int i = 0; i < hdr.height; i++)
+		memcpy(&dst.bits[dst.pitch * i], &src.bits[src.pitch * i],
+			hdr.width * src.pf->size);
+}
+
+
+void FrameCapture::run(void)
+{
+	#ifdef __linux__
+	// Linux applies the nice value to individual threads, so this does not
+	// affect the application's threads.
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+	#endif
+
+	while(1)
+	{
+		void *ptr = NULL;
+
+		q.get(&ptr);
+		if(!ptr || ptr == (void *)&killToken) break;
+		Item *item = (Item *)ptr;
+		write(item);
+		discard(item);
+	}
+
+	while(streams)
+	{
+		Stream *next = streams->next;
+		for(int i = 0; i < 2; i++)
+			if(streams->file[i]) fclose(streams->file[i]);
+		delete streams;
+		streams = next;
+	}
+	delete [] yuv;  yuv = NULL;
+	if(tjhnd)
+	{
+		tjDestroy(tjhnd);  tjhnd = NULL;
+	}
+}
+
+
+void FrameCapture::write(Item *item)
+{
+	try
+	{
+		Frame *decodedFrame = decode(item);
+		if(fconfig.captureformat == RRCAPTURE_Y4M)
+			writeY4M(item, decodedFrame);
+		else writeImages(item, decodedFrame);
+	}
+	catch(std::exception &e)
+	{
+		vglout.println("[VGL] WARNING: Could not write captured frame %u:",
+			item->seq);
+		vglout.println("[VGL]    %s", e.what());
+	}
+}
+
+
+// Reconstruct the image that the client will display by decoding the JPEG
+// tiles that were sent.  Tiles that were not sent, because they had not
+// changed since the previous frame, are taken from the uncompressed frame.
+
+Frame *FrameCapture::decode(Item *item)
+{
+	if(!item->tiles) return NULL;
+
+	toRGB(item->frame, decoded);
+	if(!tjhnd)
+	{
+		if((tjhnd = tjInitDecompress()) == NULL)
+			throw(Error("FrameCapture::decode", tjGetErrorStr()));
+	}
+	for(Item::Tile *tile = item->tiles; tile; tile = tile->next)
+	{
+		if(tile->hdr.x + tile->hdr.width > decoded.hdr.width
+			|| tile->hdr.y + tile->hdr.height > decoded.hdr.height)
+			continue;
+		TRY_TJ(tjDecompress2(tjhnd, tile->bits, tile->hdr.size,
+			&decoded.bits[decoded.pitch * tile->hdr.y +
+				tile->hdr.x * decoded.pf->size],
+			tile->hdr.width, decoded.pitch, tile->hdr.height, TJPF_RGB, 0));
+	}
+	return &decoded;
+}
+
+
+// Convert a frame to top-down RGB
+
+void FrameCapture::toRGB(Frame &src, Frame &dst)
+{
+	rrframeheader hdr = src.hdr;
+	int width = src.hdr.width, height = src.hdr.height;
+
+	hdr.size = 0;
+	dst.init(hdr, PF_RGB, 0, false);
+	if(src.flags & FRAME_BOTTOMUP)
+	{
+		for(int i = 0; i < height; i++)
+			src.pf->convert(&src.bits[src.pitch * (height - i - 1)], width,
+				src.pitch, 1, &dst.bits[dst.pitch * i], dst.pitch, dst.pf);
+	}
+	else
+		src.pf->convert(src.bits, width, src.pitch, height, dst.bits, dst.pitch,
+			dst.pf);
+}
+
+
+void FrameCapture::writeImages(Item *item, Frame *decodedFrame)
+{
+	Frame &f = item->frame;
+	char filename[MAXSTR + 64];
+	const char *ext = fconfig.captureformat == RRCAPTURE_BMP ? "bmp" : "ppm";
+
+	snprintf(filename, MAXSTR + 64, "%s/vgl-%d-%.8x-%06u.%s", fconfig.capture,
+		getpid(), item->winid, item->seq, ext);
+	if(bmp_save(filename, f.bits, f.hdr.width, f.pitch, f.hdr.height, f.pf->id,
+		(f.flags & FRAME_BOTTOMUP) ? BMPORN_BOTTOMUP : BMPORN_TOPDOWN) == -1)
+		throw(Error(filename, bmp_geterr()));
+
+	if(decodedFrame)
+	{
+		snprintf(filename, MAXSTR + 64, "%s/vgl-%d-%.8x-%06u-jpeg.%s",
+			fconfig.capture, getpid(), item->winid, item->seq, ext);
+		if(bmp_save(filename, decodedFrame->bits, decodedFrame->hdr.width,
+			decodedFrame->pitch, decodedFrame->hdr.height, PF_RGB,
+			BMPORN_TOPDOWN) == -1)
+			throw(Error(filename, bmp_geterr()));
+	}
+}
+
+
+// Frames from the same window are appended to a pair of Y4M sequences, one for
+// the uncompressed frames and one for the decoded frames.  Y4M sequences have
+// fixed dimensions, so new sequences are started if the window is resized.
+
+void FrameCapture::writeY4M(Item *item, Frame *decodedFrame)
+{
+	Frame &f = item->frame;
+	Stream *s;
+
+	for(s = streams; s; s = s->next)
+		if(s->winid == item->winid) break;
+	if(!s)
+	{
+		s = new Stream;
+		memset(s, 0, sizeof(Stream));
+		s->winid = item->winid;
+		s->next = streams;  streams = s;
+	}
+	if(s->width != f.hdr.width || s->height != f.hdr.height)
+	{
+		for(int i = 0; i < 2; i++)
+		{
+			if(s->file[i]) fclose(s->file[i]);
+			s->file[i] = NULL;
+		}
+		s->seq = item->seq;
+		s->width = f.hdr.width;  s->height = f.hdr.height;
+	}
+
+	toRGB(f, rgb);
+	writeY4MFrame(s, 0, rgb);
+	if(decodedFrame) writeY4MFrame(s, 1, *decodedFrame);
+}
+
+
+void FrameCapture::writeY4MFrame(Stream *s, int index, Frame &f)
+{
+	int width = f.hdr.width, height = f.hdr.height, planeSize = width * height;
+
+	if(!s->file[index])
+	{
+		char filename[MAXSTR + 64];
+		snprintf(filename, MAXSTR + 64, "%s/vgl-%d-%.8x-%06u%s.y4m",
+			fconfig.capture, getpid(), s->winid, s->seq, index ? "-jpeg" : "");
+		if((s->file[index] = fopen(filename, "wb")) == NULL)
+			throw(Error(filename, strerror(errno)));
+		// The frame rate is nominal, since frames are captured at irregular
+		// intervals.
+		if(fprintf(s->file[index],
+			"YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C444 XCOLORRANGE=FULL\n", width,
+			height) < 1)
+			THROW("Write error");
+	}
+
+	if(yuvSize < planeSize * 3)
+	{
+		delete [] yuv;  yuv = NULL;  yuvSize = 0;
+		yuv = new unsigned char[planeSize * 3];
+		yuvSize = planeSize * 3;
+	}
+
+	// Full-range BT.601 (JFIF) color conversion, as used by the JPEG codec
+	unsigned char *y = yuv, *u = &yuv[planeSize], *v = &yuv[planeSize * 2];
+	for(int j = 0; j < height; j++)
+	{
+		unsigned char *rgbPtr = &f.bits[f.pitch * j];
+		for(int i = 0; i < width; i++, rgbPtr += 3)
+		{
+			int r = rgbPtr[0], g = rgbPtr[1], b = rgbPtr[2];
+			*y++ = (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+			*u++ = min((-11059 * r - 21709 * g + 32768 * b + 8421376) >> 16, 255);
+			*v++ = min((32768 * r - 27439 * g - 5329 * b + 8421376) >> 16, 255);
+		}
+	}
+	if(fprintf(s->file[index], "FRAME\n") < 1
+		|| fwrite(yuv, planeSize * 3, 1, s->file[index]) != 1)
+		THROW("Write error");
+}
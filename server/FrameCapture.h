@@ -0,0 +1,144 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __FRAMECAPTURE_H__
+#define __FRAMECAPTURE_H__
+
+#include <signal.h>
+#include "Frame.h"
+#include "GenericQ.h"
+#include "Thread.h"
+
+
+namespace server
+{
+	// This class saves copies of selected frames to disk (see VGL_CAPTURE), so
+	// that image quality problems can be diagnosed without reproducing them.  A
+	// frame is selected every VGL_CAPTUREINTERVAL frames and whenever the
+	// process receives SIGUSR2.  The frame is copied into a bounded queue, and
+	// a low-priority thread writes it to disk, along with the image decoded
+	// from the JPEG tiles that were sent to the client (VGL Transport only.)
+	// The threads that read back and compress the frames never wait for the
+	// capture thread.  If the queue is full, then the frame is dropped.
+
+	class FrameCapture : public util::Runnable
+	{
+		public:
+
+			// Per-window state used to select the frames to capture
+			class Selector
+			{
+				public:
+
+					Selector(void) : count(0),
+						signalCount(FrameCapture::signalCount) {}
+
+				private:
+
+					unsigned int count;
+					int signalCount;
+					friend class FrameCapture;
+			};
+
+			// A captured frame that is being assembled by the VGL Transport
+			class Item
+			{
+				public:
+
+					// Save a copy of a compressed tile.  This can be called from
+					// multiple compression threads simultaneously.
+					void addTile(common::CompressedFrame &cf);
+
+				private:
+
+					Item(unsigned int seq_) : seq(seq_), winid(0), tiles(NULL) {}
+					~Item(void);
+
+					typedef struct TileStruct
+					{
+						rrframeheader hdr;  unsigned char *bits;
+						struct TileStruct *next;
+					} Tile;
+
+					unsigned int seq, winid;
+					common::Frame frame;
+					Tile *tiles;
+					util::CriticalSection mutex;
+					friend class FrameCapture;
+			};
+
+			static FrameCapture *getInstance(void);
+			static bool isAlloc(void) { return instance != NULL; }
+
+			// Return true if the frame that a window is about to send should be
+			// captured
+			bool select(Selector &sel);
+			// Queue a copy of an uncompressed frame
+			void capture(common::Frame &f, unsigned int winid);
+			// Reserve a slot in the queue for a frame that is about to be
+			// compressed.  Returns NULL if the queue is full.
+			Item *reserve(void);
+			// Queue a copy of the frame along with any tiles that were added to
+			// the item while the frame was being compressed
+			void submit(Item *item, common::Frame &f, unsigned int winid);
+			// Release a reserved slot without queueing the frame
+			void discard(Item *item);
+			// Write the frames that are in the queue and stop the capture thread
+			void kill(void);
+
+		private:
+
+			FrameCapture(void);
+			~FrameCapture(void) { kill(); }
+			void copyFrame(common::Frame &dst, common::Frame &src);
+			void run(void);
+			void write(Item *item);
+			void writeImages(Item *item, common::Frame *decoded);
+			void writeY4M(Item *item, common::Frame *decoded);
+			common::Frame *decode(Item *item);
+			void toRGB(common::Frame &src, common::Frame &dst);
+			static void handleSignal(int sig);
+
+			// A pair of Y4M sequences (uncompressed and decoded) for one window
+			typedef struct StreamStruct
+			{
+				unsigned int winid, seq;  int width, height;
+				FILE *file[2];
+				struct StreamStruct *next;
+			} Stream;
+
+			void writeY4MFrame(Stream *s, int index, common::Frame &f);
+
+			// Each queued frame occupies as much memory as the frame buffer, so
+			// the queue is kept short.
+			static const int MAXQUEUED = 4;
+
+			static FrameCapture *instance;
+			static util::CriticalSection instanceMutex;
+			static volatile sig_atomic_t signalCount;
+
+			util::CriticalSection mutex;
+			util::GenericQ q;
+			util::Thread *thread;
+			int numQueued;
+			unsigned int seq, dropped;
+			bool deadYet;
+
+			// These are used only by the capture thread.
+			common::Frame decoded, rgb;
+			unsigned char *yuv;  int yuvSize;
+			Stream *streams;
+			tjhandle tjhnd;
+	};
+}
+
+#endif  // __FRAMECAPTURE_H__
@@ -20,6 +20,13 @@
 
 
 // Generic hash table template class
+//
+// The table is read far more often than it is modified, so lookups through
+// find() only acquire rwlock for reading and never block each other.  All
+// other operations, including those that subclasses perform, are serialized
+// by mutex (which is recursive), and the list is only modified while holding
+// both mutex and rwlock (for writing.)  Thus, a thread that holds mutex can
+// walk the list without acquiring rwlock.
 
 namespace faker
 {
@@ -66,17 +73,18 @@ namespace faker
 
 				if((entry = findEntry(key1, key2)) != NULL)
 				{
-					if(value) entry->value = value;
+					if(value) setValue(entry, value);
 					if(useRef) entry->refCount++;
 					return 0;
 				}
 				entry = new HashEntry;
 				memset(entry, 0, sizeof(HashEntry));
+				entry->key1 = key1;  entry->key2 = key2;  entry->value = value;
+				if(useRef) entry->refCount = 1;
+				util::ReadWriteLock::SafeWriteLock wl(rwlock);
 				entry->prev = end;  if(end) end->next = entry;
 				if(!start) start = entry;
 				end = entry;
-				end->key1 = key1;  end->key2 = key2;  end->value = value;
-				if(useRef) end->refCount = 1;
 				count++;
 				return 1;
 			}
@@ -84,16 +92,37 @@ namespace faker
 			HashValueType find(HashKeyType1 key1, HashKeyType2 key2)
 			{
 				HashEntry *entry = NULL;
-				util::CriticalSection::SafeLock l(mutex);
 
+				{
+					util::ReadWriteLock::SafeReadLock rl(rwlock);
+					if((entry = lookup(key1, key2)) == NULL) return (HashValueType)0;
+					if(entry->value) return entry->value;
+				}
+
+				// The value has to be created, which may take a while, so do that
+				// without holding rwlock.
+				util::CriticalSection::SafeLock l(mutex);
 				if((entry = findEntry(key1, key2)) != NULL)
 				{
-					if(!entry->value) entry->value = attach(key1, key2);
+					if(!entry->value) setValue(entry, attach(key1, key2));
 					return entry->value;
 				}
 				return (HashValueType)0;
 			}
 
+			// Like find(), but the value is passed to ref() while rwlock is held, so
+			// the subclass can take a reference to it before another thread can
+			// remove the entry and detach the value.  The value is not created if it
+			// does not exist.
+			HashValueType findRef(HashKeyType1 key1, HashKeyType2 key2)
+			{
+				util::ReadWriteLock::SafeReadLock rl(rwlock);
+				HashEntry *entry = lookup(key1, key2);
+				if(!entry || !entry->value) return (HashValueType)0;
+				ref(entry->value);
+				return entry->value;
+			}
+
 			void remove(HashKeyType1 key1, HashKeyType2 key2, bool useRef = false)
 			{
 				HashEntry *entry = NULL;
@@ -110,30 +139,35 @@ namespace faker
 
 			HashEntry *findEntry(HashKeyType1 key1, HashKeyType2 key2)
 			{
-				HashEntry *entry = NULL;
 				util::CriticalSection::SafeLock l(mutex);
 
-				entry = start;
-				while(entry != NULL)
-				{
-					if((entry->key1 == key1 && entry->key2 == key2)
-						|| compare(key1, key2, entry))
-					{
-						return entry;
-					}
-					entry = entry->next;
-				}
-				return NULL;
+				return lookup(key1, key2);
+			}
+
+			// Subclasses must use this to change the value of an existing entry, and
+			// the value must be fully initialized, since find() may return it
+			// immediately.
+			void setValue(HashEntry *entry, HashValueType value)
+			{
+				util::CriticalSection::SafeLock l(mutex);
+				util::ReadWriteLock::SafeWriteLock wl(rwlock);
+
+				entry->value = value;
 			}
 
 			void killEntry(HashEntry *entry)
 			{
 				util::CriticalSection::SafeLock l(mutex);
 
-				if(entry->prev) entry->prev->next = entry->next;
-				if(entry->next) entry->next->prev = entry->prev;
-				if(entry == start) start = entry->next;
-				if(entry == end) end = entry->prev;
+				{
+					util::ReadWriteLock::SafeWriteLock wl(rwlock);
+					if(entry->prev) entry->prev->next = entry->next;
+					if(entry->next) entry->next->prev = entry->prev;
+					if(entry == start) start = entry->next;
+					if(entry == end) end = entry->prev;
+				}
+				// No reader can reach the entry now, and detach() may call back into
+				// the faker, so it is called without holding rwlock.
 				detach(entry);
 				memset(entry, 0, sizeof(HashEntry));
 				delete entry;
@@ -145,6 +179,7 @@ namespace faker
 				return 0;
 			}
 
+			virtual void ref(HashValueType value) {}
 			virtual void detach(HashEntry *entry) = 0;
 			virtual bool compare(HashKeyType1 key1, HashKeyType2 key2,
 				HashEntry *entry) = 0;
@@ -152,6 +187,22 @@ namespace faker
 			int count;
 			HashEntry *start, *end;
 			util::CriticalSection mutex;
+
+		private:
+
+			// The caller must hold either mutex or rwlock.
+			HashEntry *lookup(HashKeyType1 key1, HashKeyType2 key2)
+			{
+				for(HashEntry *entry = start; entry != NULL; entry = entry->next)
+				{
+					if((entry->key1 == key1 && entry->key2 == key2)
+						|| compare(key1, key2, entry))
+						return entry;
+				}
+				return NULL;
+			}
+
+			util::ReadWriteLock rwlock;
 	};
 }
 
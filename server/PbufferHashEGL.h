@@ -52,6 +52,14 @@ namespace backend
 				return HASH::find(id, NULL);
 			}
 
+			// Returns the FakePbuffer with a reference taken on behalf of the caller,
+			// which must call release() on it when finished with it
+			backend::FakePbuffer *findRef(GLXDrawable id)
+			{
+				if(!id) return NULL;
+				return HASH::findRef(id, NULL);
+			}
+
 			void remove(GLXDrawable id)
 			{
 				if(!id) THROW("Invalid argument");
@@ -65,9 +73,14 @@ namespace backend
 				HASH::kill();
 			}
 
+			void ref(backend::FakePbuffer *pb)
+			{
+				pb->addRef();
+			}
+
 			void detach(HashEntry *entry)
 			{
-				if(entry) delete entry->value;
+				if(entry && entry->value) entry->value->release();
 			}
 
 			bool compare(GLXDrawable key1, void *key2, HashEntry *entry)
@@ -25,6 +25,30 @@ using namespace common;
 using namespace server;
 
 
+// The JPEG encoder options that VGL_JPEGOPT=auto can choose from, in order of
+// increasing CPU usage.  Huffman table optimization without progressive mode
+// can only be requested through the TurboJPEG 3 API.  The relative costs are
+// rough estimates for 4:4:4 tiles, and they are used only to predict whether
+// the next option up could keep pace with the sender thread.
+
+static const int jpegLevels[] =
+{
+	RRJPEG_FASTDCT, RRJPEG_ACCURATEDCT,
+	#ifdef TJ_NUMINIT
+	RRJPEG_OPTIMIZE,
+	#endif
+	#ifdef TJFLAG_PROGRESSIVE
+	RRJPEG_PROGRESSIVE,
+	#endif
+};
+static const int numJPEGLevels = sizeof(jpegLevels) / sizeof(int);
+static const double jpegCost[RR_JPEGOPT] = { 0.85, 1.0, 1.25, 2.5 };
+static const char *jpegOptName[RR_JPEGOPT] =
+{
+	"fast DCT", "accurate DCT", "optimized Huffman", "progressive"
+};
+
+
 #define ENDIANIZE(h) \
 { \
 	if(!LittleEndian()) \
@@ -56,6 +80,31 @@ using namespace server;
 	} \
 }
 
+#define ENDIANIZE_DGRAM(h) \
+{ \
+	if(!LittleEndian()) \
+	{ \
+		h.frameid = BYTESWAP(h.frameid); \
+		h.tileid = BYTESWAP16(h.tileid); \
+		h.frag = BYTESWAP16(h.frag); \
+		h.nfrags = BYTESWAP16(h.nfrags); \
+		h.len = BYTESWAP16(h.len); \
+		h.token = BYTESWAP(h.token); \
+	} \
+}
+
+#define ENDIANIZE_REFRESH(r) \
+{ \
+	if(!LittleEndian()) \
+	{ \
+		r.frameid = BYTESWAP(r.frameid); \
+		r.winid = BYTESWAP(r.winid); \
+		r.framew = BYTESWAP16(r.framew); \
+		r.frameh = BYTESWAP16(r.frameh); \
+		r.len = BYTESWAP16(r.len); \
+	} \
+}
+
 #define CONVERT_HEADER(h, h1) \
 { \
 	h1.size = h.size; \
@@ -73,7 +122,12 @@ using namespace server;
 }
 
 
-void VGLTrans::sendHeader(rrframeheader h, bool eof)
+// Placeholder that the refresh listener adds to the queue in order to wake up
+// the transport thread when the client requests that lost tiles be resent
+static char refreshToken;
+
+
+void VGLTrans::handshake(rrframeheader &h)
 {
 	if(version.major == 0 && version.minor == 0)
 	{
@@ -101,12 +155,39 @@ void VGLTrans::sendHeader(rrframeheader h, bool eof)
 				v = version;
 				v.major = RR_MAJOR_VERSION;  v.minor = RR_MINOR_VERSION;
 				send((char *)&v, sizeof_rrversion);
+				if(version.major > 2 || (version.major == 2 && version.minor >= 3))
+				{
+					unsigned char id = RR_NATIVEPF;
+					recv((char *)&id, 1);
+					CriticalSection::SafeLock l(mutex);
+					PF *pf = pf_get(id);
+					if(id < PIXELFORMATS && pf->bpc == 8 && pf->size >= 3)
+						nativePF = id;
+				}
 			}
 			if(fconfig.verbose)
+			{
 				vglout.println("[VGL] Client version: %d.%d", version.major,
 					version.minor);
+				if(nativePF >= 0)
+					vglout.println("[VGL] Client pixel format: %s",
+						pf_get(nativePF)->name);
+			}
 		}
 	}
+}
+
+
+int VGLTrans::getNativePF(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	return fconfig.nativergb ? nativePF : -1;
+}
+
+
+void VGLTrans::sendHeader(rrframeheader h, bool eof)
+{
+	handshake(h);
 	if((version.major < 2 || (version.major == 2 && version.minor < 1))
 		&& h.compress != RRCOMP_JPEG)
 		THROW("This compression mode requires VirtualGL Client v2.1 or later");
@@ -136,10 +217,35 @@ void VGLTrans::sendHeader(rrframeheader h, bool eof)
 }
 
 
-VGLTrans::VGLTrans(void) : nprocs(fconfig.np), socket(NULL), thread(NULL),
-	deadYet(false), dpynum(0)
+VGLTrans::VGLTrans(void) : nprocs(fconfig.np), socket(NULL), frames(NULL),
+	nFrames(0), channels(NULL), nChannels(0), thread(NULL), deadYet(false),
+	dpynum(0), nativePF(-1), udpSocket(NULL), udpInit(false), refreshOnly(false),
+	forceAll(false), frameID(0), udpToken(0), maxTileID(-1), refreshThread(NULL),
+	autoProcs(false), maxProcs(1), tuneFrames(0), holdFrames(0), grewFrom(0),
+	compTime(0.), sendTime(0.), prevCompTime(0.), lastSendTime(-1.),
+	jpegOpt(RRJPEG_ACCURATEDCT), jpegLevel(1), raisedFrom(-1), jpegHoldFrames(0),
+	compBytes(0.), prevSendTime(0.), captureItem(NULL), refreshListener(NULL),
+	sender(NULL), senderThread(NULL), pipelineDepth(fconfig.pipeline)
 {
+	// Start with one compression thread and add more only if compression turns
+	// out to be the bottleneck.
+	if(nprocs < 1)
+	{
+		autoProcs = true;  nprocs = 1;  maxProcs = min(NumProcs(), MAXPROCS);
+	}
+	else nprocs = maxProcs = min(nprocs, MAXPROCS);
+	// The UDP mode state is shared between the compression and send stages, so
+	// the UDP mode does not support pipelining.
+	if(fconfig.udp || pipelineDepth < 1) pipelineDepth = 1;
+	for(int i = 0; i < pipelineDepth; i++) slots.post();
 	memset(&version, 0, sizeof(rrversion));
+	memset(tilesSent, 0, TILEMAPSIZE);
+	memset(forced, 0, TILEMAPSIZE);
+	if(fconfig.jpegopt >= 0)
+	{
+		for(int i = 0; i < numJPEGLevels; i++)
+			if(jpegLevels[i] == fconfig.jpegopt) jpegOpt = fconfig.jpegopt;
+	}
 	profTotal.setName("Total     ");
 	#ifdef USEHELGRIND
 	ANNOTATE_BENIGN_RACE_SIZED(&deadYet, sizeof(bool), );
@@ -152,8 +258,7 @@ VGLTrans::VGLTrans(void) : nprocs(fconfig.np), socket(NULL), thread(NULL),
 
 void VGLTrans::run(void)
 {
-	Frame *lastf = NULL, *f = NULL;
-	long bytes = 0;
+	Frame *f = NULL;
 	Timer timer, sleepTimer;  double err = 0.;  bool first = true;
 	int i;
 
@@ -161,47 +266,67 @@ void VGLTrans::run(void)
 	{
 		VGLTrans::Compressor *comp[MAXPROCS];  Thread *cthread[MAXPROCS];
 		if(fconfig.verbose)
-			vglout.println("[VGL] Using %d compression threads on %d CPU cores",
-				nprocs, NumProcs());
-		for(i = 0; i < nprocs; i++)
-			comp[i] = new VGLTrans::Compressor(i, this);
-		if(nprocs > 1) for(i = 1; i < nprocs; i++)
 		{
+			if(autoProcs && maxProcs > 1)
+				vglout.println("[VGL] Using 1-%d compression threads (automatic) on %d CPU cores",
+					maxProcs, NumProcs());
+			else
+				vglout.println("[VGL] Using %d compression threads on %d CPU cores",
+					nprocs, NumProcs());
+		}
+		if(fconfig.verbose && pipelineDepth > 1)
+			vglout.println("[VGL] Using a pipeline depth of %d frames",
+				pipelineDepth);
+		sender = new Sender(this);
+		senderThread = new Thread(sender);
+		senderThread->start();
+		for(i = 0; i < maxProcs; i++)
+		{
+			comp[i] = new VGLTrans::Compressor(i, this);
 			cthread[i] = new Thread(comp[i]);
 			cthread[i]->start();
 		}
 
 		while(!deadYet)
 		{
-			int np;
-			void *ftemp = NULL;
+			void *ftemp = NULL;  Channel *ch = NULL;
 
-			q.get(&ftemp);  f = (Frame *)ftemp;  if(deadYet) break;
-			if(!f) THROW("Queue has been shut down");
-			ready.signal();
-			np = nprocs;  if(f->hdr.compress == RRCOMP_YUV) np = 1;
-			if(np > 1)
+			q.get(&ftemp);  if(deadYet) break;
+			if(refreshThread) refreshThread->checkError();
+			closeChannels();
+			if(ftemp == (void *)&refreshToken)
 			{
-				for(i = 1; i < np; i++)
+				// Resend the tiles that the client lost, using the most recent frame
+				// from each window that requested a refresh.
+				while(1)
 				{
-					cthread[i]->checkError();  comp[i]->go(f, lastf);
+					{
+						CriticalSection::SafeLock l(mutex);
+						for(ch = channels; ch; ch = ch->next)
+							if(ch->refreshPending && !ch->closed) break;
+						if(!ch) break;
+						ch->refreshPending = false;
+					}
+					if(!ch->lastf || ch->lastf->hdr.compress == RRCOMP_YUV) continue;
+					refreshOnly = true;
+					compressFrame(ch->lastf, NULL, ch, comp, cthread);
+					refreshOnly = false;
 				}
+				continue;
 			}
-			comp[0]->compressSend(f, lastf);
-			bytes += comp[0]->bytes;
-			if(np > 1)
+			f = (Frame *)ftemp;
+			if(!f) THROW("Queue has been shut down");
 			{
-				for(i = 1; i < np; i++)
+				CriticalSection::SafeLock l(mutex);
+				if((ch = findChannel(f->hdr.winid)) != NULL)
 				{
-					comp[i]->stop();  cthread[i]->checkError();  comp[i]->send();
-					bytes += comp[i]->bytes;
+					if(ch->queued == f) ch->queued = NULL;
+					ch->ready.signal();
 				}
 			}
-			sendHeader(f->hdr, true);
+			ready.signal();
 
-			profTotal.endFrame(f->hdr.width * f->hdr.height, bytes, 1);
-			bytes = 0;
-			profTotal.startFrame();
+			compressFrame(f, ch ? ch->lastf : NULL, ch, comp, cthread);
 
 			if(fconfig.flushdelay > 0.)
 			{
@@ -227,18 +352,30 @@ void VGLTrans::run(void)
 				timer.start();
 			}
 
-			if(lastf) lastf->signalComplete();
-			lastf = f;
+			// The most recent frame from each window is retained for the purposes
+			// of interframe comparison and UDP refresh.  If the window has been
+			// removed, then there is no need to retain it.
+			if(ch)
+			{
+				if(ch->lastf) ch->lastf->signalComplete();
+				ch->lastf = f;
+			}
+			else f->signalComplete();
 		}
 
-		for(i = 0; i < nprocs; i++) comp[i]->shutdown();
-		if(nprocs > 1) for(i = 1; i < nprocs; i++)
+		// Wait for the sender thread to finish sending the frames that are in the
+		// pipeline.
+		for(i = 0; i < pipelineDepth; i++) slots.wait();
+		senderThread->checkError();
+
+		for(i = 0; i < maxProcs; i++) comp[i]->shutdown();
+		for(i = 0; i < maxProcs; i++)
 		{
 			cthread[i]->stop();
 			cthread[i]->checkError();
 			delete cthread[i];
 		}
-		for(i = 0; i < nprocs; i++) delete comp[i];
+		for(i = 0; i < maxProcs; i++) delete comp[i];
 
 	}
 	catch(std::exception &e)
@@ -250,8 +387,318 @@ void VGLTrans::run(void)
 }
 
 
+// Compress a frame using the compressor threads and pass the compressed tiles
+// to the sender thread.  Called only by the transport thread.
+
+void VGLTrans::compressFrame(Frame *f, Frame *lastf, Channel *ch,
+	Compressor **comp, Thread **cthread)
+{
+	long bytes = 0;
+	int i, np;
+	Timer timer;
+
+	// Wait until there is room in the pipeline.  If the pipeline depth is 1,
+	// then this also ensures that the sender thread is idle, so it is safe to
+	// modify the UDP mode state.
+	slots.wait();
+	senderThread->checkError();
+
+	// The handshake occurs before the first tile is queued, so the sender
+	// thread never has to perform it.
+	handshake(f->hdr);
+	if(f->hdr.compress == RRCOMP_RGB && f->pf->id == getNativePF())
+		f->hdr.subsamp = RR_NATIVEPF;
+	if(fconfig.udp && !udpInit && f->hdr.compress != RRCOMP_YUV)
+		initUDP(f->hdr);
+	if(udpSocket && f->hdr.compress != RRCOMP_YUV) beginUDPFrame(f, ch);
+	np = nprocs;  if(f->hdr.compress == RRCOMP_YUV) np = 1;
+	if((f->flags & FRAME_CAPTURE) && !refreshOnly)
+	{
+		f->flags &= ~FRAME_CAPTURE;
+		captureItem = FrameCapture::getInstance()->reserve();
+	}
+	timer.start();
+	int started = 0, stopped = 0;
+	try
+	{
+		for(i = 0; i < np; i++)
+		{
+			cthread[i]->checkError();  comp[i]->go(f, lastf, np);  started++;
+		}
+		for(i = 0; i < np; i++)
+		{
+			comp[i]->stop();  stopped++;  cthread[i]->checkError();
+			bytes += comp[i]->bytes;
+		}
+	}
+	catch(...)
+	{
+		// Wait for the compressor threads that are still using the capture item
+		// before releasing its slot, so that a compression error does not
+		// permanently consume one of the frame capture queue slots.
+		for(i = stopped; i < started; i++) comp[i]->stop();
+		if(captureItem)
+		{
+			FrameCapture::getInstance()->discard(captureItem);
+			captureItem = NULL;
+		}
+		throw;
+	}
+	double frameCompTime = timer.elapsed();
+	// All tiles have now been gamma-corrected and stamped with the logo, if
+	// necessary, so the frame can be used for interframe comparison and refresh.
+	f->flags &= ~(FRAME_GAMMA | FRAME_LOGO);
+	sendQ.add(new Tile(f->hdr, bytes, refreshOnly, np, jpegOpt));
+	if(captureItem)
+	{
+		// The frame is not modified again until it is recycled, so the copy can
+		// be made while the sender thread is sending it.
+		FrameCapture::getInstance()->submit(captureItem, *f, f->hdr.winid);
+		captureItem = NULL;
+	}
+
+	if(!refreshOnly && f->hdr.compress != RRCOMP_YUV
+		&& updateTiming(frameCompTime, bytes))
+	{
+		if(autoProcs && maxProcs > 1) tuneThreads();
+		if(fconfig.jpegopt < 0 && f->hdr.compress == RRCOMP_JPEG) tuneJPEG();
+	}
+}
+
+
+// Maintain running averages of the time spent compressing and sending each
+// frame.  Returns true if the averages have settled since the compression
+// parameters were last changed.  Called only by the transport thread.
+
+bool VGLTrans::updateTiming(double frameCompTime, long frameBytes)
+{
+	double frameSendTime;
+
+	{
+		CriticalSection::SafeLock l(mutex);
+		frameSendTime = lastSendTime;
+	}
+	if(frameSendTime < 0.) return false;
+
+	if(tuneFrames == 0)
+	{
+		compTime = frameCompTime;  sendTime = frameSendTime;
+		compBytes = (double)frameBytes;
+	}
+	else
+	{
+		compTime = compTime * 0.75 + frameCompTime * 0.25;
+		sendTime = sendTime * 0.75 + frameSendTime * 0.25;
+		compBytes = compBytes * 0.75 + (double)frameBytes * 0.25;
+	}
+	if(holdFrames > 0) holdFrames--;
+	if(jpegHoldFrames > 0) jpegHoldFrames--;
+	return ++tuneFrames >= TUNEFRAMES;
+}
+
+
+// Grow the set of active compression threads if compressing a frame takes
+// longer than sending it, and shrink it if one fewer thread could still keep
+// up with the sender.  The times are averaged over several frames, and the
+// thresholds for growing and shrinking are far enough apart that the thread
+// count does not oscillate.  If adding a thread does not significantly reduce
+// the compression time (because, for instance, other processes are competing
+// for the CPU), then the thread is removed, and growing is suspended for a
+// while.  Called only by the transport thread.
+
+void VGLTrans::tuneThreads(void)
+{
+	int newProcs = nprocs;
+
+	if(grewFrom > 0)
+	{
+		if(compTime > prevCompTime * 0.9)
+		{
+			newProcs = grewFrom;  holdFrames = HOLDFRAMES;
+		}
+		grewFrom = 0;
+	}
+	else if(compTime > sendTime * 1.1 && nprocs < maxProcs && holdFrames == 0)
+	{
+		grewFrom = nprocs;  prevCompTime = compTime;  newProcs = nprocs + 1;
+	}
+	else if(nprocs > 1
+		&& compTime * (double)nprocs / (double)(nprocs - 1) < sendTime * 0.75)
+		newProcs = nprocs - 1;
+
+	if(newProcs != nprocs)
+	{
+		if(fconfig.verbose)
+			vglout.println("[VGL] Changing from %d to %d compression threads (compress = %.2f ms, send = %.2f ms per frame)",
+				nprocs, newProcs, compTime * 1000., sendTime * 1000.);
+		nprocs = newProcs;  tuneFrames = 0;
+	}
+}
+
+
+// Use JPEG encoder options that produce smaller images (at the expense of
+// more CPU time) if sending a frame takes much longer than compressing it,
+// and use the fast DCT if compression is the bottleneck and cannot be given
+// more threads.  This is analogous to tuneThreads(), except that a change that
+// does not significantly reduce the send time (because, for instance, the
+// network is not the bottleneck after all) is reverted.  Called only by the
+// transport thread.
+
+void VGLTrans::tuneJPEG(void)
+{
+	int newLevel = jpegLevel;
+
+	// Let the averages settle first if the thread count just changed.
+	if(grewFrom > 0 || tuneFrames == 0) return;
+
+	if(raisedFrom >= 0)
+	{
+		if(sendTime > prevSendTime * 0.95)
+		{
+			newLevel = raisedFrom;  jpegHoldFrames = HOLDFRAMES;
+		}
+		raisedFrom = -1;
+	}
+	else if(compTime > sendTime * 1.1 && jpegLevel > 0
+		&& (!autoProcs || nprocs >= maxProcs || holdFrames > 0))
+		newLevel = jpegLevel - 1;
+	else if(jpegLevel < numJPEGLevels - 1 && jpegHoldFrames == 0
+		&& compTime * jpegCost[jpegLevels[jpegLevel + 1]] /
+			jpegCost[jpegLevels[jpegLevel]] < sendTime * 0.75)
+	{
+		raisedFrom = jpegLevel;  prevSendTime = sendTime;  newLevel = jpegLevel + 1;
+	}
+
+	if(newLevel != jpegLevel)
+	{
+		if(fconfig.verbose)
+			vglout.println("[VGL] Changing JPEG encoder options from %s to %s (compress = %.2f ms, send = %.2f ms per frame, %.1f Mbits/sec)",
+				jpegOptName[jpegLevels[jpegLevel]], jpegOptName[jpegLevels[newLevel]],
+				compTime * 1000., sendTime * 1000.,
+				sendTime > 0. ? compBytes * 8. / sendTime / 1000000. : 0.);
+		jpegLevel = newLevel;  jpegOpt = jpegLevels[jpegLevel];  tuneFrames = 0;
+	}
+}
+
+
+// Called only by the sender thread
+
+void VGLTrans::endFrame(Tile *eof)
+{
+	rrframeheader h = eof->hdr;
+
+	if(udpSocket && h.compress != RRCOMP_YUV)
+	{
+		// The end-of-frame marker carries a bitmap of the tiles that were sent
+		h.size = maxTileID / 8 + 1;
+		sendDgrams(h, RR_DGRAMEOF, tilesSent);
+	}
+	else sendHeader(h, true);
+	if(!eof->refresh)
+	{
+		profTotal.setThreads(eof->threads);
+		profTotal.setNote(h.compress == RRCOMP_JPEG ?
+			jpegOptName[eof->jpegOpt] : NULL);
+		profTotal.endFrame(h.width * h.height, eof->bytes, 1);
+		profTotal.startFrame();
+	}
+}
+
+
+void VGLTrans::Sender::run(void)
+{
+	bool failed = false;
+
+	while(1)
+	{
+		void *ttemp = NULL;
+		parent->sendQ.get(&ttemp);
+		Tile *tile = (Tile *)ttemp;
+		if(!tile) break;
+		try
+		{
+			if(!failed)
+			{
+				timer.start();
+				if(tile->cf) parent->sendTile(tile->cf, tile->tileID);
+				else parent->endFrame(tile);
+				sendTime += timer.elapsed();
+			}
+		}
+		catch(std::exception &e)
+		{
+			// Keep emptying the queue, so the transport thread does not block
+			// before it discovers the error.
+			parent->senderThread->setError(e);
+			failed = true;
+		}
+		if(tile->cf)
+		{
+			tile->owner->recycle(tile->cf);  tile->cf = NULL;
+		}
+		else
+		{
+			if(!tile->refresh)
+			{
+				CriticalSection::SafeLock l(parent->mutex);
+				parent->lastSendTime = sendTime;
+			}
+			sendTime = 0.;
+			parent->slots.post();
+		}
+		delete tile;
+	}
+}
+
+
+// Must be called with the mutex locked
+
+VGLTrans::Channel *VGLTrans::findChannel(unsigned int winid, bool create)
+{
+	Channel *ch;
+
+	for(ch = channels; ch; ch = ch->next)
+		if(ch->winid == winid && !ch->closed) return ch;
+	if(!create) return NULL;
+	ch = new Channel(winid);
+	ch->next = channels;  channels = ch;
+	nChannels++;
+	return ch;
+}
+
+
+// Release the resources associated with windows that have been removed.
+// Called only by the transport thread.
+
+void VGLTrans::closeChannels(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	Channel **prev = &channels, *ch = channels;
+
+	while(ch)
+	{
+		Channel *next = ch->next;
+		if(ch->closed)
+		{
+			if(ch->lastf) ch->lastf->signalComplete();
+			*prev = next;  delete ch;  nChannels--;
+		}
+		else prev = &ch->next;
+		ch = next;
+	}
+}
+
+
+void VGLTrans::removeWindow(unsigned int winid)
+{
+	CriticalSection::SafeLock l(mutex);
+	Channel *ch = findChannel(winid);
+	if(ch) ch->closed = true;
+}
+
+
 Frame *VGLTrans::getFrame(int width, int height, int pixelFormat, int flags,
-	bool stereo)
+	bool stereo, unsigned int winid)
 {
 	Frame *f = NULL;
 
@@ -260,11 +707,30 @@ Frame *VGLTrans::getFrame(int width, int height, int pixelFormat, int flags,
 	{
 		CriticalSection::SafeLock l(mutex);
 
+		// A window's channel is normally created when it sends its first frame,
+		// so create it now in order to count the window toward the pool limit.
+		int maxFrames = NFRAMES * (nChannels + 1);
+		if(winid)
+		{
+			findChannel(winid, true);
+			maxFrames = NFRAMES * nChannels;
+		}
+
 		int index = -1;
-		for(int i = 0; i < NFRAMES; i++)
-			if(frames[i].isComplete()) index = i;
-		if(index < 0) THROW("No free buffers in pool");
-		f = &frames[index];  f->waitUntilComplete();
+		for(int i = 0; i < nFrames; i++)
+			if(frames[i]->isComplete()) index = i;
+		if(index < 0)
+		{
+			if(nFrames >= maxFrames)
+				THROW("No free buffers in pool");
+			Frame **newFrames =
+				(Frame **)realloc(frames, sizeof(Frame *) * (nFrames + 1));
+			if(!newFrames) THROW("Memory allocation error");
+			frames = newFrames;
+			frames[nFrames] = new Frame();
+			index = nFrames++;
+		}
+		f = frames[index];  f->waitUntilComplete();
 	}
 
 	rrframeheader hdr;
@@ -272,27 +738,50 @@ Frame *VGLTrans::getFrame(int width, int height, int pixelFormat, int flags,
 	hdr.x = hdr.y = 0;
 	hdr.width = hdr.framew = width;
 	hdr.height = hdr.frameh = height;
+	hdr.winid = winid;
 	f->init(hdr, pixelFormat, flags, stereo);
 	return f;
 }
 
 
-bool VGLTrans::isReady(void)
+bool VGLTrans::isReady(unsigned int winid)
 {
 	if(thread) thread->checkError();
-	return q.items() <= 0;
+	if(!winid) return q.items() <= 0;
+	CriticalSection::SafeLock l(mutex);
+	Channel *ch = findChannel(winid);
+	return !ch || !ch->queued;
 }
 
 
-void VGLTrans::synchronize(void)
+void VGLTrans::synchronize(unsigned int winid)
 {
-	ready.wait();
+	Channel *ch = NULL;
+
+	if(winid)
+	{
+		CriticalSection::SafeLock l(mutex);
+		ch = findChannel(winid, true);
+	}
+	// A channel is only deleted by the transport thread after its window has
+	// been removed, so it is safe to wait on it without holding the mutex.
+	if(ch) ch->ready.wait();
+	else ready.wait();
 }
 
 
 static void _VGLTrans_spoilfct(void *f)
 {
-	if(f) ((Frame *)f)->signalComplete();
+	if(f && f != (void *)&refreshToken) ((Frame *)f)->signalComplete();
+}
+
+
+// Each window's frames only spoil previous frames from the same window.
+
+static bool _VGLTrans_matchfct(void *f, void *newf)
+{
+	if(f == (void *)&refreshToken) return false;
+	return ((Frame *)f)->hdr.winid == ((Frame *)newf)->hdr.winid;
 }
 
 
@@ -300,13 +789,14 @@ void VGLTrans::sendFrame(Frame *f)
 {
 	if(thread) thread->checkError();
 	f->hdr.dpynum = dpynum;
-	q.spoil((void *)f, _VGLTrans_spoilfct);
+	CriticalSection::SafeLock l(mutex);
+	findChannel(f->hdr.winid, true)->queued = f;
+	q.spoil((void *)f, _VGLTrans_spoilfct, _VGLTrans_matchfct);
 }
 
 
 void VGLTrans::Compressor::compressSend(Frame *f, Frame *lastf)
 {
-	CompressedFrame cframe;
 
 	if(!f) return;
 	int tilesizex = fconfig.tilesize ? fconfig.tilesize : f->hdr.width;
@@ -315,11 +805,16 @@ void VGLTrans::Compressor::compressSend(Frame *f, Frame *lastf)
 
 	if(f->hdr.compress == RRCOMP_YUV)
 	{
+		void *ctemp = NULL;
+		spares.get(&ctemp, true);
+		CompressedFrame *cf = ctemp ?
+			(CompressedFrame *)ctemp : new CompressedFrame();
 		profComp.startFrame();
-		cframe = *f;
+		f->postProcess(NULL, 0, 0, f->hdr.width, f->hdr.height);
+		*cf = *f;
 		profComp.endFrame(f->hdr.framew * f->hdr.frameh, 0, 1);
-		parent->sendHeader(cframe.hdr);
-		parent->send((char *)cframe.bits, cframe.hdr.size);
+		bytes = cf->hdr.size;
+		parent->sendQ.add(new Tile(cf, 0, this));
 		return;
 	}
 
@@ -341,36 +836,28 @@ void VGLTrans::Compressor::compressSend(Frame *f, Frame *lastf)
 				width = f->hdr.width - j;  j += tilesizex;
 			}
 			if(n % nprocs != myRank) continue;
-			if(fconfig.interframe)
-			{
-				if(f->tileEquals(lastf, x, y, width, height)) continue;
-			}
+			if(parent->isRefreshOnly() && !parent->isForced(n)) continue;
+			// Apply any deferred gamma correction or logo and compare the tile
+			// with the previous frame in the same pass.
+			if(f->postProcess(fconfig.interframe && !parent->isForced(n) ?
+				lastf : NULL, x, y, width, height))
+				continue;
 			Frame *tile = f->getTile(x, y, width, height);
-			CompressedFrame *ctile = NULL;
-			if(myRank > 0) { ctile = new CompressedFrame(); }
-			else ctile = &cframe;
+			void *ctemp = NULL;
+			spares.get(&ctemp, true);
+			CompressedFrame *ctile = ctemp ?
+				(CompressedFrame *)ctemp : new CompressedFrame();
 			profComp.startFrame();
+			ctile->jpegOpt = parent->jpegOpt;
 			*ctile = *tile;
+			if(parent->captureItem) parent->captureItem->addTile(*ctile);
 			double frames = (double)(tile->hdr.width * tile->hdr.height) /
 				(double)(tile->hdr.framew * tile->hdr.frameh);
 			profComp.endFrame(tile->hdr.width * tile->hdr.height, 0, frames);
 			bytes += ctile->hdr.size;
 			if(ctile->stereo) bytes += ctile->rhdr.size;
 			delete tile;
-			if(myRank == 0)
-			{
-				parent->sendHeader(ctile->hdr);
-				parent->send((char *)ctile->bits, ctile->hdr.size);
-				if(ctile->stereo && ctile->rbits)
-				{
-					parent->sendHeader(ctile->rhdr);
-					parent->send((char *)ctile->rbits, ctile->rhdr.size);
-				}
-			}
-			else
-			{
-				store(ctile);
-			}
+			parent->sendQ.add(new Tile(ctile, n, this));
 		}
 	}
 }
@@ -471,20 +958,175 @@ void VGLTrans::connect(char *displayName, unsigned short port)
 }
 
 
-void VGLTrans::Compressor::send(void)
+void VGLTrans::sendTile(CompressedFrame *cf, int tileID)
 {
-	for(int i = 0; i < storedFrames; i++)
+	if(udpSocket && cf->hdr.compress != RRCOMP_YUV)
 	{
-		CompressedFrame *cf = cframes[i];
-		ERRIFNOT(cf);
-		parent->sendHeader(cf->hdr);
-		parent->send((char *)cf->bits, cf->hdr.size);
-		if(cf->stereo && cf->rbits)
-		{
-			parent->sendHeader(cf->rhdr);
-			parent->send((char *)cf->rbits, cf->rhdr.size);
-		}
-		delete cf;
+		if(tileID >= RR_DGRAMEOF)
+			THROW("Too many tiles for UDP mode (increase VGL_TILESIZE)");
+		sendDgrams(cf->hdr, tileID, cf->bits);
+		if(cf->stereo && cf->rbits) sendDgrams(cf->rhdr, tileID, cf->rbits);
+		tilesSent[tileID / 8] |= (1 << (tileID % 8));
+		if(tileID > maxTileID) maxTileID = tileID;
+		return;
+	}
+	sendHeader(cf->hdr);
+	send((char *)cf->bits, cf->hdr.size);
+	if(cf->stereo && cf->rbits)
+	{
+		sendHeader(cf->rhdr);
+		send((char *)cf->rbits, cf->rhdr.size);
+	}
+}
+
+
+// Switch to the UDP mode of the VGL Transport, if the client supports it.  The
+// TCP connection remains open and is used to receive refresh requests from the
+// client.
+
+void VGLTrans::initUDP(rrframeheader h)
+{
+	unsigned short port = 0;
+
+	udpInit = true;
+	if(fconfig.ssl)
+	{
+		vglout.println("[VGL] WARNING: UDP mode cannot be used with SSL encryption.  Using TCP.");
+		return;
+	}
+	handshake(h);
+	if(version.major < 2 || (version.major == 2 && version.minor < 2))
+	{
+		vglout.println("[VGL] WARNING: UDP mode requires VirtualGL Client v3.1 or later.  Using TCP.");
+		return;
+	}
+	h.flags = RR_UDP;  h.size = 0;
+	ENDIANIZE(h);
+	send((char *)&h, sizeof_rrframeheader);
+	recv((char *)&port, 2);
+	if(!LittleEndian()) port = BYTESWAP16(port);
+	if(port == 0)
+	{
+		vglout.println("[VGL] WARNING: Client could not set up UDP mode.  Using TCP.");
+		return;
+	}
+
+	udpSocket = new UDPSocket(true);
+	udpSocket->connect(socket->remoteName(), port);
+	// Tell the client which port the datagrams will come from and which token
+	// they will contain, so it can discard datagrams from anyone else.
+	unsigned short localPort = udpSocket->getPort();
+	udpToken = UDPSocket::newToken();
+	char reply[6];
+	reply[0] = localPort & 0xFF;  reply[1] = (localPort >> 8) & 0xFF;
+	for(int i = 0; i < 4; i++) reply[2 + i] = (udpToken >> (8 * i)) & 0xFF;
+	send(reply, 6);
+	refreshListener = new RefreshListener(this);
+	refreshThread = new Thread(refreshListener);
+	refreshThread->start();
+	if(fconfig.verbose)
+		vglout.println("[VGL] Using UDP mode (client port %d)", port);
+}
+
+
+void VGLTrans::beginUDPFrame(Frame *f, Channel *ch)
+{
+	frameID++;
+	memset(tilesSent, 0, TILEMAPSIZE);  maxTileID = -1;
+	forceAll = false;  memset(forced, 0, TILEMAPSIZE);
+	if(!ch) return;
+
+	CriticalSection::SafeLock l(mutex);
+	// Tile IDs are only meaningful if the frame geometry has not changed.  If
+	// it has, then the whole frame will be sent anyway.
+	if(ch->refreshW == f->hdr.framew && ch->refreshH == f->hdr.frameh)
+	{
+		forceAll = ch->refreshAll;
+		memcpy(forced, ch->refresh, TILEMAPSIZE);
+	}
+	ch->refreshAll = false;  memset(ch->refresh, 0, TILEMAPSIZE);
+}
+
+
+bool VGLTrans::isForced(int tileID)
+{
+	if(forceAll) return true;
+	if(tileID < 0 || tileID >= RR_DGRAMEOF) return false;
+	return (forced[tileID / 8] & (1 << (tileID % 8))) != 0;
+}
+
+
+void VGLTrans::sendDgrams(rrframeheader h, int tileID, unsigned char *bits)
+{
+	char buf[sizeof_rrdgramheader + sizeof_rrframeheader + RR_DGRAMPAYLOAD];
+	rrdgramheader dh;
+	int nfrags = (h.size + RR_DGRAMPAYLOAD - 1) / RR_DGRAMPAYLOAD;
+
+	if(nfrags < 1) nfrags = 1;
+	if(nfrags > 65535) THROW("Tile is too large for UDP mode");
+	unsigned int size = h.size;
+	if(tileID == RR_DGRAMEOF) h.flags = RR_EOF;
+	ENDIANIZE(h);
+	memcpy(&buf[sizeof_rrdgramheader], &h, sizeof_rrframeheader);
+
+	for(int i = 0; i < nfrags; i++)
+	{
+		unsigned int offset = i * RR_DGRAMPAYLOAD;
+		unsigned int len = min(size - offset, (unsigned int)RR_DGRAMPAYLOAD);
+		if(size == 0) len = 0;
+		dh.frameid = frameID;  dh.tileid = tileID;
+		dh.frag = i;  dh.nfrags = nfrags;  dh.len = len;  dh.token = udpToken;
+		ENDIANIZE_DGRAM(dh);
+		memcpy(buf, &dh, sizeof_rrdgramheader);
+		if(len) memcpy(&buf[sizeof_rrdgramheader + sizeof_rrframeheader],
+			&bits[offset], len);
+		udpSocket->send(buf, sizeof_rrdgramheader + sizeof_rrframeheader + len);
+	}
+}
+
+
+void VGLTrans::recvRefresh(void)
+{
+	rrrefresh r;
+	unsigned char bitmap[TILEMAPSIZE];
+
+	// A receive error means that the client has disconnected.  That will be
+	// reported by the transport thread.
+	socket->recv((char *)&r, sizeof_rrrefresh);
+	ENDIANIZE_REFRESH(r);
+	if(r.len > TILEMAPSIZE) THROW("Invalid refresh request");
+	if(r.len) socket->recv((char *)bitmap, r.len);
+
+	CriticalSection::SafeLock l(mutex);
+	Channel *ch = findChannel(r.winid);
+	if(!ch) return;
+	if(r.framew != ch->refreshW || r.frameh != ch->refreshH)
+	{
+		ch->refreshAll = false;  memset(ch->refresh, 0, TILEMAPSIZE);
+		ch->refreshW = r.framew;  ch->refreshH = r.frameh;
+	}
+	if(r.len == 0) ch->refreshAll = true;
+	else for(int i = 0; i < r.len; i++) ch->refresh[i] |= bitmap[i];
+
+	// If a new frame from the same window is already waiting, then it will
+	// pick up the refresh request.  Otherwise, wake up the transport thread.
+	if(!ch->queued && !ch->refreshPending)
+	{
+		ch->refreshPending = true;
+		q.add((void *)&refreshToken);
+	}
+}
+
+
+void VGLTrans::RefreshListener::run(void)
+{
+	try
+	{
+		while(!parent->deadYet) parent->recvRefresh();
+	}
+	catch(std::exception &e)
+	{
+		if(!parent->deadYet && parent->refreshThread)
+			parent->refreshThread->setError(e);
 	}
-	storedFrames = 0;
 }
@@ -16,11 +16,13 @@
 #define __VGLTRANS_H__
 
 #include "Socket.h"
+#include "UDPSocket.h"
 #include "Thread.h"
 #include "rr.h"
 #include "Frame.h"
 #include "GenericQ.h"
 #include "Profiler.h"
+#include "FrameCapture.h"
 #ifdef USEHELGRIND
 	#include <valgrind/helgrind.h>
 #endif
@@ -28,6 +30,10 @@
 
 namespace server
 {
+	// Frames from multiple windows can be sent through the same VGLTrans
+	// instance.  The frames are multiplexed using the window ID in the frame
+	// header, and each window's frames are spoiled independently.
+
 	class VGLTrans : public util::Runnable
 	{
 		public:
@@ -38,15 +44,55 @@ namespace server
 			{
 				deadYet = true;  q.release();
 				if(thread) { thread->stop();  delete thread;  thread = NULL; }
+				if(refreshThread)
+				{
+					// Closing the socket unblocks the refresh listener.
+					if(socket) socket->close();
+					refreshThread->stop();  delete refreshThread;  refreshThread = NULL;
+				}
+				delete refreshListener;  refreshListener = NULL;
+				if(senderThread)
+				{
+					sendQ.release();
+					senderThread->stop();  delete senderThread;  senderThread = NULL;
+				}
+				delete sender;  sender = NULL;
+				if(captureItem)
+				{
+					server::FrameCapture::getInstance()->discard(captureItem);
+					captureItem = NULL;
+				}
+				delete udpSocket;  udpSocket = NULL;
 				delete socket;  socket = NULL;
+				while(channels)
+				{
+					Channel *next = channels->next;
+					delete channels;  channels = next;
+				}
+				for(int i = 0; i < nFrames; i++) delete frames[i];
+				free(frames);  frames = NULL;
 			}
 
-			common::Frame *getFrame(int, int, int, int, bool stereo);
-			bool isReady(void);
-			void synchronize(void);
+			// The pool limit is NFRAMES frames per window, so winid should be the
+			// ID of the window for which the frame is intended.  If it is 0 (for
+			// instance, because a transport plugin does not know the window ID),
+			// then room is left for one window that has not yet sent a frame.
+			common::Frame *getFrame(int, int, int, int, bool stereo,
+				unsigned int winid = 0);
+			// If winid is 0, then these apply to all windows.
+			bool isReady(unsigned int winid = 0);
+			void synchronize(unsigned int winid = 0);
 			void sendFrame(common::Frame *);
+			void removeWindow(unsigned int winid);
 			void run(void);
 			void sendHeader(rrframeheader h, bool eof = false);
+			void sendTile(common::CompressedFrame *cf, int tileID);
+			bool isForced(int tileID);
+			bool isRefreshOnly(void) { return refreshOnly; }
+			// Return the ID of the client's native pixel format, or -1 if the
+			// client does not accept tiles in its native pixel format (or if the
+			// handshake has not yet occurred.)
+			int getNativePF(void);
 			void send(char *, int);
 			void save(char *, int);
 			void recv(char *, int);
@@ -56,26 +102,178 @@ namespace server
 
 		private:
 
+			static const int TILEMAPSIZE = (RR_DGRAMEOF + 7) / 8;
+
+			// Per-window state
+			class Channel
+			{
+				public:
+
+					Channel(unsigned int winid_) : winid(winid_), queued(NULL),
+						lastf(NULL), closed(false), refreshAll(false),
+						refreshPending(false), refreshW(0), refreshH(0), next(NULL)
+					{
+						memset(refresh, 0, TILEMAPSIZE);
+					}
+
+					unsigned int winid;
+					// The frame that is waiting in the queue, if any
+					common::Frame *queued;
+					// The most recent frame that was sent (accessed only by the
+					// transport thread)
+					common::Frame *lastf;
+					util::Event ready;
+					bool closed;
+					// Tiles that the client requested be resent (UDP mode)
+					bool refreshAll, refreshPending;
+					unsigned short refreshW, refreshH;
+					unsigned char refresh[TILEMAPSIZE];
+					Channel *next;
+			};
+
+			class Compressor;
+
+			// A compressed tile, or (if cf is NULL) a marker indicating that all
+			// tiles of the frame described by hdr have been queued
+			class Tile
+			{
+				public:
+
+					Tile(common::CompressedFrame *cf_, int tileID_,
+						Compressor *owner_) : cf(cf_), tileID(tileID_), owner(owner_),
+						bytes(0), refresh(false)
+					{
+						memset(&hdr, 0, sizeof(rrframeheader));
+					}
+
+					Tile(rrframeheader &hdr_, long bytes_, bool refresh_, int threads_,
+						int jpegOpt_) : cf(NULL), tileID(-1), owner(NULL), hdr(hdr_),
+						bytes(bytes_), refresh(refresh_), threads(threads_),
+						jpegOpt(jpegOpt_) {}
+
+					~Tile(void) { delete cf; }
+
+					common::CompressedFrame *cf;
+					int tileID;
+					Compressor *owner;
+					rrframeheader hdr;
+					long bytes;
+					bool refresh;
+					// Number of compression threads and JPEG encoder options used for
+					// the frame
+					int threads, jpegOpt;
+			};
+
+			Channel *findChannel(unsigned int winid, bool create = false);
+			void closeChannels(void);
+			void compressFrame(common::Frame *f, common::Frame *lastf,
+				Channel *ch, Compressor **comp, util::Thread **cthread);
+			bool updateTiming(double frameCompTime, long frameBytes);
+			void tuneThreads(void);
+			void tuneJPEG(void);
+			void endFrame(Tile *eof);
+			void handshake(rrframeheader &h);
+			void initUDP(rrframeheader h);
+			void beginUDPFrame(common::Frame *f, Channel *ch);
+			void sendDgrams(rrframeheader h, int tileID, unsigned char *bits);
+			void recvRefresh(void);
+
 			util::Socket *socket;
+			// The frame pool grows by NFRAMES for each window.
 			static const int NFRAMES = 4;
 			util::CriticalSection mutex;
-			common::Frame frames[NFRAMES];
+			common::Frame **frames;  int nFrames;
+			Channel *channels;  int nChannels;
 			util::Event ready;
 			util::GenericQ q;
 			util::Thread *thread;  bool deadYet;
 			common::Profiler profTotal;
 			int dpynum;
 			rrversion version;
+			// Pixel format of the client's X display (protocol v2.3 and later,
+			// protected by mutex)
+			int nativePF;
+
+			// UDP mode
+			util::UDPSocket *udpSocket;
+			bool udpInit, refreshOnly, forceAll;
+			unsigned int frameID, udpToken;
+			int maxTileID;
+			unsigned char tilesSent[TILEMAPSIZE], forced[TILEMAPSIZE];
+			util::Thread *refreshThread;
+
+			// Automatic selection of the number of compression threads
+			// (VGL_NPROCS=0).  The number of active threads (nprocs) is adjusted
+			// between frames so that compressing a frame takes about as long as
+			// sending it.
+			static const int TUNEFRAMES = 8, HOLDFRAMES = 256;
+			bool autoProcs;
+			int maxProcs, tuneFrames, holdFrames, grewFrom;
+			double compTime, sendTime, prevCompTime;
+			// Time that the sender thread spent sending the most recent frame
+			// (protected by mutex)
+			double lastSendTime;
+
+			// Automatic selection of the JPEG encoder options (VGL_JPEGOPT=auto).
+			// The encoder spends more CPU time making the JPEG images smaller if
+			// sending a frame takes much longer than compressing it, and it uses the
+			// fast DCT if compression is the bottleneck and cannot be given more
+			// threads.  jpegLevel is an index into the list of encoder options that
+			// the TurboJPEG library supports.
+			int jpegOpt, jpegLevel, raisedFrom, jpegHoldFrames;
+			double compBytes, prevSendTime;
+
+			// The compressed tiles of a frame that is being captured (VGL_CAPTURE)
+			// are added to this item.  It is set by the transport thread only while
+			// the compression threads are idle.
+			server::FrameCapture::Item *captureItem;
+
+		// Receives requests from the client to resend tiles that were lost
+		class RefreshListener : public util::Runnable
+		{
+			public:
+
+				RefreshListener(VGLTrans *parent_) : parent(parent_) {}
+				void run(void);
+
+			private:
+
+				VGLTrans *parent;
+		};
+		RefreshListener *refreshListener;
+
+		// The transport thread compresses frames and passes the compressed tiles
+		// to the sender thread, so that one frame can be compressed while the
+		// previous frame is being sent.  pipelineDepth limits the number of frames
+		// that have been compressed but not yet completely sent.
+		class Sender : public util::Runnable
+		{
+			public:
+
+				Sender(VGLTrans *parent_) : parent(parent_), sendTime(0.) {}
+				void run(void);
+
+			private:
+
+				VGLTrans *parent;
+				util::Timer timer;
+				double sendTime;
+		};
+		Sender *sender;
+		util::Thread *senderThread;
+		// Compressed tiles and end-of-frame markers waiting to be sent
+		util::GenericQ sendQ;
+		util::Semaphore slots;
+		int pipelineDepth;
 
 		class Compressor : public util::Runnable
 		{
 			public:
 
-				Compressor(int myRank_, VGLTrans *parent_) : bytes(0),
-					storedFrames(0), cframes(NULL), frame(NULL), lastFrame(NULL),
-					myRank(myRank_), deadYet(false), parent(parent_)
+				Compressor(int myRank_, VGLTrans *parent_) : bytes(0), frame(NULL),
+					lastFrame(NULL), myRank(myRank_), nprocs(1), deadYet(false),
+					parent(parent_)
 				{
-					if(parent) nprocs = parent->nprocs;
 					ready.wait();  complete.wait();
 					char temps[20];
 					snprintf(temps, 20, "Compress %d", myRank);
@@ -88,7 +286,11 @@ namespace server
 				virtual ~Compressor(void)
 				{
 					shutdown();
-					free(cframes);  cframes = NULL;
+					void *ctemp = NULL;
+					while(spares.get(&ctemp, true), ctemp != NULL)
+					{
+						delete (common::CompressedFrame *)ctemp;  ctemp = NULL;
+					}
 				}
 
 				void run(void)
@@ -108,9 +310,10 @@ namespace server
 					}
 				}
 
-				void go(common::Frame *frame_, common::Frame *lastFrame_)
+				void go(common::Frame *frame_, common::Frame *lastFrame_,
+					int nprocs_)
 				{
-					frame = frame_;  lastFrame = lastFrame_;
+					frame = frame_;  lastFrame = lastFrame_;  nprocs = nprocs_;
 					ready.signal();
 				}
 
@@ -121,23 +324,17 @@ namespace server
 
 				void shutdown(void) { deadYet = true;  ready.signal(); }
 				void compressSend(common::Frame *frame, common::Frame *lastFrame);
-				void send(void);
+
+				// Return a tile buffer to this compressor once it has been sent, so
+				// that its memory can be reused.
+				void recycle(common::CompressedFrame *cf) { spares.add(cf); }
 
 				long bytes;
 
 			private:
 
-				void store(common::CompressedFrame *cf)
-				{
-					storedFrames++;
-					if(!(cframes = (common::CompressedFrame **)realloc(cframes,
-						sizeof(common::CompressedFrame *) * storedFrames)))
-						THROW("Memory allocation error");
-					cframes[storedFrames - 1] = cf;
-				}
-
-				int storedFrames;  common::CompressedFrame **cframes;
 				common::Frame *frame, *lastFrame;
+				util::GenericQ spares;
 				int myRank, nprocs;
 				util::Event ready, complete;  bool deadYet;
 				util::CriticalSection mutex;
@@ -0,0 +1,126 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __VGLTRANSHASH_H__
+#define __VGLTRANSHASH_H__
+
+#include "VGLTrans.h"
+#include "Hash.h"
+#ifdef USEHELGRIND
+	#include <valgrind/helgrind.h>
+#endif
+
+
+#define HASH  Hash<char *, unsigned short, server::VGLTrans *>
+
+// This maps a VirtualGL Client address and port to a reference-counted
+// VGLTrans instance, so that all windows in a process that send frames to the
+// same client share one connection, transport thread, and set of compressor
+// threads.
+
+namespace faker
+{
+	class VGLTransHash : public HASH
+	{
+		public:
+
+			static VGLTransHash *getInstance(void)
+			{
+				#ifdef USEHELGRIND
+				ANNOTATE_BENIGN_RACE_SIZED(&instance, sizeof(VGLTransHash *), );
+				#endif
+				if(instance == NULL)
+				{
+					util::CriticalSection::SafeLock l(instanceMutex);
+					if(instance == NULL) instance = new VGLTransHash;
+				}
+				return instance;
+			}
+
+			static bool isAlloc(void) { return instance != NULL; }
+
+			// Returns the existing connection to the specified client, or creates
+			// a new one.  Each call must be paired with a call to detach().
+			server::VGLTrans *attach(char *receiverName, unsigned short port)
+			{
+				if(!receiverName) THROW("Invalid argument");
+				util::CriticalSection::SafeLock l(mutex);
+				server::VGLTrans *vglconn = HASH::find(receiverName, port);
+				if(vglconn)
+				{
+					HASH::add(receiverName, port, NULL, true);
+					return vglconn;
+				}
+				vglconn = new server::VGLTrans();
+				try
+				{
+					vglconn->connect(receiverName, port);
+				}
+				catch(...)
+				{
+					delete vglconn;  throw;
+				}
+				char *receiverNameCopy = strdup(receiverName);
+				if(!HASH::add(receiverNameCopy, port, vglconn, true))
+					free(receiverNameCopy);
+				return vglconn;
+			}
+
+			// Releases a reference to the specified connection and closes it when
+			// the last reference is released
+			void detach(server::VGLTrans *vglconn)
+			{
+				if(!vglconn) return;
+				util::CriticalSection::SafeLock l(mutex);
+				for(HashEntry *entry = start; entry; entry = entry->next)
+				{
+					if(entry->value == vglconn)
+					{
+						if(entry->refCount > 0) entry->refCount--;
+						if(entry->refCount <= 0) killEntry(entry);
+						return;
+					}
+				}
+			}
+
+		private:
+
+			~VGLTransHash(void)
+			{
+				HASH::kill();
+			}
+
+			void detach(HashEntry *entry)
+			{
+				if(entry)
+				{
+					free(entry->key1);
+					delete entry->value;
+				}
+			}
+
+			bool compare(char *key1, unsigned short key2, HashEntry *entry)
+			{
+				return key1 && !strcasecmp(key1, entry->key1) && key2 == entry->key2;
+			}
+
+			static VGLTransHash *instance;
+			static util::CriticalSection instanceMutex;
+	};
+}
+
+#undef HASH
+
+
+#define vgltranshash  (*(faker::VGLTransHash::getInstance()))
+
+#endif  // __VGLTRANSHASH_H__
@@ -20,8 +20,8 @@ using namespace common;
 using namespace faker;
 
 
-VirtualPixmap::VirtualPixmap(Display *dpy_, Visual *visual, Pixmap pm) :
-	VirtualDrawable(dpy_, pm)
+VirtualPixmap::VirtualPixmap(Display *dpy_, Visual *visual_, Pixmap pm) :
+	VirtualDrawable(dpy_, pm), visual(visual_), depth(0)
 {
 	CriticalSection::SafeLock l(mutex);
 	profPMBlit.setName("PMap Blit ");
@@ -36,12 +36,13 @@ VirtualPixmap::~VirtualPixmap()
 }
 
 
-int VirtualPixmap::init(int width, int height, int depth, VGLFBConfig config_,
+int VirtualPixmap::init(int width, int height, int depth_, VGLFBConfig config_,
 	const int *attribs)
 {
 	if(!config_ || width < 1 || height < 1) THROW("Invalid argument");
 
 	CriticalSection::SafeLock l(mutex);
+	depth = depth_;
 	if(oglDraw && oglDraw->getWidth() == width && oglDraw->getHeight() == height
 		&& oglDraw->getDepth() == depth
 		&& FBCID(oglDraw->getFBConfig()) == FBCID(config_))
@@ -94,3 +95,121 @@ void VirtualPixmap::readback(void)
 
 	frame->redraw();
 }
+
+
+// XGetImage() and XShmGetImage() are serviced directly from the 3D pixmap,
+// without first transferring the entire pixmap to the 2D X server and then
+// reading the requested region back from it.  These functions return
+// NULL/false if the request cannot be serviced in this manner (for instance,
+// if the image format doesn't correspond to one of our pixel formats), in
+// which case the caller should fall back to readback() and the "real"
+// function.
+
+XImage *VirtualPixmap::getImage(int x, int y, unsigned int width,
+	unsigned int height, unsigned long planeMask, int format)
+{
+	XImage *image = NULL;
+
+	if(format != ZPixmap || !checkRenderMode()) return NULL;
+
+	fconfig_reloadenv();
+
+	CriticalSection::SafeLock l(mutex);
+	if(!oglDraw || !visual || depth < 1 || x < 0 || y < 0 || width < 1
+		|| height < 1 || x + (int)width > oglDraw->getWidth()
+		|| y + (int)height > oglDraw->getHeight())
+		return NULL;
+
+	if(!(image = XCreateImage(dpy, visual, depth, ZPixmap, 0, NULL, width,
+		height, 32, 0)))
+		return NULL;
+	PF *pf = getImagePF(image, planeMask);
+	if(!pf || !(image->data =
+		(char *)malloc(image->bytes_per_line * image->height)))
+	{
+		XDestroyImage(image);
+		return NULL;
+	}
+
+	try
+	{
+		readImage(x, y, width, height, image->bytes_per_line, pf, image->data);
+	}
+	catch(...)
+	{
+		XDestroyImage(image);
+		throw;
+	}
+	return image;
+}
+
+
+bool VirtualPixmap::getShmImage(XImage *image, int x, int y,
+	unsigned long planeMask)
+{
+	if(!image || !image->data || !checkRenderMode()) return false;
+
+	fconfig_reloadenv();
+
+	CriticalSection::SafeLock l(mutex);
+	if(!oglDraw || x < 0 || y < 0 || image->width < 1 || image->height < 1
+		|| x + image->width > oglDraw->getWidth()
+		|| y + image->height > oglDraw->getHeight())
+		return false;
+	PF *pf = getImagePF(image, planeMask);
+	if(!pf) return false;
+
+	readImage(x, y, image->width, image->height, image->bytes_per_line, pf,
+		image->data);
+	return true;
+}
+
+
+PF *VirtualPixmap::getImagePF(XImage *image, unsigned long planeMask)
+{
+	if(!image || image->format != ZPixmap || image->depth != depth
+		|| image->byte_order != (LittleEndian() ? LSBFirst : MSBFirst))
+		return NULL;
+
+	// Partial plane masks would require us to mask off the unselected bits of
+	// each pixel, so let the X server handle those.
+	unsigned long allPlanes =
+		depth >= 32 ? 0xFFFFFFFFUL : (1UL << depth) - 1;
+	if((planeMask & allPlanes) != allPlanes) return NULL;
+
+	// The pitch of the image must be the same as the pitch that glReadPixels()
+	// will produce.
+	int ps = image->bits_per_pixel / 8;
+	if(image->bytes_per_line != ((image->width * ps + 3) & (~3))) return NULL;
+
+	for(int i = 0; i < PIXELFORMATS; i++)
+	{
+		PF *pf = pf_get(i);
+		if(pf->size == ps && pf->rmask == image->red_mask
+			&& pf->gmask == image->green_mask && pf->bmask == image->blue_mask)
+			return pf;
+	}
+	return NULL;
+}
+
+
+void VirtualPixmap::readImage(int x, int y, int width, int height, int pitch,
+	PF *pf, char *data)
+{
+	unsigned char *bits = (unsigned char *)data;
+
+	readPixels(x, oglDraw->getHeight() - y - height, width, pitch, height,
+		GL_NONE, pf, bits, GL_FRONT, false);
+
+	// OpenGL images are bottom-up, whereas X images are top-down.
+	unsigned char *tmp = new unsigned char[pitch];
+	for(int i = 0; i < height / 2; i++)
+	{
+		unsigned char *row1 = &bits[pitch * i],
+			*row2 = &bits[pitch * (height - i - 1)];
+		memcpy(tmp, row1, pitch);
+		memcpy(row1, row2, pitch);
+		memcpy(row2, tmp, pitch);
+	}
+	delete [] tmp;
+}
@@ -27,12 +27,21 @@ namespace faker
 			int init(int width, int height, int depth, VGLFBConfig config,
 				const int *attribs);
 			void readback(void);
+			XImage *getImage(int x, int y, unsigned int width, unsigned int height,
+				unsigned long planeMask, int format);
+			bool getShmImage(XImage *image, int x, int y, unsigned long planeMask);
 			Pixmap get3DX11Pixmap(void);
 
 		private:
 
+			PF *getImagePF(XImage *image, unsigned long planeMask);
+			void readImage(int x, int y, int width, int height, int pitch, PF *pf,
+				char *data);
+
 			common::Profiler profPMBlit;
 			common::FBXFrame *frame;
+			Visual *visual;
+			int depth;
 	};
 }
 
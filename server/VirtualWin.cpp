@@ -18,6 +18,7 @@
 #include <string.h>
 #include "fakerconfig.h"
 #include "glxvisual.h"
+#include "VGLTransHash.h"
 #include "vglutil.h"
 
 using namespace util;
@@ -68,6 +69,8 @@ VirtualWin::VirtualWin(Display *dpy_, Window win) :
 	newConfig = false;
 	swapInterval = 0;
 	alreadyWarnedPluginRenderMode = false;
+	dirtyCtx = 0;
+	scissorUntracked = false;
 	XWindowAttributes xwa;
 	if(!XGetWindowAttributes(dpy, win, &xwa) || !xwa.visual)
 		throw(Error(__FUNCTION__, "Invalid window", -1));
@@ -90,7 +93,11 @@ VirtualWin::~VirtualWin(void)
 	mutex.lock(false);
 	delete oldDraw;  oldDraw = NULL;
 	delete x11trans;  x11trans = NULL;
-	delete vglconn;  vglconn = NULL;
+	if(vglconn)
+	{
+		vglconn->removeWindow(x11Draw);
+		vgltranshash.detach(vglconn);  vglconn = NULL;
+	}
 	#ifdef USEXV
 	delete xvtrans;  xvtrans = NULL;
 	#endif
@@ -257,6 +264,49 @@ void VirtualWin::enableWMDeleteHandler(void)
 }
 
 
+// Add the region of the off-screen drawable that the current context can
+// render into, given its current state, to the dirty region.  Only the
+// scissor test clips every rendering operation (including glClear(),
+// glBlitFramebuffer(), and pixel operations), so the viewport is ignored.  If
+// the window is not current, if another context has made it current since
+// the last call, or if the caller cannot determine which scissor state was in
+// effect (full = true), then the whole drawable must be assumed to be dirty.
+
+void VirtualWin::addRenderBounds(bool full)
+{
+	CriticalSection::SafeLock l(mutex);
+	if(!fconfig.dirtyrect) return;
+	if(full || scissorUntracked) { dirtyRegion.addFull();  return; }
+
+	GLXContext ctx = backend::getCurrentContext();
+	if(!ctx || !oglDraw
+		|| backend::getCurrentDrawable() != oglDraw->getGLXDrawable())
+	{
+		dirtyRegion.addFull();  return;
+	}
+	if(dirtyCtx && ctx != dirtyCtx) dirtyRegion.addFull();
+	dirtyCtx = ctx;
+
+	GLint scissorTest = 0, box[4] = { 0, 0, 0, 0 };
+	_glGetIntegerv(GL_SCISSOR_TEST, &scissorTest);
+	if(!scissorTest) { dirtyRegion.addFull();  return; }
+	_glGetIntegerv(GL_SCISSOR_BOX, box);
+	dirtyRegion.add(box[0], box[1], box[2], box[3]);
+}
+
+
+// The per-viewport scissor state introduced in OpenGL 4.1 cannot be tracked
+// using the scissor box alone, so once an application uses it, the whole
+// drawable is assumed to be dirty in every subsequent frame.
+
+void VirtualWin::untrackScissor(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	scissorUntracked = true;
+	dirtyRegion.addFull();
+}
+
+
 void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 {
 	fconfig_reloadenv();
@@ -269,6 +319,7 @@ void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 	if(deletedByWM) THROW("Window has been deleted by window manager");
 
 	dirty = false;
+	addRenderBounds();
 
 	int compress = fconfig.compress;
 	if(sync && strlen(fconfig.transport) == 0) compress = RRCOMP_PROXY;
@@ -317,6 +368,7 @@ void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 	if(strlen(fconfig.transport) > 0)
 	{
 		sendPlugin(drawBuf, spoilLast, sync, doStereo, stereoMode);
+		faker::startupFirstFrame();
 		return;
 	}
 
@@ -331,8 +383,8 @@ void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 		case RRCOMP_YUV:
 			if(!vglconn)
 			{
-				vglconn = new VGLTrans();
-				vglconn->connect(
+				faker::StartupTimer timer(faker::STARTUP_TRANSPORT);
+				vglconn = vgltranshash.attach(
 					strlen(fconfig.client) > 0 ? fconfig.client : DisplayString(dpy),
 					fconfig.port);
 			}
@@ -344,6 +396,7 @@ void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 			sendXV(drawBuf, spoilLast, sync, doStereo, stereoMode);
 		#endif
 	}
+	faker::startupFirstFrame();
 }
 
 
@@ -470,14 +523,26 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 {
 	int w = oglDraw->getWidth(), h = oglDraw->getHeight();
 
-	if(spoilLast && fconfig.spoil && !vglconn->isReady())
+	if(spoilLast && fconfig.spoil && !vglconn->isReady(x11Draw))
 		return;
 	Frame *f;
 
 	if(oglDraw->getRGBSize() != 24)
 		THROW("The VGL Transport requires 8 bits per component");
 	int glFormat = GL_RGB, pixelFormat = PF_RGB;
-	if(compress != RRCOMP_RGB)
+	if(compress == RRCOMP_RGB)
+	{
+		// If the client's pixel format can be read back directly, then the RGB
+		// encoder can send the pixels as-is, and the client can copy them into
+		// its X image without converting them.
+		switch(vglconn->getNativePF())
+		{
+			case PF_RGBX:  glFormat = GL_RGBA;  pixelFormat = PF_RGBX;  break;
+			case PF_BGR:  glFormat = GL_BGR;  pixelFormat = PF_BGR;  break;
+			case PF_BGRX:  glFormat = GL_BGRA;  pixelFormat = PF_BGRX;  break;
+		}
+	}
+	else
 	{
 		glFormat = oglDraw->getFormat();
 		if(glFormat == GL_RGBA) pixelFormat = PF_RGBX;
@@ -485,9 +550,9 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 		else if(glFormat == GL_BGRA) pixelFormat = PF_BGRX;
 	}
 
-	if(!fconfig.spoil) vglconn->synchronize();
+	if(!fconfig.spoil) vglconn->synchronize(x11Draw);
 	ERRIFNOT(f = vglconn->getFrame(w, h, pixelFormat, FRAME_BOTTOMUP,
-		doStereo && stereoMode == RRSTEREO_QUADBUF));
+		doStereo && stereoMode == RRSTEREO_QUADBUF, x11Draw));
 	if(doStereo && IS_ANAGLYPHIC(stereoMode))
 	{
 		stereoFrame.deInit();
@@ -504,11 +569,16 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 		GLint readBuf = drawBuf;
 		if(doStereo || stereoMode == RRSTEREO_LEYE) readBuf = LEYE(drawBuf);
 		if(stereoMode == RRSTEREO_REYE) readBuf = REYE(drawBuf);
+		// Gamma correction is applied by the compression threads, one tile at a
+		// time, just before the tile is compared with the previous frame.
 		readPixels(0, 0, f->hdr.framew, f->pitch, f->hdr.frameh, glFormat, f->pf,
-			f->bits, readBuf, doStereo);
+			f->bits, readBuf, doStereo, false);
 		if(doStereo && f->rbits)
 			readPixels(0, 0, f->hdr.framew, f->pitch, f->hdr.frameh, glFormat, f->pf,
-				f->rbits, REYE(drawBuf), doStereo);
+				f->rbits, REYE(drawBuf), doStereo, false);
+		if(useGamma())
+			f->setGamma(fconfig.gamma_lut, fconfig.gamma_lut10,
+				fconfig.gamma_lut16);
 	}
 	f->hdr.winid = x11Draw;
 	f->hdr.framew = f->hdr.width;
@@ -519,7 +589,10 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 	f->hdr.subsamp = subsamp;
 	f->hdr.compress = (unsigned char)compress;
 	if(!syncdpy) { XSync(dpy, False);  syncdpy = true; }
-	if(fconfig.logo) f->addLogo();
+	if(fconfig.logo) f->flags |= FRAME_LOGO;
+	// The frame is captured by the transport thread once it has been
+	// compressed, so that the decoded JPEG image can be saved along with it.
+	if(selectCapture()) f->flags |= FRAME_CAPTURE;
 	vglconn->sendFrame(f);
 }
 
@@ -535,6 +608,8 @@ void VirtualWin::sendX11(GLint drawBuf, bool spoilLast, bool sync,
 	if(!fconfig.spoil) x11trans->synchronize();
 	ERRIFNOT(f = x11trans->getFrame(dpy, x11Draw, width, height));
 	f->flags |= FRAME_BOTTOMUP;
+	bool useDirtyRect = fconfig.dirtyrect && !fconfig.logo && !doStereo;
+	if(!useDirtyRect || x11trans->reclaimed()) dirtyRegion.reset();
 	if(doStereo && IS_ANAGLYPHIC(stereoMode))
 	{
 		stereoFrame.deInit();
@@ -551,15 +626,50 @@ void VirtualWin::sendX11(GLint drawBuf, bool spoilLast, bool sync,
 			GLint readBuf = drawBuf;
 			if(stereoMode == RRSTEREO_REYE) readBuf = REYE(drawBuf);
 			else if(stereoMode == RRSTEREO_LEYE) readBuf = LEYE(drawBuf);
-			readPixels(0, 0, min(width, f->hdr.framew), f->pitch,
-				min(height, f->hdr.frameh), GL_NONE, f->pf, f->bits, readBuf, false);
+			if(useDirtyRect)
+				readDirtyRect(f, readBuf, min(width, f->hdr.framew),
+					min(height, f->hdr.frameh));
+			else
+				readPixels(0, 0, min(width, f->hdr.framew), f->pitch,
+					min(height, f->hdr.frameh), GL_NONE, f->pf, f->bits, readBuf,
+					false);
 		}
 	}
 	if(fconfig.logo) f->addLogo();
+	if(selectCapture())
+		FrameCapture::getInstance()->capture(*f, x11Draw);
 	x11trans->sendFrame(f, sync);
 }
 
 
+// Bring a pooled frame buffer up to date by reading back only the portion of
+// the off-screen drawable that has changed since the frame buffer was last
+// used.  A bottom-up frame buffer is flipped in place when it is drawn, so the
+// changed rectangle is read into a temporary frame and copied into the frame
+// buffer in top-down order.  Otherwise, the rows that were not read back would
+// be in the wrong order if the frame buffer had been drawn.
+
+void VirtualWin::readDirtyRect(Frame *f, GLint readBuf, int width, int height)
+{
+	int x, y, w, h;
+
+	dirtyRegion.get(oglDraw, readBuf, f, f->bits, width, height, x, y, w, h);
+	f->flags &= ~FRAME_BOTTOMUP;
+	if(w < 1 || h < 1) return;
+
+	rrframeheader hdr;
+	memset(&hdr, 0, sizeof(rrframeheader));
+	hdr.width = hdr.framew = w;
+	hdr.height = hdr.frameh = h;
+	dirtyFrame.init(hdr, f->pf->id, FRAME_BOTTOMUP, false);
+	readPixels(x, y, w, dirtyFrame.pitch, h, GL_NONE, dirtyFrame.pf,
+		dirtyFrame.bits, readBuf, false);
+	for(int i = 0; i < h; i++)
+		memcpy(&f->bits[(height - y - i - 1) * f->pitch + x * f->pf->size],
+			&dirtyFrame.bits[i * dirtyFrame.pitch], w * f->pf->size);
+}
+
+
 #ifdef USEXV
 
 void VirtualWin::sendXV(GLint drawBuf, bool spoilLast, bool sync,
@@ -608,6 +718,8 @@ void VirtualWin::sendXV(GLint drawBuf, bool spoilLast, bool sync,
 	}
 
 	if(fconfig.logo) frame.addLogo();
+	if(selectCapture())
+		FrameCapture::getInstance()->capture(frame, x11Draw);
 
 	*f = frame;
 	xvtrans->sendFrame(f, sync);
@@ -658,16 +770,10 @@ void VirtualWin::makePassive(Frame *f, int drawBuf, GLenum glFormat,
 }
 
 
-void VirtualWin::readPixels(GLint x, GLint y, GLint width, GLint pitch,
-	GLint height, GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo)
+bool VirtualWin::useGamma(void)
 {
-	VirtualDrawable::readPixels(x, y, width, pitch, height, glFormat, pf, bits,
-		buf, stereo);
-
-	// Gamma correction
 	if(fconfig.gamma != 0.0 && fconfig.gamma != 1.0 && fconfig.gamma != -1.0)
 	{
-		profGamma.startFrame();
 		static bool first = true;
 		if(first)
 		{
@@ -676,6 +782,33 @@ void VirtualWin::readPixels(GLint x, GLint y, GLint width, GLint pitch,
 				vglout.println("[VGL] Using software gamma correction (correction factor=%f)\n",
 					fconfig.gamma);
 		}
+		return true;
+	}
+	return false;
+}
+
+
+// Return true if the frame that is about to be sent should be saved (see
+// VGL_CAPTURE)
+
+bool VirtualWin::selectCapture(void)
+{
+	if(!fconfig.capture[0]) return false;
+	return FrameCapture::getInstance()->select(captureSel);
+}
+
+
+void VirtualWin::readPixels(GLint x, GLint y, GLint width, GLint pitch,
+	GLint height, GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo,
+	bool gamma)
+{
+	VirtualDrawable::readPixels(x, y, width, pitch, height, glFormat, pf, bits,
+		buf, stereo);
+
+	// Gamma correction
+	if(gamma && useGamma())
+	{
+		profGamma.startFrame();
 		if(pf->bpc == 10)
 		{
 			int h = height;
@@ -16,12 +16,14 @@
 #define __VIRTUALWIN_H__
 
 #include "VirtualDrawable.h"
+#include "DirtyRegion.h"
 #include "VGLTrans.h"
 #ifdef USEXV
 #include "XVTrans.h"
 #endif
 #include "TransPlugin.h"
 #include "TempContext.h"
+#include "FrameCapture.h"
 
 
 namespace faker
@@ -41,6 +43,8 @@ namespace faker
 			void checkResize(void);
 			void initFromWindow(VGLFBConfig config);
 			void readback(GLint drawBuf, bool spoilLast, bool sync);
+			void addRenderBounds(bool full = false);
+			void untrackScissor(void);
 			void swapBuffers(void);
 			bool isStereo(void);
 			void wmDeleted(void);
@@ -54,7 +58,10 @@ namespace faker
 
 			int init(int w, int h, VGLFBConfig config);
 			void readPixels(GLint x, GLint y, GLint width, GLint pitch, GLint height,
-				GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo);
+				GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo,
+				bool gamma = true);
+			bool useGamma(void);
+			bool selectCapture(void);
 			void makeAnaglyph(common::Frame *f, int drawBuf, int stereoMode);
 			void makePassive(common::Frame *f, int drawBuf, GLenum glFormat,
 				int stereoMode);
@@ -62,6 +69,8 @@ namespace faker
 				int stereoMode, int compress, int qual, int subsamp);
 			void sendX11(GLint drawBuf, bool spoilLast, bool sync, bool doStereo,
 				int stereoMode);
+			void readDirtyRect(common::Frame *f, GLint readBuf, int width,
+				int height);
 			void sendPlugin(GLint drawBuf, bool spoilLast, bool sync, bool doStereo,
 				int stereoMode);
 			#ifdef USEXV
@@ -82,7 +91,11 @@ namespace faker
 			bool syncdpy;
 			server::TransPlugin *plugin;
 			bool stereoVisual;
-			common::Frame rFrame, gFrame, bFrame, frame, stereoFrame;
+			common::Frame rFrame, gFrame, bFrame, frame, stereoFrame, dirtyFrame;
+			DirtyRegion dirtyRegion;
+			server::FrameCapture::Selector captureSel;
+			GLXContext dirtyCtx;
+			bool scissorUntracked;
 			bool deletedByWM;
 			bool handleWMDelete;
 			bool newConfig;
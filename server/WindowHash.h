@@ -17,12 +17,18 @@
 
 #include "VirtualWin.h"
 #include "Hash.h"
+#ifdef USEHELGRIND
+	#include <valgrind/helgrind.h>
+#endif
 
 
 #define HASH  Hash<char *, Window, VirtualWin *>
 
 // This maps a window ID to an off-screen drawable instance
 
+// Number of buckets in the window ID filter (must be a power of 2)
+#define WINFILTERSIZE  4096
+
 namespace faker
 {
 	class WindowHash : public HASH
@@ -45,8 +51,21 @@ namespace faker
 			{
 				if(!dpy || !win) return;
 				char *dpystring = strdup(DisplayString(dpy));
+				util::CriticalSection::SafeLock l(mutex);
 				if(!HASH::add(dpystring, win, NULL))
 					free(dpystring);
+				else
+					filter[filterIndex(win)]++;
+			}
+
+			// Returns false if the window ID is definitely not in the hash.  This is
+			// lock-free and does not walk the hash, so the event handlers can use it
+			// to quickly reject events for windows that have never been used for
+			// OpenGL rendering.  It may return true for a window that is not in the
+			// hash, if that window's ID shares a bucket with a window that is.
+			bool mayContain(Window win)
+			{
+				return win && filter[filterIndex(win)] != 0;
 			}
 
 			// dpy == NULL: search for VirtualWin instance by off-screen drawable ID
@@ -54,6 +73,7 @@ namespace faker
 			VirtualWin *find(Display *dpy, GLXDrawable glxd)
 			{
 				if(!glxd) return NULL;
+				if(dpy && !mayContain(glxd)) return NULL;
 				return HASH::find(dpy ? DisplayString(dpy) : NULL, glxd);
 			}
 
@@ -66,9 +86,18 @@ namespace faker
 				{
 					if(!ptr->value)
 					{
-						ptr->value = new VirtualWin(dpy, win);
-						VirtualWin *vw = ptr->value;
-						vw->initFromWindow(config);
+						// find() doesn't wait for the mutex, so the VirtualWin instance
+						// must be fully initialized before it is added to the hash.
+						VirtualWin *vw = new VirtualWin(dpy, win);
+						try
+						{
+							vw->initFromWindow(config);
+						}
+						catch(...)
+						{
+							delete vw;  throw;
+						}
+						HASH::setValue(ptr, vw);
 					}
 					else
 					{
@@ -104,15 +133,33 @@ namespace faker
 
 		private:
 
+			WindowHash(void)
+			{
+				memset(filter, 0, sizeof(unsigned short) * WINFILTERSIZE);
+				#ifdef USEHELGRIND
+				ANNOTATE_BENIGN_RACE_SIZED(filter,
+					sizeof(unsigned short) * WINFILTERSIZE, );
+				#endif
+			}
+
 			~WindowHash(void)
 			{
 				WindowHash::kill();
 			}
 
+			static unsigned int filterIndex(Window win)
+			{
+				// X clients allocate resource IDs sequentially from a per-client base,
+				// so the low-order bits are the most variable.
+				return (unsigned int)(win ^ (win >> 21)) & (WINFILTERSIZE - 1);
+			}
+
 			void detach(HashEntry *entry)
 			{
 				if(entry)
 				{
+					if(entry->key2 && filter[filterIndex(entry->key2)] > 0)
+						filter[filterIndex(entry->key2)]--;
 					free(entry->key1);
 					delete entry->value;
 				}
@@ -136,6 +183,8 @@ namespace faker
 				);
 			}
 
+			unsigned short filter[WINFILTERSIZE];
+
 			static WindowHash *instance;
 			static util::CriticalSection instanceMutex;
 	};
@@ -13,97 +13,120 @@
 // wxWindows Library License for more details.
 
 #include "X11Trans.h"
-#include "Timer.h"
 #include "fakerconfig.h"
 #include "vglutil.h"
 #include "Log.h"
-#ifdef USEHELGRIND
-	#include <valgrind/helgrind.h>
-#endif
-
-extern "C" void _vgl_disableFaker(void);
-extern "C" void _vgl_enableFaker(void);
 
 using namespace util;
 using namespace common;
 using namespace server;
 
 
-X11Trans::X11Trans(void) : thread(NULL), deadYet(false)
+X11Trans::X11Trans(void) : pool(NULL), lastActive(GetTime()),
+	wasReclaimed(false), err(0.), first(true)
 {
 	for(int i = 0; i < NFRAMES; i++) frames[i] = NULL;
-	thread = new Thread(this);
-	thread->start();
 	profBlit.setName("Blit      ");
 	profTotal.setName("Total     ");
 	if(fconfig.verbose) fbx_printwarnings(vglout.getFile());
-	#ifdef USEHELGRIND
-	ANNOTATE_BENIGN_RACE_SIZED(&deadYet, sizeof(bool), );
-	// NOTE: Without this line, helgrind reports a data race on the class
-	// instance address in the destructor (false positive?)
-	ANNOTATE_BENIGN_RACE_SIZED(this, sizeof(X11Trans *), );
-	#endif
+	pool = BlitPool::getInstance();
+	pool->add(this);
 }
 
 
-void X11Trans::run(void)
+X11Trans::~X11Trans(void)
 {
-	Timer timer, sleepTimer;  double err = 0.;  bool first = true;
-
-	try
+	pool->remove(this);
+	q.release();
+	for(int i = 0; i < NFRAMES; i++)
 	{
-		_vgl_disableFaker();
+		delete frames[i];  frames[i] = NULL;
+	}
+}
 
-		while(!deadYet)
-		{
-			FBXFrame *f;  void *ftemp = NULL;
 
-			q.get(&ftemp);  f = (FBXFrame *)ftemp;  if(deadYet) return;
-			if(!f) THROW("Queue has been shut down");
-			ready.signal();
-			profBlit.startFrame();
-			f->redraw();
-			profBlit.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+// This is called from one of the blit pool's worker threads.
 
-			profTotal.endFrame(f->hdr.width * f->hdr.height, 0, 1);
-			profTotal.startFrame();
+void X11Trans::blit(void)
+{
+	FBXFrame *f;  void *ftemp = NULL;
 
-			if(fconfig.flushdelay > 0.)
-			{
-				long usec = (long)(fconfig.flushdelay * 1000000.);
-				if(usec > 0) usleep(usec);
-			}
-			if(fconfig.fps > 0.)
+	q.get(&ftemp, true);  f = (FBXFrame *)ftemp;
+	if(!f) return;
+
+	try
+	{
+		ready.signal();
+		profBlit.startFrame();
+		f->redraw();
+		profBlit.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+
+		profTotal.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+		profTotal.startFrame();
+
+		if(fconfig.flushdelay > 0.)
+		{
+			long usec = (long)(fconfig.flushdelay * 1000000.);
+			if(usec > 0) usleep(usec);
+		}
+		if(fconfig.fps > 0.)
+		{
+			double elapsed = timer.elapsed();
+			if(first) first = false;
+			else
 			{
-				double elapsed = timer.elapsed();
-				if(first) first = false;
-				else
+				if(elapsed < 1. / fconfig.fps)
 				{
-					if(elapsed < 1. / fconfig.fps)
-					{
-						sleepTimer.start();
-						long usec = (long)((1. / fconfig.fps - elapsed - err) * 1000000.);
-						if(usec > 0) usleep(usec);
-						double sleepTime = sleepTimer.elapsed();
-						err = sleepTime - (1. / fconfig.fps - elapsed - err);
-						if(err < 0.) err = 0.;
-					}
+					sleepTimer.start();
+					long usec = (long)((1. / fconfig.fps - elapsed - err) * 1000000.);
+					if(usec > 0) usleep(usec);
+					double sleepTime = sleepTimer.elapsed();
+					err = sleepTime - (1. / fconfig.fps - elapsed - err);
+					if(err < 0.) err = 0.;
 				}
-				timer.start();
 			}
-
-			f->signalComplete();
+			timer.start();
 		}
 
+		f->signalComplete();
 	}
-	catch(std::exception &e)
+	catch(...)
 	{
-		if(thread) thread->setError(e);
+		f->signalComplete();
 		ready.signal();
-		_vgl_enableFaker();
 		throw;
 	}
-	_vgl_enableFaker();
+}
+
+
+bool X11Trans::hasPending(void)
+{
+	return q.items() > 0;
+}
+
+
+void X11Trans::reclaim(double now, double idleTime, GenericQ &idleFrames)
+{
+	CriticalSection::SafeLock l(mutex);
+
+	if(now - lastActive < idleTime) return;
+	for(int i = 0; i < NFRAMES; i++)
+	{
+		if(frames[i] && frames[i]->isComplete())
+		{
+			idleFrames.add((Frame *)frames[i]);  frames[i] = NULL;
+			wasReclaimed = true;
+		}
+	}
+}
+
+
+bool X11Trans::reclaimed(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	bool retval = wasReclaimed;
+	wasReclaimed = false;
+	return retval;
 }
 
 
@@ -111,14 +134,22 @@ FBXFrame *X11Trans::getFrame(Display *dpy, Window win, int width, int height)
 {
 	FBXFrame *f = NULL;
 
-	if(thread) thread->checkError();
+	checkError();
+	pool->sweep();
 	{
 		CriticalSection::SafeLock l(mutex);
 
-		int index = -1;
+		lastActive = GetTime();
+		// Frame buffers are allocated only when all of the existing ones are in
+		// use, so a window that is drawn synchronously or at a low frame rate
+		// uses fewer of them.
+		int index = -1, empty = -1;
 		for(int i = 0; i < NFRAMES; i++)
-			if(!frames[i] || (frames[i] && frames[i]->isComplete()))
-				index = i;
+		{
+			if(!frames[i]) { if(empty < 0) empty = i; }
+			else if(frames[i]->isComplete()) index = i;
+		}
+		if(index < 0) index = empty;
 		if(index < 0) THROW("No free buffers in pool");
 		if(!frames[index])
 			frames[index] = new FBXFrame(dpy, win);
@@ -137,7 +168,7 @@ FBXFrame *X11Trans::getFrame(Display *dpy, Window win, int width, int height)
 
 bool X11Trans::isReady(void)
 {
-	if(thread) thread->checkError();
+	checkError();
 	return q.items() <= 0;
 }
 
@@ -156,7 +187,7 @@ static void __X11Trans_spoilfct(void *f)
 
 void X11Trans::sendFrame(FBXFrame *f, bool sync)
 {
-	if(thread) thread->checkError();
+	checkError();
 	if(sync)
 	{
 		profBlit.startFrame();
@@ -165,5 +196,9 @@ void X11Trans::sendFrame(FBXFrame *f, bool sync)
 		profBlit.endFrame(f->hdr.width * f->hdr.height, 0, 1);
 		ready.signal();
 	}
-	else q.spoil((void *)f, __X11Trans_spoilfct);
+	else
+	{
+		q.spoil((void *)f, __X11Trans_spoilfct);
+		pool->schedule(this);
+	}
 }
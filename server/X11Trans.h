@@ -15,37 +15,37 @@
 #ifndef __X11TRANS_H__
 #define __X11TRANS_H__
 
-#include "Thread.h"
+#include "BlitPool.h"
 #include "Frame.h"
 #include "GenericQ.h"
 #include "Profiler.h"
+#include "Timer.h"
 
 
 namespace server
 {
-	class X11Trans : public util::Runnable
+	class X11Trans : public BlitClient
 	{
 		public:
 
 			X11Trans(void);
-
-			virtual ~X11Trans(void)
-			{
-				deadYet = true;
-				q.release();
-				if(thread) { thread->stop();  delete thread;  thread = NULL; }
-				for(int i = 0; i < NFRAMES; i++)
-				{
-					delete frames[i];  frames[i] = NULL;
-				}
-			}
+			virtual ~X11Trans(void);
 
 			bool isReady(void);
 			void synchronize(void);
 			void sendFrame(common::FBXFrame *, bool sync = false);
-			void run(void);
 			common::FBXFrame *getFrame(Display *dpy, Window win, int width,
 				int height);
+			// Returns true if any frame buffers have been reclaimed since the last
+			// call.  The contents of the frame buffers returned by getFrame() cannot
+			// be relied upon if so.
+			bool reclaimed(void);
+
+		protected:
+
+			void blit(void);
+			bool hasPending(void);
+			void reclaim(double now, double idleTime, util::GenericQ &idleFrames);
 
 		private:
 
@@ -54,8 +54,12 @@ namespace server
 			common::FBXFrame *frames[NFRAMES];
 			util::Event ready;
 			util::GenericQ q;
-			util::Thread *thread;
-			bool deadYet;
+			BlitPool *pool;
+			double lastActive;
+			bool wasReclaimed;
+			util::Timer timer, sleepTimer;
+			double err;
+			bool first;
 			common::Profiler profBlit, profTotal;
 	};
 }
@@ -25,6 +25,10 @@ typedef struct
 {
 	Display *dpy;
 	xcb_atom_t protoAtom, deleteAtom;
+	// Key symbol table, which is allocated the first time a key press event is
+	// received and freed whenever the keyboard mapping changes
+	xcb_key_symbols_t *keySymbols;
+	util::CriticalSection keySymbolsMutex;
 } XCBConnAttribs;
 
 
@@ -55,6 +59,7 @@ namespace faker
 				XCBConnAttribs *attribs = NULL;
 				attribs = new XCBConnAttribs;
 				attribs->dpy = dpy;  attribs->protoAtom = 0;  attribs->deleteAtom = 0;
+				attribs->keySymbols = NULL;
 
 				// We set up the window manager atoms here because doing so in the
 				// event handler can cause a deadlock.
@@ -101,6 +106,33 @@ namespace faker
 				return 0;
 			}
 
+			xcb_keysym_t getKeySym(xcb_connection_t *conn, xcb_keycode_t keycode)
+			{
+				if(!conn) THROW("Invalid_argument");
+				XCBConnAttribs *attribs = HASH::find(conn, NULL);
+				if(!attribs) return 0;
+				util::CriticalSection::SafeLock l(attribs->keySymbolsMutex);
+				if(!attribs->keySymbols
+					&& !(attribs->keySymbols = _xcb_key_symbols_alloc(conn)))
+					return 0;
+				return _xcb_key_symbols_get_keysym(attribs->keySymbols, keycode, 0);
+			}
+
+			// Called when a MappingNotify event is received.  The key symbol table
+			// will be re-read from the X server the next time it is needed.
+			void invalidateKeySyms(xcb_connection_t *conn)
+			{
+				if(!conn) THROW("Invalid_argument");
+				XCBConnAttribs *attribs = HASH::find(conn, NULL);
+				if(!attribs) return;
+				util::CriticalSection::SafeLock l(attribs->keySymbolsMutex);
+				if(attribs->keySymbols)
+				{
+					_xcb_key_symbols_free(attribs->keySymbols);
+					attribs->keySymbols = NULL;
+				}
+			}
+
 		private:
 
 			~XCBConnHash(void)
@@ -116,6 +148,8 @@ namespace faker
 			void detach(HashEntry *entry)
 			{
 				XCBConnAttribs *attribs = entry ? entry->value : NULL;
+				if(attribs && attribs->keySymbols)
+					_xcb_key_symbols_free(attribs->keySymbols);
 				delete attribs;
 			}
 
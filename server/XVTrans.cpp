@@ -14,87 +14,109 @@
 
 #include "XVTrans.h"
 #include "vglutil.h"
-#include "Timer.h"
 #include "fakerconfig.h"
 #include "Log.h"
-#ifdef USEHELGRIND
-	#include <valgrind/helgrind.h>
-#endif
 
 using namespace util;
 using namespace common;
 using namespace server;
 
 
-XVTrans::XVTrans(void) : thread(NULL), deadYet(false)
+XVTrans::XVTrans(void) : lastFrame(NULL), pool(NULL), lastActive(GetTime()),
+	err(0.), first(true)
 {
 	for(int i = 0; i < NFRAMES; i++) frames[i] = NULL;
-	thread = new Thread(this);
-	thread->start();
 	profXV.setName("XV        ");
 	profTotal.setName("Total     ");
 	if(fconfig.verbose) fbxv_printwarnings(vglout.getFile());
-	#ifdef USEHELGRIND
-	ANNOTATE_BENIGN_RACE_SIZED(&deadYet, sizeof(bool), );
-	// NOTE: Without this line, helgrind reports a data race on the class
-	// instance address in the destructor (false positive?)
-	ANNOTATE_BENIGN_RACE_SIZED(this, sizeof(XVTrans *), );
-	#endif
+	pool = BlitPool::getInstance();
+	pool->add(this);
 }
 
 
-void XVTrans::run(void)
+XVTrans::~XVTrans(void)
 {
-	Timer timer, sleepTimer;  double err = 0.;  bool first = true;
+	pool->remove(this);
+	q.release();
+	for(int i = 0; i < NFRAMES; i++)
+	{
+		delete frames[i];  frames[i] = NULL;
+	}
+}
+
+
+// This is called from one of the blit pool's worker threads.
+
+void XVTrans::blit(void)
+{
+	XVFrame *f;  void *ftemp = NULL;
+
+	q.get(&ftemp, true);  f = (XVFrame *)ftemp;
+	if(!f) return;
 
 	try
 	{
-		while(!deadYet)
-		{
-			XVFrame *f;  void *ftemp = NULL;
-
-			q.get(&ftemp);  f = (XVFrame *)ftemp;  if(deadYet) return;
-			if(!f) throw("Queue has been shut down");
-			ready.signal();
-			profXV.startFrame();
-			f->redraw();
-			profXV.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+		ready.signal();
+		profXV.startFrame();
+		f->redraw();
+		profXV.endFrame(f->hdr.width * f->hdr.height, 0, 1);
 
-			profTotal.endFrame(f->hdr.width * f->hdr.height, 0, 1);
-			profTotal.startFrame();
+		profTotal.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+		profTotal.startFrame();
 
-			if(fconfig.flushdelay > 0.)
-			{
-				long usec = (long)(fconfig.flushdelay * 1000000.);
-				if(usec > 0) usleep(usec);
-			}
-			if(fconfig.fps > 0.)
+		if(fconfig.flushdelay > 0.)
+		{
+			long usec = (long)(fconfig.flushdelay * 1000000.);
+			if(usec > 0) usleep(usec);
+		}
+		if(fconfig.fps > 0.)
+		{
+			double elapsed = timer.elapsed();
+			if(first) first = false;
+			else
 			{
-				double elapsed = timer.elapsed();
-				if(first) first = false;
-				else
+				if(elapsed < 1. / fconfig.fps)
 				{
-					if(elapsed < 1. / fconfig.fps)
-					{
-						sleepTimer.start();
-						long usec = (long)((1. / fconfig.fps - elapsed - err) * 1000000.);
-						if(usec > 0) usleep(usec);
-						double sleepTime = sleepTimer.elapsed();
-						err = sleepTime - (1. / fconfig.fps - elapsed - err);
-						if(err < 0.) err = 0.;
-					}
+					sleepTimer.start();
+					long usec = (long)((1. / fconfig.fps - elapsed - err) * 1000000.);
+					if(usec > 0) usleep(usec);
+					double sleepTime = sleepTimer.elapsed();
+					err = sleepTime - (1. / fconfig.fps - elapsed - err);
+					if(err < 0.) err = 0.;
 				}
-				timer.start();
 			}
-
-			f->signalComplete();
+			timer.start();
 		}
 
+		f->signalComplete();
 	}
-	catch(std::exception &e)
+	catch(...)
 	{
-		if(thread) thread->setError(e);
-		ready.signal();  throw;
+		f->signalComplete();
+		ready.signal();
+		throw;
+	}
+}
+
+
+bool XVTrans::hasPending(void)
+{
+	return q.items() > 0;
+}
+
+
+void XVTrans::reclaim(double now, double idleTime, GenericQ &idleFrames)
+{
+	CriticalSection::SafeLock l(mutex);
+
+	if(now - lastActive < idleTime) return;
+	for(int i = 0; i < NFRAMES; i++)
+	{
+		if(frames[i] && frames[i]->isComplete())
+		{
+			if(frames[i] == lastFrame) lastFrame = NULL;
+			idleFrames.add((Frame *)frames[i]);  frames[i] = NULL;
+		}
 	}
 }
 
@@ -103,14 +125,26 @@ XVFrame *XVTrans::getFrame(Display *dpy, Window win, int width, int height)
 {
 	XVFrame *f = NULL;
 
-	if(thread) thread->checkError();
+	checkError();
+	pool->sweep();
 	{
 		CriticalSection::SafeLock l(mutex);
 
-		int index = -1;
+		lastActive = GetTime();
+		// Avoid reusing the most recently sent frame if possible, since the X
+		// server may still be drawing it.  Otherwise, frame buffers are allocated
+		// only when all of the existing ones are in use.
+		int index = -1, empty = -1, last = -1;
 		for(int i = 0; i < NFRAMES; i++)
-			if(!frames[i] || (frames[i] && frames[i]->isComplete()))
-				index = i;
+		{
+			if(!frames[i]) { if(empty < 0) empty = i; }
+			else if(frames[i]->isComplete())
+			{
+				if(frames[i] == lastFrame) last = i;
+				else index = i;
+			}
+		}
+		if(index < 0) index = (empty >= 0 ? empty : last);
 		if(index < 0) THROW("No free buffers in pool");
 		if(!frames[index])
 			frames[index] = new XVFrame(dpy, win);
@@ -129,7 +163,7 @@ XVFrame *XVTrans::getFrame(Display *dpy, Window win, int width, int height)
 
 bool XVTrans::isReady(void)
 {
-	if(thread) thread->checkError();
+	checkError();
 	return q.items() <= 0;
 }
 
@@ -148,14 +182,23 @@ static void __XVTrans_spoilfct(void *f)
 
 void XVTrans::sendFrame(XVFrame *f, bool sync)
 {
-	if(thread) thread->checkError();
+	checkError();
+	{
+		CriticalSection::SafeLock l(mutex);
+		lastFrame = f;
+	}
 	if(sync)
 	{
 		profXV.startFrame();
 		f->redraw();
+		f->sync();
 		f->signalComplete();
 		profXV.endFrame(f->hdr.width * f->hdr.height, 0, 1);
 		ready.signal();
 	}
-	else q.spoil((void *)f, __XVTrans_spoilfct);
+	else
+	{
+		q.spoil((void *)f, __XVTrans_spoilfct);
+		pool->schedule(this);
+	}
 }
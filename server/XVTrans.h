@@ -15,46 +15,45 @@
 #ifndef __XVTRANS_H__
 #define __XVTRANS_H__
 
-#include "Thread.h"
+#include "BlitPool.h"
 #include "Frame.h"
 #include "GenericQ.h"
 #include "Profiler.h"
+#include "Timer.h"
 
 
 namespace server
 {
-	class XVTrans : public util::Runnable
+	class XVTrans : public BlitClient
 	{
 		public:
 
 			XVTrans(void);
-
-			virtual ~XVTrans(void)
-			{
-				deadYet = true;
-				q.release();
-				if(thread) { thread->stop();  delete thread;  thread = NULL; }
-				for(int i = 0; i < NFRAMES; i++)
-				{
-					delete frames[i];  frames[i] = NULL;
-				}
-			}
+			virtual ~XVTrans(void);
 
 			bool isReady(void);
 			void synchronize(void);
 			void sendFrame(common::XVFrame *f, bool sync = false);
-			void run(void);
 			common::XVFrame *getFrame(Display *dpy, Window win, int w, int h);
 
+		protected:
+
+			void blit(void);
+			bool hasPending(void);
+			void reclaim(double now, double idleTime, util::GenericQ &idleFrames);
+
 		private:
 
 			static const int NFRAMES = 3;
 			util::CriticalSection mutex;
-			common::XVFrame *frames[NFRAMES];
+			common::XVFrame *frames[NFRAMES], *lastFrame;
 			util::Event ready;
 			util::GenericQ q;
-			util::Thread *thread;
-			bool deadYet;
+			BlitPool *pool;
+			double lastActive;
+			util::Timer timer, sleepTimer;
+			double err;
+			bool first;
 			common::Profiler profXV, profTotal;
 	};
 }
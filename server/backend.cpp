@@ -52,8 +52,167 @@ VGL_THREAD_LOCAL(CurrentDrawableEGL, GLXDrawable, None)
 VGL_THREAD_LOCAL(CurrentReadDrawableEGL, GLXDrawable, None)
 
 
+// The EGL back end's record of the context that is current in this thread.
+// It is refreshed by makeCurrent() and bindFramebuffer(), so the interposed
+// functions that are called frequently by applications (glGetIntegerv(),
+// glDrawBuffer(), etc.) can obtain the context attributes and the current
+// FakePbuffers without searching the context and Pbuffer hashes or querying
+// the framebuffer bindings from the OpenGL implementation.  The record holds
+// a reference to the context attributes and to each FakePbuffer, so they
+// remain valid even if another thread destroys the context or Pbuffer (which
+// GLX allows, and which the faker itself does when a window is destroyed or
+// resized.)
+
+typedef struct
+{
+	EGLContext ctx;
+	EGLContextAttribs *attribs;
+	FakePbuffer *drawpb, *readpb;
+	// true if the FBO belonging to drawpb/readpb is bound
+	bool drawpbBound, readpbBound;
+	unsigned int generation;
+} CurrentStateEGL;
+
+// This is incremented whenever a context or Pbuffer is destroyed, which
+// causes each thread to look up its current context and Pbuffers again, so it
+// stops using (and releases its references to) the ones that were destroyed.
+// It is read without a lock on every interposed call.  A thread that reads a
+// stale value merely uses the destroyed context attributes or FakePbuffer for
+// a little longer, which is safe because the thread holds references to them.
+static unsigned int stateGeneration = 0;
+
+
+static void releaseCurrentStateEGL(CurrentStateEGL *cs)
+{
+	ContextHashEGL::release(cs->attribs);
+	if(cs->drawpb) cs->drawpb->release();
+	if(cs->readpb) cs->readpb->release();
+	cs->ctx = 0;  cs->attribs = NULL;  cs->drawpb = cs->readpb = NULL;
+	cs->drawpbBound = cs->readpbBound = false;
+}
+
+
+// Look up the context attributes and the FakePbuffers for the current
+// drawables and take references to them.  Since Pbuffer IDs are never reused,
+// a FakePbuffer that is found is the same one that was previously current
+// for the same drawable.
+
+static void acquireCurrentStateEGL(CurrentStateEGL *cs, EGLContext ctx)
+{
+	cs->attribs = ctxhashegl.findAttribsRef(ctx);
+	if(!cs->attribs) return;
+	cs->ctx = ctx;
+	cs->drawpb = pbhashegl.findRef(getCurrentDrawableEGL());
+	cs->readpb = pbhashegl.findRef(getCurrentReadDrawableEGL());
+}
+
+
+static void deleteCurrentStateEGL(void *ptr)
+{
+	CurrentStateEGL *cs = (CurrentStateEGL *)ptr;
+	releaseCurrentStateEGL(cs);
+	delete cs;
+}
+
+
+static pthread_key_t getCurrentStateEGLKey(void)
+{
+	static pthread_key_t key;
+	static bool init = false;
+	if(!init)
+	{
+		if(pthread_key_create(&key, deleteCurrentStateEGL))
+		{
+			vglout.println("[VGL] ERROR: pthread_key_create() for CurrentStateEGL failed.\n");
+			faker::safeExit(1);
+		}
+		init = true;
+	}
+	return key;
+}
+
+
+// This must be called after the context or Pbuffer is removed from its hash,
+// so that a thread that observes the new generation cannot find and take a new
+// reference to the destroyed context or Pbuffer.
+
+static void invalidateCurrentStateEGL(void)
+{
+	__atomic_add_fetch(&stateGeneration, 1, __ATOMIC_SEQ_CST);
+}
+
+
+static unsigned int getStateGeneration(void)
+{
+	return __atomic_load_n(&stateGeneration, __ATOMIC_RELAXED);
+}
+
+
+static void setCurrentStateEGL(EGLContext ctx, bool drawpbBound,
+	bool readpbBound, unsigned int generation)
+{
+	CurrentStateEGL *cs =
+		(CurrentStateEGL *)pthread_getspecific(getCurrentStateEGLKey());
+	if(!cs)
+	{
+		if(!ctx) return;
+		cs = new CurrentStateEGL;
+		cs->ctx = 0;  cs->attribs = NULL;  cs->drawpb = cs->readpb = NULL;
+		pthread_setspecific(getCurrentStateEGLKey(), cs);
+	}
+	releaseCurrentStateEGL(cs);
+	if(ctx) acquireCurrentStateEGL(cs, ctx);
+	cs->drawpbBound = cs->drawpb && drawpbBound;
+	cs->readpbBound = cs->readpb && readpbBound;
+	cs->generation = generation;
+}
+
+
+// Returns NULL if the record is not valid for the context that is actually
+// current in this thread, in which case the caller must fall back to looking
+// up the state.
+
+static CurrentStateEGL *getCurrentStateEGL(void)
+{
+	CurrentStateEGL *cs =
+		(CurrentStateEGL *)pthread_getspecific(getCurrentStateEGLKey());
+	if(!cs || !cs->ctx || cs->ctx != _eglGetCurrentContext()) return NULL;
+	unsigned int generation = getStateGeneration();
+	if(cs->generation != generation)
+	{
+		EGLContext ctx = cs->ctx;
+		bool drawpbBound = cs->drawpbBound, readpbBound = cs->readpbBound;
+		releaseCurrentStateEGL(cs);
+		acquireCurrentStateEGL(cs, ctx);
+		cs->drawpbBound = cs->drawpb && drawpbBound;
+		cs->readpbBound = cs->readpb && readpbBound;
+		cs->generation = generation;
+		if(!cs->ctx) return NULL;
+	}
+	return cs;
+}
+
+
+static FakePbuffer *getCurrentPbuffer(EGLint readdraw)
+{
+	CurrentStateEGL *cs = getCurrentStateEGL();
+	if(cs) return readdraw == EGL_READ ? cs->readpb : cs->drawpb;
+	return pbhashegl.find(readdraw == EGL_READ ?
+		getCurrentReadDrawableEGL() : getCurrentDrawableEGL());
+}
+
+
+// Returns the current FakePbuffer only if its FBO is bound
+
 static FakePbuffer *getCurrentFakePbuffer(EGLint readdraw)
 {
+	CurrentStateEGL *cs = getCurrentStateEGL();
+	if(cs)
+	{
+		if(readdraw == EGL_READ) return cs->readpbBound ? cs->readpb : NULL;
+		return cs->drawpbBound ? cs->drawpb : NULL;
+	}
+
 	FakePbuffer *pb = pbhashegl.find(readdraw == EGL_READ ?
 		getCurrentReadDrawableEGL() : getCurrentDrawableEGL());
 	if(pb)
@@ -75,33 +234,47 @@ void bindFramebuffer(GLenum target, GLuint framebuffer, bool ext)
 	#ifdef EGLBACKEND
 	if(fconfig.egl)
 	{
+		CurrentStateEGL *cs = getCurrentStateEGL();
+		EGLContextAttribs *attribs = cs ? cs->attribs :
+			ctxhashegl.findAttribs(_eglGetCurrentContext());
+
 		if(framebuffer == 0)
 		{
 			if(target == GL_DRAW_FRAMEBUFFER || target == GL_FRAMEBUFFER)
 			{
-				FakePbuffer *pb = pbhashegl.find(getCurrentDrawableEGL());
+				FakePbuffer *pb = getCurrentPbuffer(EGL_DRAW);
 				if(pb)
 				{
 					framebuffer = pb->getFBO();
-					ctxhashegl.setDrawFBO(_eglGetCurrentContext(), 0);
+					if(attribs) attribs->drawFBO = 0;
 				}
 			}
 			if(target == GL_READ_FRAMEBUFFER || target == GL_FRAMEBUFFER)
 			{
-				FakePbuffer *pb = pbhashegl.find(getCurrentReadDrawableEGL());
+				FakePbuffer *pb = getCurrentPbuffer(EGL_READ);
 				if(pb)
 				{
 					framebuffer = pb->getFBO();
-					ctxhashegl.setReadFBO(_eglGetCurrentContext(), 0);
+					if(attribs) attribs->readFBO = 0;
 				}
 			}
 		}
-		else
+		else if(attribs)
+		{
+			if(target == GL_DRAW_FRAMEBUFFER || target == GL_FRAMEBUFFER)
+				attribs->drawFBO = framebuffer;
+			if(target == GL_READ_FRAMEBUFFER || target == GL_FRAMEBUFFER)
+				attribs->readFBO = framebuffer;
+		}
+
+		if(cs)
 		{
 			if(target == GL_DRAW_FRAMEBUFFER || target == GL_FRAMEBUFFER)
-				ctxhashegl.setDrawFBO(_eglGetCurrentContext(), framebuffer);
+				cs->drawpbBound =
+					cs->drawpb && framebuffer == cs->drawpb->getFBO();
 			if(target == GL_READ_FRAMEBUFFER || target == GL_FRAMEBUFFER)
-				ctxhashegl.setReadFBO(_eglGetCurrentContext(), framebuffer);
+				cs->readpbBound =
+					cs->readpb && framebuffer == cs->readpb->getFBO();
 		}
 	}
 	#endif
@@ -320,6 +493,7 @@ void destroyContext(Display *dpy, GLXContext ctx)
 			if(!ctx) return;
 			VGLFBConfig config = ctxhashegl.findConfig(ctx);
 			ctxhashegl.remove(ctx);
+			invalidateCurrentStateEGL();
 			if(!_eglBindAPI(EGL_OPENGL_API))
 				THROW("Could not enable OpenGL API");
 			if(!_eglDestroyContext(EDPY, (EGLContext)ctx))
@@ -343,6 +517,7 @@ void destroyPbuffer(Display *dpy, GLXPbuffer pbuf)
 		try
 		{
 			pbhashegl.remove(pbuf);
+			invalidateCurrentStateEGL();
 		}
 		CATCH_EGL(X_GLXDestroyPbuffer)
 	}
@@ -406,7 +581,7 @@ Display *getCurrentDisplay(void)
 	#ifdef EGLBACKEND
 	if(fconfig.egl)
 	{
-		FakePbuffer *pb = pbhashegl.find(getCurrentDrawableEGL());
+		FakePbuffer *pb = getCurrentPbuffer(EGL_DRAW);
 		return pb ? pb->getDisplay() : NULL;
 	}
 	else
@@ -658,10 +833,16 @@ void getIntegerv(GLenum pname, GLint *params)
 	#ifdef EGLBACKEND
 	if(fconfig.egl)
 	{
-		if(!_eglBindAPI(EGL_OPENGL_API))
-			THROW("Could not enable OpenGL API");
-		EGLContext ctx = _eglGetCurrentContext();
-		VGLFBConfig config = ctxhashegl.findConfig(ctx);
+		CurrentStateEGL *cs = getCurrentStateEGL();
+		EGLContextAttribs *attribs = NULL;
+		if(cs) attribs = cs->attribs;
+		else
+		{
+			if(!_eglBindAPI(EGL_OPENGL_API))
+				THROW("Could not enable OpenGL API");
+			attribs = ctxhashegl.findAttribs(_eglGetCurrentContext());
+		}
+		VGLFBConfig config = attribs ? attribs->config : 0;
 
 		if(!params || !config)
 		{
@@ -680,10 +861,9 @@ void getIntegerv(GLenum pname, GLint *params)
 		else if(pname == GL_DRAW_BUFFER)
 		{
 			FakePbuffer *pb = getCurrentFakePbuffer(EGL_DRAW);
-			GLenum drawBuf = ctxhashegl.getDrawBuffer(ctx, 0);
 			if(pb)
 			{
-				*params = drawBuf;
+				*params = attribs->nDrawBufs > 0 ? attribs->drawBufs[0] : GL_NONE;
 				return;
 			}
 		}
@@ -691,16 +871,16 @@ void getIntegerv(GLenum pname, GLint *params)
 		{
 			FakePbuffer *pb = getCurrentFakePbuffer(EGL_DRAW);
 			int index = pname - GL_DRAW_BUFFER0;
-			GLenum drawBuf = ctxhashegl.getDrawBuffer(ctx, index);
 			if(pb)
 			{
-				*params = drawBuf;
+				*params = index < attribs->nDrawBufs ?
+					attribs->drawBufs[index] : GL_NONE;
 				return;
 			}
 		}
 		else if(pname == GL_DRAW_FRAMEBUFFER_BINDING)
 		{
-			*params = ctxhashegl.getDrawFBO(ctx);
+			*params = attribs->drawFBO;
 			return;
 		}
 		else if(pname == GL_MAX_DRAW_BUFFERS)
@@ -712,16 +892,15 @@ void getIntegerv(GLenum pname, GLint *params)
 		else if(pname == GL_READ_BUFFER)
 		{
 			FakePbuffer *pb = getCurrentFakePbuffer(EGL_READ);
-			GLenum readBuf = ctxhashegl.getReadBuffer(ctx);
 			if(pb)
 			{
-				*params = readBuf;
+				*params = attribs->readBuf;
 				return;
 			}
 		}
 		else if(pname == GL_READ_FRAMEBUFFER_BINDING)
 		{
-			*params = ctxhashegl.getReadFBO(ctx);
+			*params = attribs->readFBO;
 			return;
 		}
 		else if(pname == GL_STEREO)
@@ -752,7 +931,7 @@ void getNamedFramebufferParameteriv(GLuint framebuffer, GLenum pname,
 		}
 		FakePbuffer *pb;
 		if(framebuffer == 0
-			&& (pb = pbhashegl.find(getCurrentDrawableEGL())) != NULL)
+			&& (pb = getCurrentPbuffer(EGL_DRAW)) != NULL)
 		{
 			if(pname == GL_DOUBLEBUFFER)
 			{
@@ -791,6 +970,8 @@ Bool makeCurrent(Display *dpy, GLXDrawable draw, GLXDrawable read,
 	{
 		try
 		{
+			unsigned int generation = getStateGeneration();
+			setCurrentStateEGL(0, false, false, generation);
 			if(!_eglBindAPI(EGL_OPENGL_API))
 				THROW("Could not enable OpenGL API");
 			EGLBoolean ret = (Bool)_eglMakeCurrent(EDPY, EGL_NO_SURFACE,
@@ -863,6 +1044,9 @@ Bool makeCurrent(Display *dpy, GLXDrawable draw, GLXDrawable read,
 				}
 			}
 
+			setCurrentStateEGL((EGLContext)ctx, boundNewDrawFBO, boundNewReadFBO,
+				generation);
+
 			return ret;
 		}
 		CATCH_EGL(X_GLXMakeContextCurrent)
@@ -881,7 +1065,7 @@ void namedFramebufferDrawBuffer(GLuint framebuffer, GLenum buf, bool ext)
 	{
 		FakePbuffer *pb;
 		if(framebuffer == 0
-			&& (pb = pbhashegl.find(getCurrentDrawableEGL())) != NULL)
+			&& (pb = getCurrentPbuffer(EGL_DRAW)) != NULL)
 		{
 			pb->setDrawBuffer(buf, true);
 			return;
@@ -901,7 +1085,7 @@ void namedFramebufferDrawBuffers(GLuint framebuffer, GLsizei n,
 	{
 		FakePbuffer *pb;
 		if(framebuffer == 0
-			&& (pb = pbhashegl.find(getCurrentDrawableEGL())) != NULL)
+			&& (pb = getCurrentPbuffer(EGL_DRAW)) != NULL)
 		{
 			pb->setDrawBuffers(n, bufs, true);
 			return;
@@ -920,7 +1104,7 @@ void namedFramebufferReadBuffer(GLuint framebuffer, GLenum mode, bool ext)
 	{
 		FakePbuffer *pb;
 		if(framebuffer == 0
-			&& (pb = pbhashegl.find(getCurrentReadDrawableEGL())) != NULL)
+			&& (pb = getCurrentPbuffer(EGL_READ)) != NULL)
 		{
 			pb->setReadBuffer(mode, true);
 			return;
@@ -1069,7 +1253,9 @@ void readPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,
 	if(fconfig.egl)
 	{
 		bool fallthrough = true;
-		VGLFBConfig config = ctxhashegl.findConfig(_eglGetCurrentContext());
+		CurrentStateEGL *cs = getCurrentStateEGL();
+		VGLFBConfig config = cs ? cs->attribs->config :
+			ctxhashegl.findConfig(_eglGetCurrentContext());
 		FakePbuffer *readpb = getCurrentFakePbuffer(EGL_READ);
 
 		if(config && config->attr.samples > 1 && readpb)
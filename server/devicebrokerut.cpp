@@ -0,0 +1,285 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// This program tests the 3D X server/EGL device selection policies using a
+// mock device list and a private registry.  Each session is a child process
+// that selects a device and then waits until the test is finished.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "DeviceBroker.h"
+#include "Error.h"
+#include "vglutil.h"
+
+using namespace faker;
+
+
+#define NDEVICES  4
+#define MAXCHILDREN  16
+
+static char shmName[64];
+static char *devices[NDEVICES] =
+{
+	(char *)"mock0", (char *)"mock1", (char *)"mock2", (char *)"mock3"
+};
+static pid_t children[MAXCHILDREN];
+static int numChildren = 0, holdPipe[2] = { -1, -1 };
+
+
+// Start a session in a child process, and return the index of the device
+// that it selected.  Odd-numbered sessions unregister themselves when they
+// exit.  Even-numbered sessions exit without unregistering, so the broker has
+// to purge them.
+
+static int startSession(char **devs, int numDevs, int policy,
+	const int *nodes = NULL, int localNode = -1)
+{
+	int resultPipe[2], selected = -1;
+	pid_t pid;
+
+	if(numChildren >= MAXCHILDREN) THROW("Too many sessions");
+	TRY_UNIX(pipe(resultPipe));
+	TRY_UNIX(pid = fork());
+	if(pid == 0)
+	{
+		char c;
+		close(resultPipe[0]);  close(holdPipe[1]);
+		try
+		{
+			DeviceBroker *broker = new DeviceBroker(shmName);
+			selected = broker->select(devs, numDevs, policy, nodes, localNode);
+			if(write(resultPipe[1], &selected, sizeof(int)) != sizeof(int))
+				_exit(1);
+			while(read(holdPipe[0], &c, 1) > 0) {}
+			if(numChildren % 2) delete broker;
+		}
+		catch(std::exception &e)
+		{
+			fprintf(stderr, "%s--\n%s\n", GET_METHOD(e), e.what());
+			_exit(1);
+		}
+		_exit(0);
+	}
+	children[numChildren++] = pid;
+	close(resultPipe[1]);
+	if(read(resultPipe[0], &selected, sizeof(int)) != sizeof(int))
+		selected = -1;
+	close(resultPipe[0]);
+	if(selected < 0 || selected >= numDevs) THROW("Session failed");
+	return selected;
+}
+
+
+// Lock the registry from a child process until the test is finished
+
+static void holdLock(void)
+{
+	int readyPipe[2];
+	char c = 0;
+	pid_t pid;
+
+	if(numChildren >= MAXCHILDREN) THROW("Too many sessions");
+	TRY_UNIX(pipe(readyPipe));
+	TRY_UNIX(pid = fork());
+	if(pid == 0)
+	{
+		struct flock fl;
+		int fd;
+		close(readyPipe[0]);  close(holdPipe[1]);
+		memset(&fl, 0, sizeof(struct flock));
+		fl.l_type = F_WRLCK;  fl.l_whence = SEEK_SET;
+		if((fd = shm_open(shmName, O_RDWR, 0)) == -1
+			|| fcntl(fd, F_SETLK, &fl) == -1)
+			_exit(1);
+		if(write(readyPipe[1], &c, 1) != 1) _exit(1);
+		while(read(holdPipe[0], &c, 1) > 0) {}
+		_exit(0);
+	}
+	children[numChildren++] = pid;
+	close(readyPipe[1]);
+	if(read(readyPipe[0], &c, 1) != 1) THROW("Could not lock registry");
+	close(readyPipe[0]);
+}
+
+
+// Overwrite the registry with invalid sessions
+
+static void corruptRegistry(void)
+{
+	struct
+	{
+		unsigned int magic, nextDevice;
+		struct
+		{
+			pid_t pid;
+			char device[MAXSTR];
+		} sessions[2];
+	} reg;
+	int fd;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.magic = 0x42474C56;
+	reg.sessions[0].pid = -1;
+	strcpy(reg.sessions[0].device, devices[0]);
+	// Unterminated device name
+	reg.sessions[1].pid = getpid();
+	memset(reg.sessions[1].device, 'x', MAXSTR);
+	memcpy(reg.sessions[1].device, devices[1], strlen(devices[1]));
+	TRY_UNIX(fd = shm_open(shmName, O_RDWR, 0));
+	if(pwrite(fd, &reg, sizeof(reg), 0) != (ssize_t)sizeof(reg))
+	{
+		close(fd);  THROW("Could not write registry");
+	}
+	close(fd);
+}
+
+
+static void beginTest(const char *name)
+{
+	fprintf(stderr, "%-40s", name);
+	TRY_UNIX(pipe(holdPipe));
+}
+
+
+static void endTest(void)
+{
+	close(holdPipe[0]);  close(holdPipe[1]);
+	for(int i = 0; i < numChildren; i++)
+	{
+		int status = 0;
+		waitpid(children[i], &status, 0);
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			THROW("Session process failed");
+	}
+	numChildren = 0;
+}
+
+
+static bool checkSessions(DeviceBroker &broker, const int *expected)
+{
+	for(int i = 0; i < NDEVICES; i++)
+	{
+		int sessions = broker.getSessions(devices[i]);
+		if(sessions != expected[i])
+		{
+			fprintf(stderr, "FAILED! (%s has %d sessions, expected %d)\n",
+				devices[i], sessions, expected[i]);
+			return false;
+		}
+	}
+	fprintf(stderr, "Passed.\n");
+	return true;
+}
+
+
+int main(void)
+{
+	int retval = 0, i;
+
+	snprintf(shmName, 64, "/VirtualGL-devicebrokerut-%d", (int)getpid());
+
+	try
+	{
+		DeviceBroker broker(shmName);
+
+		beginTest("Round robin:");
+		{
+			int expected[NDEVICES] = { 2, 2, 2, 2 };
+			for(i = 0; i < 8; i++)
+			{
+				int selected = startSession(devices, NDEVICES, RRDPY_ROUNDROBIN);
+				if(selected != i % NDEVICES)
+					THROW("Round-robin order not followed");
+			}
+			if(!checkSessions(broker, expected)) retval = -1;
+		}
+		endTest();
+
+		beginTest("Least loaded (after imbalance):");
+		{
+			int expected[NDEVICES] = { 3, 3, 3, 3 };
+			for(i = 0; i < 3; i++) startSession(devices, 1, RRDPY_LEASTLOADED);
+			for(i = 0; i < 9; i++)
+				startSession(devices, NDEVICES, RRDPY_LEASTLOADED);
+			if(!checkSessions(broker, expected)) retval = -1;
+		}
+		endTest();
+
+		beginTest("NUMA (local node = 1):");
+		{
+			int nodes[NDEVICES] = { 0, 1, 0, 1 }, expected[NDEVICES] = { 0, 2, 0, 2 };
+			for(i = 0; i < 4; i++)
+				startSession(devices, NDEVICES, RRDPY_NUMA, nodes, 1);
+			if(!checkSessions(broker, expected)) retval = -1;
+		}
+		endTest();
+
+		beginTest("NUMA (no local devices):");
+		{
+			int nodes[NDEVICES] = { 0, 0, 0, 0 }, expected[NDEVICES] = { 1, 1, 1, 1 };
+			for(i = 0; i < 4; i++)
+				startSession(devices, NDEVICES, RRDPY_NUMA, nodes, 1);
+			if(!checkSessions(broker, expected)) retval = -1;
+		}
+		endTest();
+
+		beginTest("Sessions purged after exit:");
+		{
+			int expected[NDEVICES] = { 0, 0, 0, 0 };
+			if(!checkSessions(broker, expected)) retval = -1;
+		}
+		endTest();
+
+		beginTest("Invalid sessions ignored:");
+		{
+			int expected[NDEVICES] = { 0, 0, 0, 0 };
+			corruptRegistry();
+			if(!checkSessions(broker, expected)) retval = -1;
+		}
+		endTest();
+
+		beginTest("Lock held by another process:");
+		{
+			holdLock();
+			double start = GetTime();
+			bool timedOut = false;
+			try
+			{
+				broker.getSessions(devices[0]);
+			}
+			catch(std::exception &e)
+			{
+				timedOut = true;
+			}
+			if(!timedOut || GetTime() - start > 10.)
+			{
+				fprintf(stderr, "FAILED! (lock was not abandoned)\n");
+				retval = -1;
+			}
+			else fprintf(stderr, "Passed.\n");
+		}
+		endTest();
+	}
+	catch(std::exception &e)
+	{
+		fprintf(stderr, "%s--\n%s\n", GET_METHOD(e), e.what());
+		retval = -1;
+	}
+
+	shm_unlink(shmName);
+	return retval;
+}
@@ -45,6 +45,29 @@ static void doGLReadback(bool spoilLast, bool sync)
 }
 
 
+// When VGL_DIRTYRECT is enabled, the region of the window that the current
+// context could have rendered into is added to the window's dirty region
+// whenever the scissor state is about to change.  If the faker cannot see the
+// scissor state changes (full = true), then the whole window is added, and if
+// it cannot track the scissor state at all (untrack = true), then the whole
+// window is added in every subsequent frame as well.
+
+static void addRenderBounds(bool full = false, bool untrack = false)
+{
+	if(!fconfig.dirtyrect) return;
+
+	GLXDrawable drawable = backend::getCurrentDrawable();
+	if(!drawable) return;
+
+	faker::VirtualWin *vw;
+	if((vw = winhash.find(NULL, drawable)) != NULL)
+	{
+		if(untrack) vw->untrackScissor();
+		else vw->addRenderBounds(full);
+	}
+}
+
+
 extern "C" {
 
 // VirtualGL reads back and transports the contents of the front buffer if
@@ -157,6 +180,58 @@ void glBindFramebufferEXT(GLenum target, GLuint framebuffer)
 }
 
 
+// A display list can change the scissor state, render, and restore the
+// scissor state without the faker seeing any of it, so calling a display list
+// makes the whole window dirty when VGL_DIRTYRECT is enabled.
+
+void glCallList(GLuint list)
+{
+	if(faker::getExcludeCurrent() || !fconfig.dirtyrect)
+	{
+		_glCallList(list);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glCallList);  PRARGI(list);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true);
+	_glCallList(list);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
+void glCallLists(GLsizei n, GLenum type, const GLvoid *lists)
+{
+	if(faker::getExcludeCurrent() || !fconfig.dirtyrect)
+	{
+		_glCallLists(n, type, lists);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glCallLists);  PRARGI(n);  PRARGX(type);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true);
+	_glCallLists(n, type, lists);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
 void glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
 {
 	if(faker::getExcludeCurrent())
@@ -178,6 +253,58 @@ void glDeleteFramebuffersEXT(GLsizei n, const GLuint *framebuffers)
 }
 
 
+void glDisable(GLenum cap)
+{
+	if(faker::getExcludeCurrent() || cap != GL_SCISSOR_TEST)
+	{
+		_glDisable(cap);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glDisable);  PRARGX(cap);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds();
+	_glDisable(cap);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
+// The indexed scissor functions set per-viewport scissor state, which
+// VGL_DIRTYRECT cannot track.
+
+void glDisablei(GLenum target, GLuint index)
+{
+	if(faker::getExcludeCurrent() || target != GL_SCISSOR_TEST
+		|| !fconfig.dirtyrect)
+	{
+		_glDisablei(target, index);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glDisablei);  PRARGX(target);  PRARGI(index);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true, true);
+	_glDisablei(target, index);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
 // If the application is rendering to the front buffer and switches the draw
 // buffer before calling glFlush()/glFinish()/glXWaitGL(), we set a lazy
 // readback trigger to indicate that the front buffer needs to be read back
@@ -276,6 +403,55 @@ void glDrawBuffersATI(GLsizei n, const GLenum *bufs)
 }
 
 
+void glEnable(GLenum cap)
+{
+	if(faker::getExcludeCurrent() || cap != GL_SCISSOR_TEST)
+	{
+		_glEnable(cap);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glEnable);  PRARGX(cap);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds();
+	_glEnable(cap);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
+void glEnablei(GLenum target, GLuint index)
+{
+	if(faker::getExcludeCurrent() || target != GL_SCISSOR_TEST
+		|| !fconfig.dirtyrect)
+	{
+		_glEnablei(target, index);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glEnablei);  PRARGX(target);  PRARGI(index);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true, true);
+	_glEnablei(target, index);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
 void glFramebufferDrawBufferEXT(GLuint framebuffer, GLenum mode)
 {
 	if(faker::getExcludeCurrent())
@@ -770,6 +946,7 @@ void glPopAttrib(void)
 	{
 		before = DrawingToFront();
 		rbefore = DrawingToRight();
+		vw->addRenderBounds();
 		_glPopAttrib();
 		after = DrawingToFront();
 		rafter = DrawingToRight();
@@ -820,6 +997,105 @@ void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
 }
 
 
+void glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if(faker::getExcludeCurrent() || !fconfig.dirtyrect)
+	{
+		_glScissor(x, y, width, height);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glScissor);  PRARGI(x);  PRARGI(y);  PRARGI(width);
+	PRARGI(height);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds();
+	_glScissor(x, y, width, height);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
+void glScissorArrayv(GLuint first, GLsizei count, const GLint *v)
+{
+	if(faker::getExcludeCurrent() || !fconfig.dirtyrect)
+	{
+		_glScissorArrayv(first, count, v);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glScissorArrayv);  PRARGI(first);  PRARGI(count);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true, true);
+	_glScissorArrayv(first, count, v);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
+void glScissorIndexed(GLuint index, GLint left, GLint bottom, GLsizei width,
+	GLsizei height)
+{
+	if(faker::getExcludeCurrent() || !fconfig.dirtyrect)
+	{
+		_glScissorIndexed(index, left, bottom, width, height);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glScissorIndexed);  PRARGI(index);  PRARGI(left);
+	PRARGI(bottom);  PRARGI(width);  PRARGI(height);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true, true);
+	_glScissorIndexed(index, left, bottom, width, height);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
+void glScissorIndexedv(GLuint index, const GLint *v)
+{
+	if(faker::getExcludeCurrent() || !fconfig.dirtyrect)
+	{
+		_glScissorIndexedv(index, v);  return;
+	}
+
+	TRY();
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(glScissorIndexedv);  PRARGI(index);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	addRenderBounds(true, true);
+	_glScissorIndexedv(index, v);
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+}
+
+
 // Sometimes XNextEvent() is called from a thread other than the
 // rendering thread, so we wait until glViewport() is called and
 // take that opportunity to resize the off-screen drawable.
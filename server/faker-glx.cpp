@@ -18,6 +18,7 @@
 #include "vglutil.h"
 #define GLX_GLXEXT_PROTOTYPES
 #include "ContextHash.h"
+#include "FontHash.h"
 #include "GLXDrawableHash.h"
 #include "PixmapHash.h"
 #include "VisualHash.h"
@@ -1455,8 +1456,14 @@ void (*glXGetProcAddressARB(const GLubyte *procName))(void)
 		// OpenGL
 		CHECK_FAKED(glBindFramebuffer)
 		CHECK_FAKED(glBindFramebufferEXT)
+		CHECK_FAKED(glCallList)
+		CHECK_FAKED(glCallLists)
 		CHECK_FAKED(glDeleteFramebuffers)
 		CHECK_FAKED(glDeleteFramebuffersEXT)
+		CHECK_FAKED(glDisable)
+		CHECK_FAKED(glDisablei)
+		CHECK_FAKED(glEnable)
+		CHECK_FAKED(glEnablei)
 		CHECK_FAKED(glFinish)
 		CHECK_FAKED(glFlush)
 		CHECK_FAKED(glDrawBuffer)
@@ -1482,6 +1489,10 @@ void (*glXGetProcAddressARB(const GLubyte *procName))(void)
 		CHECK_FAKED(glPopAttrib)
 		CHECK_FAKED(glReadBuffer)
 		CHECK_FAKED(glReadPixels)
+		CHECK_FAKED(glScissor)
+		CHECK_FAKED(glScissorArrayv)
+		CHECK_FAKED(glScissorIndexed)
+		CHECK_FAKED(glScissorIndexedv)
 		CHECK_FAKED(glViewport)
 	}
 	if(!retval)
@@ -1670,6 +1681,7 @@ Bool glXMakeCurrent(Display *dpy, GLXDrawable drawable, GLXContext ctx)
 	if(backend::getCurrentContext() && curdraw
 		&& (vw = winhash.find(NULL, curdraw)) != NULL)
 	{
+		vw->addRenderBounds();
 		faker::VirtualWin *newvw;
 		if(drawable == 0 || !(newvw = winhash.find(dpy, drawable))
 			|| newvw->getGLXDrawable() != curdraw)
@@ -1791,6 +1803,7 @@ Bool glXMakeContextCurrent(Display *dpy, GLXDrawable draw, GLXDrawable read,
 	if(backend::getCurrentContext() && curdraw
 		&& (vw = winhash.find(NULL, curdraw)) != NULL)
 	{
+		vw->addRenderBounds();
 		faker::VirtualWin *newvw;
 		if(draw == 0 || !(newvw = winhash.find(dpy, draw))
 			|| newvw->getGLXDrawable() != curdraw)
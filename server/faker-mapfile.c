@@ -92,8 +92,14 @@
 		/* OpenGL */
 		glBindFramebuffer;
 		glBindFramebufferEXT;
+		glCallList;
+		glCallLists;
 		glDeleteFramebuffers;
 		glDeleteFramebuffersEXT;
+		glDisable;
+		glDisablei;
+		glEnable;
+		glEnablei;
 		glFinish;
 		glFlush;
 		glDrawBuffer;
@@ -119,6 +125,10 @@
 		glPopAttrib;
 		glReadBuffer;
 		glReadPixels;
+		glScissor;
+		glScissorArrayv;
+		glScissorIndexed;
+		glScissorIndexedv;
 		glViewport;
 
 		/* OpenCL */
@@ -150,6 +160,7 @@
 		XQueryExtension;
 		XResizeWindow;
 		XServerVendor;
+		XShmGetImage;
 		#ifdef FAKEXCB
 		XSetEventQueueOwner;
 		#endif
@@ -31,6 +31,7 @@ static void *loadOCLSymbol(const char *, bool);
 #endif
 static void *x11dllhnd = NULL;
 static void *loadX11Symbol(const char *, bool);
+static void *loadXextSymbol(const char *, bool);
 #ifdef FAKEXCB
 static void *xcbdllhnd = NULL;
 static void *loadXCBSymbol(const char *, bool);
@@ -70,6 +71,7 @@ void *loadSymbol(const char *name, bool optional)
 		vglout.print("[VGL] ERROR: Invalid argument in loadSymbol()\n");
 		safeExit(1);
 	}
+	StartupTimer timer(STARTUP_SYMBOLS);
 	if(!strncmp(name, "gl", 2))
 		return loadGLSymbol(name, optional);
 	#ifdef EGLBACKEND
@@ -85,6 +87,8 @@ void *loadSymbol(const char *name, bool optional)
 		|| !strcmp(name, "XSetEventQueueOwner"))
 		return loadXCBX11Symbol(name, optional);
 	#endif
+	else if(!strncmp(name, "XShm", 4))
+		return loadXextSymbol(name, optional);
 	else if(!strncmp(name, "X", 1))
 		return loadX11Symbol(name, optional);
 	#ifdef FAKEXCB
@@ -335,6 +339,26 @@ static void *loadX11Symbol(const char *name, bool optional)
 }
 
 
+// MIT-SHM functions live in libXext, which the faker links against, so they
+// are always loaded from the next library in the search order (VGL_X11LIB
+// does not apply to them.)
+
+static void *loadXextSymbol(const char *name, bool optional)
+{
+	dlerror();  // Clear error state
+	void *sym = dlsym(RTLD_NEXT, (char *)name);
+	char *err = dlerror();
+
+	if(!sym && (fconfig.verbose || !optional))
+	{
+		vglout.print("[VGL] %s: Could not load function \"%s\"\n",
+			optional ? "WARNING" : "ERROR", name);
+		if(err) vglout.print("[VGL]    %s\n", err);
+	}
+	return sym;
+}
+
+
 #ifdef FAKEXCB
 
 #define LOAD_XCB_SYMBOL(ID, id, libid, minrev, maxrev) \
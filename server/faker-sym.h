@@ -41,6 +41,7 @@ extern "C" {
 #endif
 #include "faker.h"
 #include <X11/XKBlib.h>
+#include <X11/extensions/XShm.h>
 #ifdef USEHELGRIND
 	#include <valgrind/helgrind.h>
 #else
@@ -564,9 +565,22 @@ VFUNCDEF2(glBindFramebuffer, GLenum, target, GLuint, framebuffer,
 VFUNCDEF2(glBindFramebufferEXT, GLenum, target, GLuint, framebuffer,
 	glBindFramebufferEXT)
 
+VFUNCDEF1(glCallList, GLuint, list, glCallList)
+
+VFUNCDEF3(glCallLists, GLsizei, n, GLenum, type, const GLvoid *, lists,
+	glCallLists)
+
 VFUNCDEF2(glDeleteFramebuffers, GLsizei, n, const GLuint *, framebuffers,
 	glDeleteFramebuffers)
 
+VFUNCDEF1(glDisable, GLenum, cap, glDisable)
+
+VFUNCDEF2(glDisablei, GLenum, target, GLuint, index, glDisablei)
+
+VFUNCDEF1(glEnable, GLenum, cap, glEnable)
+
+VFUNCDEF2(glEnablei, GLenum, target, GLuint, index, glEnablei)
+
 VFUNCDEF0(glFinish, glFinish)
 
 VFUNCDEF0(glFlush, glFlush)
@@ -625,6 +639,18 @@ VFUNCDEF1(glReadBuffer, GLenum, mode, glReadBuffer)
 VFUNCDEF7(glReadPixels, GLint, x, GLint, y, GLsizei, width, GLsizei, height,
 	GLenum, format, GLenum, type, GLvoid *, pixels, glReadPixels)
 
+VFUNCDEF4(glScissor, GLint, x, GLint, y, GLsizei, width, GLsizei, height,
+	glScissor)
+
+VFUNCDEF3(glScissorArrayv, GLuint, first, GLsizei, count, const GLint *, v,
+	glScissorArrayv)
+
+VFUNCDEF5(glScissorIndexed, GLuint, index, GLint, left, GLint, bottom,
+	GLsizei, width, GLsizei, height, glScissorIndexed)
+
+VFUNCDEF2(glScissorIndexedv, GLuint, index, const GLint *, v,
+	glScissorIndexedv)
+
 VFUNCDEF4(glViewport, GLint, x, GLint, y, GLsizei, width, GLsizei, height,
 	glViewport)
 
@@ -717,6 +743,9 @@ FUNCDEF4(int, XResizeWindow, Display *, dpy, Window, win, unsigned int, width,
 
 FUNCDEF1(char *, XServerVendor, Display *, dpy, XServerVendor)
 
+FUNCDEF6(Bool, XShmGetImage, Display *, dpy, Drawable, d, XImage *, image,
+	int, x, int, y, unsigned long, plane_mask, XShmGetImage)
+
 FUNCDEF4(int, XWindowEvent, Display *, dpy, Window, win, long, event_mask,
 	XEvent *, xe, XWindowEvent)
 
@@ -393,9 +393,11 @@ Status XGetGeometry(Display *dpy, Drawable drawable, Window *root, int *x,
 }
 
 
-// If the pixmap has been used for 3D rendering, then we have to synchronize
-// the contents of the 3D pixmap, which resides on the 3D X server, with the
-// 2D pixmap on the 2D X server before calling the "real" XGetImage() function.
+// If the pixmap has been used for 3D rendering, then we read the requested
+// region directly from the 3D pixmap, which resides on the 3D X server.  If
+// that isn't possible, then we have to synchronize the contents of the 3D
+// pixmap with the 2D pixmap on the 2D X server before calling the "real"
+// XGetImage() function.
 
 XImage *XGetImage(Display *dpy, Drawable drawable, int x, int y,
 	unsigned int width, unsigned int height, unsigned long plane_mask,
@@ -416,9 +418,13 @@ XImage *XGetImage(Display *dpy, Drawable drawable, int x, int y,
 	DISABLE_FAKER();
 
 	faker::VirtualPixmap *vpm = pmhash.find(dpy, drawable);
-	if(vpm) vpm->readback();
-
-	xi = _XGetImage(dpy, drawable, x, y, width, height, plane_mask, format);
+	if(vpm && vpm->isInit())
+		xi = vpm->getImage(x, y, width, height, plane_mask, format);
+	if(!xi)
+	{
+		if(vpm) vpm->readback();
+		xi = _XGetImage(dpy, drawable, x, y, width, height, plane_mask, format);
+	}
 
 	/////////////////////////////////////////////////////////////////////////////
 	STOPTRACE();  CLOSETRACE();
@@ -503,12 +509,14 @@ static void setupXDisplay(Display *dpy)
 	XExtData *extData;
 	bool excludeDisplay = faker::isDisplayStringExcluded(DisplayString(dpy));
 
-	// Extension code 1 stores the excluded status for a Display.
+	// Extension code 1 stores the excluded status and other attributes for a
+	// Display.
 	if(!(codes = XAddExtension(dpy))
 		|| !(extData = (XExtData *)calloc(1, sizeof(XExtData)))
-		|| !(extData->private_data = (XPointer)malloc(sizeof(bool))))
+		|| !(extData->private_data =
+			(XPointer)calloc(1, sizeof(faker::DisplayAttribs))))
 		THROW("Memory allocation error");
-	*(bool *)extData->private_data = excludeDisplay;
+	((faker::DisplayAttribs *)extData->private_data)->excluded = excludeDisplay;
 	extData->number = codes->extension;
 	XAddToExtensionList(XEHeadOfExtensionList(obj), extData);
 
@@ -675,6 +683,44 @@ char *XServerVendor(Display *dpy)
 }
 
 
+// Same as XGetImage(), but the image is read into a caller-supplied XImage
+// structure that is backed by an MIT-SHM segment.
+
+Bool XShmGetImage(Display *dpy, Drawable drawable, XImage *image, int x,
+	int y, unsigned long plane_mask)
+{
+	Bool retval = False;
+	TRY();
+
+	if(IS_EXCLUDED(dpy))
+		return _XShmGetImage(dpy, drawable, image, x, y, plane_mask);
+
+	/////////////////////////////////////////////////////////////////////////////
+	OPENTRACE(XShmGetImage);  PRARGD(dpy);  PRARGX(drawable);  PRARGX(image);
+	PRARGI(x);  PRARGI(y);  PRARGX(plane_mask);  STARTTRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	DISABLE_FAKER();
+
+	faker::VirtualPixmap *vpm = pmhash.find(dpy, drawable);
+	if(vpm && vpm->isInit() && vpm->getShmImage(image, x, y, plane_mask))
+		retval = True;
+	else
+	{
+		if(vpm) vpm->readback();
+		retval = _XShmGetImage(dpy, drawable, image, x, y, plane_mask);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////
+	STOPTRACE();  PRARGI(retval);  CLOSETRACE();
+	/////////////////////////////////////////////////////////////////////////////
+
+	CATCH();
+	ENABLE_FAKER();
+	return retval;
+}
+
+
 // The following functions are interposed so that VirtualGL can detect window
 // resizes, key presses (to pop up the VGL configuration dialog), and window
 // delete events from the window manager.
@@ -705,25 +751,35 @@ static void handleEvent(Display *dpy, XEvent *xe)
 	}
 	else if(xe && xe->type == KeyPress)
 	{
+		if(!fconfig.gui) return;
 		unsigned int state2, state = (xe->xkey.state) & (~(LockMask));
 		state2 = fconfig.guimod;
 		if(state2 & Mod1Mask)
 		{
 			state2 &= (~(Mod1Mask));  state2 |= Mod2Mask;
 		}
-		if(fconfig.gui
+		// Check the modifiers first, since they are already in the event.
+		if((state == fconfig.guimod || state == state2)
 			&& KeycodeToKeysym(dpy, xe->xkey.keycode, 0) == fconfig.guikey
-			&& (state == fconfig.guimod || state == state2)
 			&& fconfig_getshmid() != -1)
 			VGLPOPUP(dpy, fconfig_getshmid());
 	}
 	else if(xe && xe->type == ClientMessage)
 	{
 		XClientMessageEvent *cme = (XClientMessageEvent *)xe;
-		Atom protoAtom = XInternAtom(dpy, "WM_PROTOCOLS", True);
-		Atom deleteAtom = XInternAtom(dpy, "WM_DELETE_WINDOW", True);
-		if(protoAtom && deleteAtom && cme->message_type == protoAtom
-			&& cme->data.l[0] == (long)deleteAtom
+		faker::DisplayAttribs *attribs = faker::getDisplayAttribs(dpy);
+		// The atoms are never created.  Once they both exist, they are cached for
+		// the lifetime of the Display, so subsequent ClientMessage events do not
+		// require a round trip to the 2D X server.  Until then, the lookup is
+		// retried with each ClientMessage event.
+		if(!attribs->protoAtom || !attribs->deleteAtom)
+		{
+			attribs->protoAtom = XInternAtom(dpy, "WM_PROTOCOLS", True);
+			attribs->deleteAtom = XInternAtom(dpy, "WM_DELETE_WINDOW", True);
+		}
+		if(attribs->protoAtom && attribs->deleteAtom
+			&& cme->message_type == attribs->protoAtom
+			&& cme->data.l[0] == (long)attribs->deleteAtom
 			&& (vw = winhash.find(dpy, cme->window)) != NULL)
 			vw->wmDeleted();
 	}
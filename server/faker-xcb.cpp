@@ -437,6 +437,7 @@ static void handleXCBEvent(xcb_connection_t *conn, xcb_generic_event_t *ev)
 
 			if(!dpy || faker::isDisplayExcluded(dpy)) break;
 
+			if(!winhash.mayContain(cne->window)) break;
 			vw = winhash.find(dpy, cne->window);
 			if(!vw) break;
 
@@ -456,27 +457,33 @@ static void handleXCBEvent(xcb_connection_t *conn, xcb_generic_event_t *ev)
 		case XCB_KEY_PRESS:
 		{
 			xcb_key_press_event_t *kpe = (xcb_key_press_event_t *)ev;
-			Display *dpy = xcbconnhash.getX11Display(conn);
-
-			if(!dpy || !fconfig.gui || faker::isDisplayExcluded(dpy)) break;
 
-			xcb_key_symbols_t *keysyms = _xcb_key_symbols_alloc(conn);
-			if(!keysyms) break;
+			if(!fconfig.gui) break;
 
-			xcb_keysym_t keysym =
-				_xcb_key_symbols_get_keysym(keysyms, kpe->detail, 0);
 			unsigned int state2, state = (kpe->state & (~(XCB_MOD_MASK_LOCK)));
 			state2 = fconfig.guimod;
 			if(state2 & Mod1Mask)
 			{
 				state2 &= (~(Mod1Mask));  state2 |= Mod2Mask;
 			}
-			if(keysym == fconfig.guikey
-				&& (state == fconfig.guimod || state == state2)
+			if(state != fconfig.guimod && state != state2) break;
+
+			Display *dpy = xcbconnhash.getX11Display(conn);
+
+			if(!dpy || faker::isDisplayExcluded(dpy)) break;
+
+			if(xcbconnhash.getKeySym(conn, kpe->detail) == fconfig.guikey
 				&& fconfig_getshmid() != -1)
 				VGLPOPUP(dpy, fconfig_getshmid());
 
-			_xcb_key_symbols_free(keysyms);
+			break;
+		}
+		case XCB_MAPPING_NOTIFY:
+		{
+			xcb_mapping_notify_event_t *mne = (xcb_mapping_notify_event_t *)ev;
+
+			if(mne->request == XCB_MAPPING_KEYBOARD)
+				xcbconnhash.invalidateKeySyms(conn);
 
 			break;
 		}
@@ -491,6 +498,7 @@ static void handleXCBEvent(xcb_connection_t *conn, xcb_generic_event_t *ev)
 
 			if(!dpy || !protoAtom || !deleteAtom
 				|| cme->type != protoAtom || cme->data.data32[0] != deleteAtom
+				|| !winhash.mayContain(cme->window)
 				|| faker::isDisplayExcluded(dpy))
 				break;
 
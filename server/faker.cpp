@@ -14,14 +14,19 @@
 
 #include <unistd.h>
 #include "Mutex.h"
+#include "BlitPool.h"
+#include "FrameCapture.h"
 #include "ContextHash.h"
 #ifdef EGLBACKEND
 #include "ContextHashEGL.h"
 #include "PbufferHashEGL.h"
 #endif
+#include "DeviceBroker.h"
+#include "FontHash.h"
 #include "GLXDrawableHash.h"
 #include "GlobalCriticalSection.h"
 #include "PixmapHash.h"
+#include "VGLTransHash.h"
 #include "VisualHash.h"
 #include "WindowHash.h"
 #include "fakerconfig.h"
@@ -36,6 +41,13 @@ namespace faker {
 Display *dpy3D = NULL;
 bool deadYet = false;
 char *glExtensions = NULL;
+bool startupProfile = false;
+// Static initialization is used rather than a CriticalSection instance, for
+// the same reasons described in GlobalCriticalSection.h.
+static pthread_mutex_t startupMutex = PTHREAD_MUTEX_INITIALIZER;
+static double initTime = 0., startupTime[STARTUP_NPHASES],
+	firstFrameTime = 0.;
+static DeviceBroker *broker = NULL;
 #ifdef EGLBACKEND
 EGLint eglMajor = 0, eglMinor = 0;
 #endif
@@ -56,6 +68,11 @@ static void cleanup(void)
 	if(ContextHash::isAlloc()) ctxhash.kill();
 	if(GLXDrawableHash::isAlloc()) glxdhash.kill();
 	if(WindowHash::isAlloc()) winhash.kill();
+	if(server::BlitPool::isAlloc()) server::BlitPool::getInstance()->kill();
+	if(VGLTransHash::isAlloc()) vgltranshash.kill();
+	if(server::FrameCapture::isAlloc())
+		server::FrameCapture::getInstance()->kill();
+	if(FontHash::isAlloc()) fonthash.kill();
 	#ifdef EGLBACKEND
 	if(backend::ContextHashEGL::isAlloc()) ctxhashegl.kill();
 	if(backend::PbufferHashEGL::isAlloc()) pbhashegl.kill();
@@ -83,12 +100,53 @@ void safeExit(int retcode)
 }
 
 
+void addStartupTime(StartupPhase phase, double elapsed)
+{
+	if(phase < 0 || phase >= STARTUP_NPHASES) return;
+	pthread_mutex_lock(&startupMutex);
+	startupTime[phase] += elapsed;
+	pthread_mutex_unlock(&startupMutex);
+}
+
+
+void startupFirstFrame(void)
+{
+	if(!startupProfile || firstFrameTime > 0.) return;
+	pthread_mutex_lock(&startupMutex);
+	if(firstFrameTime == 0.) firstFrameTime = GetTime() - initTime;
+	pthread_mutex_unlock(&startupMutex);
+}
+
+
+static void printStartupProfile(void)
+{
+	static const char *phaseNames[STARTUP_NPHASES] =
+	{
+		"Initialization", "Symbol loading", "3D X server/EGL device",
+		"Visual tables", "Transport connection"
+	};
+
+	if(!startupProfile || initTime == 0.) return;
+	startupProfile = false;
+	vglout.print("[VGL] Startup profile (ms):\n");
+	for(int i = 0; i < STARTUP_NPHASES; i++)
+		vglout.print("[VGL]    %-24s%10.3f\n", phaseNames[i],
+			startupTime[i] * 1000.);
+	if(firstFrameTime > 0.)
+		vglout.print("[VGL]    %-24s%10.3f\n", "Time to first frame",
+			firstFrameTime * 1000.);
+	else vglout.print("[VGL]    %-24s%10s\n", "Time to first frame", "N/A");
+}
+
+
 class GlobalCleanup
 {
 	public:
 
 		~GlobalCleanup()
 		{
+			printStartupProfile();
+			delete broker;  broker = NULL;
 			faker::GlobalCriticalSection *gcs =
 				faker::GlobalCriticalSection::getInstance(false);
 			if(gcs) gcs->lock(false);
@@ -149,6 +207,11 @@ void init(void)
 	if(init) return;
 	init = 1;
 
+	initTime = GetTime();
+	char *env = getenv("VGL_PROFILE");
+	if(env && !strncmp(env, "1", 1)) startupProfile = true;
+	StartupTimer timer(STARTUP_INIT);
+
 	fconfig_reloadenv();
 	if(strlen(fconfig.log) > 0) vglout.logTo(fconfig.log);
 
@@ -162,6 +225,59 @@ void init(void)
 		fgetc(stdin);
 	}
 	if(fconfig.trapx11) XSetErrorHandler(xhandler);
+	// The SIGUSR2 handler must be installed before the first frame is drawn.
+	if(strlen(fconfig.capture) > 0) server::FrameCapture::getInstance();
+}
+
+
+// If VGL_DISPLAY contains a comma-separated list of 3D X servers or EGL
+// devices, then select one of them according to VGL_DISPLAYPOLICY and replace
+// the list with the selected device.
+
+#define MAXDEVICES  64
+
+static void selectDevice(void)
+{
+	char *list, *device, *saveptr = NULL, *devices[MAXDEVICES];
+	int nodes[MAXDEVICES], numDevices = 0, selected = 0;
+	static const char *policyName[RR_DPYPOLICYOPT] =
+	{
+		"least loaded", "round robin", "NUMA"
+	};
+
+	if(!strchr(fconfig.localdpystring, ',')) return;
+	if((list = strdup(fconfig.localdpystring)) == NULL)
+		THROW("Memory allocation error");
+	for(device = strtok_r(list, ", \t", &saveptr);
+		device && numDevices < MAXDEVICES;
+		device = strtok_r(NULL, ", \t", &saveptr))
+	{
+		devices[numDevices] = device;
+		nodes[numDevices++] = DeviceBroker::getDeviceNode(device);
+	}
+	if(numDevices < 1)
+	{
+		free(list);  THROW("Invalid 3D X server/EGL device list");
+	}
+
+	try
+	{
+		if(!broker) broker = new DeviceBroker();
+		selected = broker->select(devices, numDevices, fconfig.dpypolicy, nodes,
+			DeviceBroker::getLocalNode());
+		if(fconfig.verbose)
+			vglout.println("[VGL] Selected 3D X server/EGL device %s (%s policy, %d session(s) on this device)",
+				devices[selected], policyName[fconfig.dpypolicy],
+				broker->getSessions(devices[selected]));
+	}
+	catch(std::exception &e)
+	{
+		vglout.println("[VGL] WARNING: Could not access the 3D X server/EGL device registry:");
+		vglout.println("[VGL]    %s", e.what());
+		vglout.println("[VGL]    Using %s", devices[selected]);
+	}
+	strncpy(fconfig.localdpystring, devices[selected], MAXSTR - 1);
+	free(list);
 }
 
 
@@ -174,6 +290,10 @@ Display *init3D(void)
 		GlobalCriticalSection::SafeLock l(globalMutex);
 		if(!dpy3D)
 		{
+			StartupTimer timer(STARTUP_DPY3D);
+
+			selectDevice();
+
 			#ifdef EGLBACKEND
 			if(fconfig.egl)
 			{
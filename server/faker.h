@@ -38,6 +38,39 @@ namespace faker
 	extern Display *init3D(void);
 	extern void safeExit(int);
 
+	// Startup profiling (enabled with VGL_PROFILE=1.)  The time spent in each
+	// phase is reported when the application exits.  Phases can nest (for
+	// instance, symbols may be loaded while opening the 3D X server), in which
+	// case the inner phase's time is also included in the outer phase's time.
+	enum StartupPhase
+	{
+		STARTUP_INIT, STARTUP_SYMBOLS, STARTUP_DPY3D, STARTUP_VISUALS,
+		STARTUP_TRANSPORT, STARTUP_NPHASES
+	};
+	extern bool startupProfile;
+	extern void addStartupTime(StartupPhase phase, double elapsed);
+	extern void startupFirstFrame(void);
+
+	class StartupTimer
+	{
+		public:
+
+			StartupTimer(StartupPhase phase_) : phase(phase_), start(0.)
+			{
+				if(startupProfile) start = GetTime();
+			}
+
+			~StartupTimer(void)
+			{
+				if(startupProfile && start > 0.)
+					addStartupTime(phase, GetTime() - start);
+			}
+
+		private:
+
+			StartupPhase phase;  double start;
+	};
+
 	extern long getTraceLevel(void);
 	extern void setTraceLevel(long level);
 	extern long getFakerLevel(void);
@@ -60,14 +93,24 @@ namespace faker
 
 	extern bool isDisplayStringExcluded(char *name);
 
-	INLINE bool isDisplayExcluded(Display *dpy)
+	// Attributes that are stored in extension code 1 for a Display
+	typedef struct
+	{
+		bool excluded;
+		// Window manager atoms, which are looked up when a ClientMessage event is
+		// received and cached once they both exist, so subsequent events do not
+		// require a round trip to the 2D X server
+		Atom protoAtom, deleteAtom;
+	} DisplayAttribs;
+
+	INLINE DisplayAttribs *getDisplayAttribs(Display *dpy)
 	{
 		XEDataObject obj = { dpy };
 		XExtData *extData;
 
-		if(!dpy) return false;
 		// The 3D X server may have its own extensions that conflict with ours.
-		if(!fconfig.egl && dpy == dpy3D) return true;
+		if(!fconfig.egl && dpy == dpy3D)
+			THROW("faker::getDisplayAttribs() called with 3D X server handle (this should never happen)");
 		int minExtensionNumber =
 			XFindOnExtensionList(XEHeadOfExtensionList(obj), 0) ? 0 : 1;
 		extData = XFindOnExtensionList(XEHeadOfExtensionList(obj),
@@ -75,7 +118,16 @@ namespace faker
 		ERRIFNOT(extData);
 		ERRIFNOT(extData->private_data);
 
-		return *(bool *)extData->private_data;
+		return (DisplayAttribs *)extData->private_data;
+	}
+
+	INLINE bool isDisplayExcluded(Display *dpy)
+	{
+		if(!dpy) return false;
+		// The 3D X server may have its own extensions that conflict with ours.
+		if(!fconfig.egl && dpy == dpy3D) return true;
+
+		return getDisplayAttribs(dpy)->excluded;
 	}
 
 	extern "C" int deleteCS(XExtData *extData);
@@ -176,8 +176,11 @@ static void fconfig_init(void)
 	fconfig.guikey = XK_F9;
 	fconfig.guimod = ShiftMask | ControlMask;
 	fconfig.interframe = 1;
+	fconfig.jpegopt = -1;
 	strncpy(fconfig.localdpystring, ":0", MAXSTR);
-	fconfig.np = 1;
+	fconfig.nativergb = 1;
+	fconfig.np = 0;
+	fconfig.pipeline = 1;
 	fconfig.port = -1;
 	fconfig.probeglx = 1;
 	fconfig.qual = DEFQUAL;
@@ -280,6 +283,18 @@ void fconfig_reloadenv(void)
 	FETCHENV_BOOL("VGL_ALLOWINDIRECT", allowindirect);
 	FETCHENV_BOOL("VGL_AMDGPUHACK", amdgpuHack);
 	FETCHENV_BOOL("VGL_AUTOTEST", autotest);
+	FETCHENV_STR("VGL_CAPTURE", capture);
+	if((env = getenv("VGL_CAPTUREFORMAT")) != NULL && strlen(env) > 0)
+	{
+		int captureformat = -1;
+		if(!strnicmp(env, "P", 1)) captureformat = RRCAPTURE_PPM;
+		else if(!strnicmp(env, "B", 1)) captureformat = RRCAPTURE_BMP;
+		else if(!strnicmp(env, "Y", 1)) captureformat = RRCAPTURE_Y4M;
+		if(captureformat >= 0
+			&& (!fconfig_envset || fconfig_env.captureformat != captureformat))
+			fconfig.captureformat = fconfig_env.captureformat = captureformat;
+	}
+	FETCHENV_INT("VGL_CAPTUREINTERVAL", captureinterval, 0, 1000000);
 	FETCHENV_STR("VGL_CLIENT", client);
 	if((env = getenv("VGL_SUBSAMP")) != NULL && strlen(env) > 0)
 	{
@@ -335,6 +350,17 @@ void fconfig_reloadenv(void)
 		if((env[0] == '/' || !strnicmp(env, "EGL", 3)))
 			fconfig.egl = true;
 	}
+	if((env = getenv("VGL_DISPLAYPOLICY")) != NULL && strlen(env) > 0)
+	{
+		int dpypolicy = -1;
+		if(!strnicmp(env, "L", 1)) dpypolicy = RRDPY_LEASTLOADED;
+		else if(!strnicmp(env, "R", 1)) dpypolicy = RRDPY_ROUNDROBIN;
+		else if(!strnicmp(env, "N", 1)) dpypolicy = RRDPY_NUMA;
+		if(dpypolicy >= 0
+			&& (!fconfig_envset || fconfig_env.dpypolicy != dpypolicy))
+			fconfig.dpypolicy = fconfig_env.dpypolicy = dpypolicy;
+	}
+	FETCHENV_BOOL("VGL_DIRTYRECT", dirtyrect);
 	FETCHENV_BOOL("VGL_DLSYM", dlsymloader);
 	#ifdef EGLBACKEND
 	FETCHENV_STR("VGL_EGLLIB", egllib);
@@ -343,6 +369,7 @@ void fconfig_reloadenv(void)
 	#ifdef FAKEXCB
 	FETCHENV_BOOL("VGL_FAKEXCB", fakeXCB);
 	#endif
+	FETCHENV_STR("VGL_FONTCACHE", fontcache);
 	FETCHENV_BOOL("VGL_FORCEALPHA", forcealpha);
 	FETCHENV_DBL("VGL_FPS", fps, 0.0, 1000000.0);
 	if((env = getenv("VGL_GAMMA")) != NULL && strlen(env) > 0)
@@ -407,12 +434,31 @@ void fconfig_reloadenv(void)
 		}
 	}
 	FETCHENV_BOOL("VGL_INTERFRAME", interframe);
+	if((env = getenv("VGL_JPEGOPT")) != NULL && strlen(env) > 0)
+	{
+		int jpegopt = -2;
+		if(!strnicmp(env, "AU", 2)) jpegopt = -1;
+		else if(!strnicmp(env, "F", 1)) jpegopt = RRJPEG_FASTDCT;
+		else if(!strnicmp(env, "AC", 2)) jpegopt = RRJPEG_ACCURATEDCT;
+		else if(!strnicmp(env, "O", 1)) jpegopt = RRJPEG_OPTIMIZE;
+		else if(!strnicmp(env, "P", 1)) jpegopt = RRJPEG_PROGRESSIVE;
+		else
+		{
+			char *t = NULL;  int itemp = strtol(env, &t, 10);
+			if(t && t != env && itemp >= -1 && itemp < RR_JPEGOPT)
+				jpegopt = itemp;
+		}
+		if(jpegopt >= -1 && (!fconfig_envset || fconfig_env.jpegopt != jpegopt))
+			fconfig.jpegopt = fconfig_env.jpegopt = jpegopt;
+	}
 	FETCHENV_STR("VGL_LOG", log);
 	FETCHENV_BOOL("VGL_LOGO", logo);
-	FETCHENV_INT("VGL_NPROCS", np, 1, min(NumProcs(), MAXPROCS));
+	FETCHENV_BOOL("VGL_NATIVERGB", nativergb);
+	FETCHENV_INT("VGL_NPROCS", np, 0, min(NumProcs(), MAXPROCS));
 	#ifdef FAKEOPENCL
 	FETCHENV_STR("VGL_OCLLIB", ocllib);
 	#endif
+	FETCHENV_INT("VGL_PIPELINE", pipeline, 1, MAXPIPELINE);
 	FETCHENV_INT("VGL_PORT", port, 0, 65535);
 	FETCHENV_BOOL("VGL_PROBEGLX", probeglx);
 	FETCHENV_INT("VGL_QUAL", qual, 1, 100);
@@ -463,6 +509,7 @@ void fconfig_reloadenv(void)
 	FETCHENV_BOOL("VGL_TRACE", trace);
 	FETCHENV_INT("VGL_TRANSPIXEL", transpixel, 0, 255);
 	FETCHENV_BOOL("VGL_TRAPX11", trapx11);
+	FETCHENV_BOOL("VGL_UDP", udp);
 	FETCHENV_STR("VGL_XVENDOR", vendor);
 	FETCHENV_BOOL("VGL_VERBOSE", verbose);
 	FETCHENV_BOOL("VGL_WM", wm);
@@ -529,9 +576,23 @@ void fconfig_setdefaultsfromdpy(Display *dpy)
 			if(prop) XFree(prop);
 		}
 	}
+}
+
 
+// Determine whether the X Video transport can be used with the specified X
+// display.  This requires many round trips to the X server, and the result is
+// only used by the VirtualGL Configuration dialog, so it is only done when the
+// dialog is about to be displayed.
+
+void fconfig_probexv(Display *dpy)
+{
 	#ifdef USEXV
 
+	static bool probed = false;
+	CriticalSection::SafeLock l(fcmutex);
+	if(probed) return;
+	probed = true;
+
 	int k, port, nformats, dummy1, dummy2, dummy3;
 	unsigned int i, j, nadaptors = 0;
 	XvAdaptorInfo *ai = NULL;
@@ -600,11 +661,16 @@ void fconfig_print(FakerConfig &fc)
 {
 	PRCONF_INT(allowindirect);
 	PRCONF_INT(amdgpuHack);
+	PRCONF_STR(capture);
+	PRCONF_INT(captureformat);
+	PRCONF_INT(captureinterval);
 	PRCONF_STR(client);
 	PRCONF_INT(compress);
 	PRCONF_STR(config);
 	PRCONF_STR(defaultfbconfig);
+	PRCONF_INT(dirtyrect);
 	PRCONF_INT(dlsymloader);
+	PRCONF_INT(dpypolicy);
 	#ifdef EGLBACKEND
 	PRCONF_INT(egl);
 	PRCONF_STR(egllib);
@@ -612,6 +678,7 @@ void fconfig_print(FakerConfig &fc)
 	PRCONF_STR(excludeddpys);
 	PRCONF_DBL(fps);
 	PRCONF_DBL(flushdelay);
+	PRCONF_STR(fontcache);
 	PRCONF_INT(forcealpha);
 	PRCONF_DBL(gamma);
 	PRCONF_INT(glflushtrigger);
@@ -622,13 +689,16 @@ void fconfig_print(FakerConfig &fc)
 	PRCONF_STR(guikeyseq);
 	PRCONF_INT(guimod);
 	PRCONF_INT(interframe);
+	PRCONF_INT(jpegopt);
 	PRCONF_STR(localdpystring);
 	PRCONF_STR(log);
 	PRCONF_INT(logo);
+	PRCONF_INT(nativergb);
 	PRCONF_INT(np);
 	#ifdef FAKEOPENCL
 	PRCONF_STR(ocllib);
 	#endif
+	PRCONF_INT(pipeline);
 	PRCONF_INT(port);
 	PRCONF_INT(qual);
 	PRCONF_INT(readback);
@@ -646,6 +716,7 @@ void fconfig_print(FakerConfig &fc)
 	PRCONF_INT(transvalid[RRTRANS_VGL]);
 	PRCONF_INT(transvalid[RRTRANS_XV]);
 	PRCONF_INT(trapx11);
+	PRCONF_INT(udp);
 	PRCONF_STR(vendor);
 	PRCONF_INT(verbose);
 	PRCONF_INT(wm);
@@ -191,6 +191,32 @@ unsigned int checkBufferColor(void)
 }
 
 
+// Verify that all pixels in an XImage are the specified color.  This only
+// works with 8-bit-per-component images, so images with other pixel formats
+// are not checked.
+
+void checkImageColor(XImage *xi, unsigned int color)
+{
+	if(!xi) THROWNL("Could not obtain image");
+	if(xi->red_mask != 0xff0000 || xi->green_mask != 0xff00
+		|| xi->blue_mask != 0xff)
+		return;
+
+	for(int j = 0; j < xi->height; j++)
+	{
+		for(int i = 0; i < xi->width; i++)
+		{
+			unsigned long pixel = XGetPixel(xi, i, j);
+			unsigned int imageColor = ((pixel >> 16) & 0xff)
+				| (pixel & 0xff00) | ((pixel & 0xff) << 16);
+			if(imageColor != color)
+				PRERROR4("Pixel (%d, %d) is 0x%.6x, should be 0x%.6x", i, j,
+					imageColor, color);
+		}
+	}
+}
+
+
 void checkWindowColor(Display *dpy, Window win, unsigned int color,
 	bool right = false)
 {
@@ -2232,13 +2258,40 @@ int offScreenTest(bool dbPixmap, bool doSelectEvent)
 			glDrawBuffer(GL_BACK);  glReadBuffer(GL_BACK);
 			XImage *xi = XGetImage(dpy, pm0, 0, 0, dpyw / 2, dpyh / 2, AllPlanes,
 				ZPixmap);
-			if(xi) XDestroyImage(xi);
+			try
+			{
+				checkImageColor(xi, clr.bits(dbPixmap ? -2 : -1));
+			}
+			catch(...)
+			{
+				if(xi) XDestroyImage(xi);
+				throw;
+			}
+			XDestroyImage(xi);
 			checkReadbackState(expectedBuf, dpy, glxpm0, glxpm0, ctx);
 			temp = -1;  glGetIntegerv(GL_DRAW_BUFFER, &temp);
 			if(temp != (int)expectedBuf) THROWNL("Draw buffer changed");
 			checkFrame(dpy, pm0, 1, lastFrame);
 			checkWindowColor(dpy, pm0, clr.bits(dbPixmap ? -2 : -1), false);
 
+			// XGetImage() with a subregion of the pixmap should read back only that
+			// region.
+			xi = XGetImage(dpy, pm0, dpyw / 8, dpyh / 8, dpyw / 4, dpyh / 4,
+				AllPlanes, ZPixmap);
+			try
+			{
+				if(xi && (xi->width != dpyw / 4 || xi->height != dpyh / 4))
+					THROWNL("XGetImage() returned an image of the wrong size");
+				checkImageColor(xi, clr.bits(dbPixmap ? -2 : -1));
+			}
+			catch(...)
+			{
+				if(xi) XDestroyImage(xi);
+				throw;
+			}
+			XDestroyImage(xi);
+			checkFrame(dpy, pm0, 1, lastFrame);
+
 			printf("SUCCESS\n");
 		}
 		catch(std::exception &e)
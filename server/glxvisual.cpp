@@ -225,6 +225,7 @@ static bool buildVisAttribTable(Display *dpy, int screen)
 		extData = XFindOnExtensionList(XEHeadOfExtensionList(obj),
 			minExtensionNumber + 2);
 		if(extData && extData->private_data) return true;
+		faker::StartupTimer timer(faker::STARTUP_VISUALS);
 
 		if(fconfig.probeglx
 			&& _XQueryExtension(dpy, "GLX", &majorOpcode, &firstEvent, &firstError)
@@ -447,6 +448,7 @@ static void buildCfgAttribTable(Display *dpy, int screen)
 		extData = XFindOnExtensionList(XEHeadOfExtensionList(obj),
 			minExtensionNumber + 3);
 		if(extData && extData->private_data) return;
+		faker::StartupTimer timer(faker::STARTUP_VISUALS);
 
 		#ifdef EGLBACKEND
 		if(fconfig.egl)
@@ -0,0 +1,191 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// This program measures how well lookups in the faker hash tables scale with
+// the number of threads performing them, using both the read/write lock in
+// faker::Hash and a single mutex (which is how the hash tables used to work.)
+// A writer thread continuously adds and removes an entry while the lookups
+// are running, to verify that writers are not starved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vglutil.h"
+#include "Thread.h"
+#include "Hash.h"
+
+using namespace util;
+
+
+#define BENCHTIME  1.0
+#define NENTRIES  16
+#define MAXTHREADS  32
+
+#define HASH  faker::Hash<long, long, long>
+
+class TestHash : public HASH
+{
+	public:
+
+		TestHash(bool useMutex_) : useMutex(useMutex_) {}
+		~TestHash(void) { HASH::kill(); }
+
+		void add(long key1, long key2, long value)
+		{
+			HASH::add(key1, key2, value);
+		}
+
+		long find(long key1, long key2)
+		{
+			if(useMutex)
+			{
+				CriticalSection::SafeLock l(mutex);
+				return HASH::find(key1, key2);
+			}
+			return HASH::find(key1, key2);
+		}
+
+		void remove(long key1, long key2)
+		{
+			HASH::remove(key1, key2);
+		}
+
+	private:
+
+		void detach(HashEntry *entry) {}
+
+		bool compare(long key1, long key2, HashEntry *entry) { return false; }
+
+		bool useMutex;
+};
+
+#undef HASH
+
+
+static volatile bool deadYet = false;
+
+
+class Reader : public Runnable
+{
+	public:
+
+		Reader(TestHash &hash_, int myRank_) : hash(hash_), myRank(myRank_),
+			lookups(0) {}
+
+		void run(void)
+		{
+			long i = myRank;
+
+			while(!deadYet)
+			{
+				long key = (i++ % NENTRIES) + 1;
+				if(hash.find(key, key) != key * 2)
+					THROW("Lookup returned the wrong value");
+				lookups++;
+			}
+		}
+
+		double getLookups(void) { return lookups; }
+
+	private:
+
+		TestHash &hash;
+		int myRank;
+		double lookups;
+};
+
+
+class Writer : public Runnable
+{
+	public:
+
+		Writer(TestHash &hash_) : hash(hash_), writes(0) {}
+
+		void run(void)
+		{
+			while(!deadYet)
+			{
+				hash.add(NENTRIES + 1, NENTRIES + 1, 1);
+				hash.remove(NENTRIES + 1, NENTRIES + 1);
+				writes++;
+				usleep(100);
+			}
+		}
+
+		double getWrites(void) { return writes; }
+
+	private:
+
+		TestHash &hash;
+		double writes;
+};
+
+
+static void doTest(bool useMutex, int nThreads)
+{
+	TestHash hash(useMutex);
+	Reader *reader[MAXTHREADS];  Thread *thread[MAXTHREADS];
+	Writer writer(hash);  Thread writerThread(&writer);
+	double lookups = 0., elapsed;
+	int i;
+
+	for(i = 1; i <= NENTRIES; i++) hash.add(i, i, i * 2);
+
+	deadYet = false;
+	double start = GetTime();
+	for(i = 0; i < nThreads; i++)
+	{
+		reader[i] = new Reader(hash, i);
+		thread[i] = new Thread(reader[i]);
+		thread[i]->start();
+	}
+	writerThread.start();
+	usleep((long)(BENCHTIME * 1000000.));
+	deadYet = true;
+	for(i = 0; i < nThreads; i++) thread[i]->stop();
+	writerThread.stop();
+	elapsed = GetTime() - start;
+
+	for(i = 0; i < nThreads; i++)
+	{
+		thread[i]->checkError();
+		lookups += reader[i]->getLookups();
+		delete thread[i];  delete reader[i];
+	}
+	writerThread.checkError();
+
+	printf("%-8s %3d thread(s): %10.3f Mlookups/sec  %8.0f writes/sec\n",
+		useMutex ? "Mutex" : "RWLock", nThreads,
+		lookups / elapsed / 1000000., writer.getWrites() / elapsed);
+}
+
+
+int main(void)
+{
+	try
+	{
+		printf("Number of CPU cores in this system:  %d\n\n", NumProcs());
+		for(int useMutex = 1; useMutex >= 0; useMutex--)
+		{
+			for(int nThreads = 1; nThreads <= MAXTHREADS; nThreads *= 2)
+				doTest(useMutex != 0, nThreads);
+			printf("\n");
+		}
+	}
+	catch(std::exception &e)
+	{
+		printf("Error in %s:\n%s\n", GET_METHOD(e), e.what());
+		return -1;
+	}
+
+	return 0;
+}
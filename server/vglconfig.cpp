@@ -459,6 +459,7 @@ int main(int argc, char **argv)
 				THROW("Could not allocate FakerConfig");
 			fl_open_display();
 			fconfig_setdefaultsfromdpy(fl_display);
+			fconfig_probexv(fl_display);
 			fconfig_print(fconfig);
 		}
 		else
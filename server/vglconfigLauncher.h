@@ -43,6 +43,7 @@ namespace faker
 				if(!dpy_ || shmid_ == -1) THROW("Invalid argument");
 				util::CriticalSection::SafeLock l(popupMutex);
 				if(thread) return;
+				fconfig_probexv(dpy_);
 				dpy = dpy_;  shmid = shmid_;
 				thread = new util::Thread(this);
 				thread->start();
@@ -49,12 +49,16 @@ void usage(char **argv)
 	fprintf(stderr, "                comparison tile (default: %d x %d pixels)\n",
 		fconfig.tilesize, fconfig.tilesize);
 	fprintf(stderr, "-rgb = Use RGB (uncompressed) encoding (default is JPEG)\n");
+	fprintf(stderr, "-udp = Use the UDP mode of the VGL Transport (set VGL_UDPLOSS and/or\n");
+	fprintf(stderr, "       VGL_UDPLATENCY to simulate packet loss and/or latency)\n");
 	#ifdef USESSL
 	fprintf(stderr, "-ssl = Use SSL tunnel (default: %s)\n",
 		fconfig.ssl ? "On" : "Off");
 	#endif
-	fprintf(stderr, "-np <n> = Number of threads to use for compression (default: %d)\n\n",
-		fconfig.np);
+	fprintf(stderr, "-np <n> = Number of threads to use for compression (0 = adjust the number of\n");
+	fprintf(stderr, "          threads automatically) (default: %d)\n", fconfig.np);
+	fprintf(stderr, "-pipeline <d> = Maximum number of frames that can be compressed but not\n");
+	fprintf(stderr, "                yet sent (default: %d)\n\n", fconfig.pipeline);
 	exit(1);
 }
 
@@ -63,7 +67,7 @@ int main(int argc, char **argv)
 {
 	Timer timer;  double elapsed;
 	unsigned char *buf = NULL, *buf2 = NULL, *buf3 = NULL;
-	Display *dpy = NULL;  Window win = 0;
+	Display *dpy = NULL;  Window win = 0, win2 = 0;
 	int i, retval = 0;  int bgr = LittleEndian();
 
 	try
@@ -108,8 +112,13 @@ int main(int argc, char **argv)
 			{
 				fconfig.np = atoi(argv[++i]);
 			}
+			else if(!stricmp(argv[i], "-pipeline") && i < argc - 1)
+			{
+				fconfig.pipeline = atoi(argv[++i]);
+			}
 			else if(!stricmp(argv[i], "-rgb"))
 				fconfig_setcompress(fconfig, RRCOMP_RGB);
+			else if(!stricmp(argv[i], "-udp")) fconfig.udp = 1;
 			else usage(argv);
 		}
 		if(fconfig.compress == RRCOMP_RGB) bgr = 0;
@@ -137,6 +146,12 @@ int main(int argc, char **argv)
 				THROW("Could not create window");
 			printf("Creating window %lu\n", win);
 			ERRIFNOT(XMapRaised(dpy, win));
+			if((win2 = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, w, h,
+				0, WhitePixel(dpy, DefaultScreen(dpy)),
+				BlackPixel(dpy, DefaultScreen(dpy)))) == 0)
+				THROW("Could not create window");
+			printf("Creating window %lu\n", win2);
+			ERRIFNOT(XMapRaised(dpy, win2));
 			XSync(dpy, False);
 			if(strlen(fconfig.client) == 0)
 				strncpy(fconfig.client, DisplayString(dpy), MAXSTR - 1);
@@ -159,7 +174,8 @@ int main(int argc, char **argv)
 		do
 		{
 			vglconn.synchronize();
-			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false));
+			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false,
+				win));
 			if(fill) memcpy(f->bits, buf, w * h * d);
 			else memcpy(f->bits, buf2, w * h * d);
 			f->hdr.qual = fconfig.qual;  f->hdr.subsamp = fconfig.subsamp;
@@ -177,7 +193,8 @@ int main(int argc, char **argv)
 		fill = 0, frames = 0;  int clientframes = 0;  timer.start();
 		do
 		{
-			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false));
+			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false,
+				win));
 			if(fill) memcpy(f->bits, buf, w * h * d);
 			else memcpy(f->bits, buf2, w * h * d);
 			f->hdr.qual = fconfig.qual;  f->hdr.subsamp = fconfig.subsamp;
@@ -192,13 +209,38 @@ int main(int argc, char **argv)
 		printf("%f Megapixels/sec (client)\n",
 			(double)w * (double)h * (double)clientframes / 1000000. / elapsed);
 
+		printf("\nTesting two-window send (spoiling) ...\n");
+
+		fill = 0, frames = 0;  timer.start();
+		do
+		{
+			// Both windows share the connection, but neither window's frames
+			// should spoil the other's.
+			for(int j = 0; j < 2; j++)
+			{
+				ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false,
+					j ? win2 : win));
+				if(fill) memcpy(f->bits, buf, w * h * d);
+				else memcpy(f->bits, buf2, w * h * d);
+				f->hdr.qual = fconfig.qual;  f->hdr.subsamp = fconfig.subsamp;
+				f->hdr.winid = j ? win2 : win;  f->hdr.compress = fconfig.compress;
+				vglconn.sendFrame(f);
+				frames++;
+			}
+			fill = 1 - fill;
+		} while((elapsed = timer.elapsed()) < 2.);
+
+		printf("%f Megapixels/sec (server)\n",
+			(double)w * (double)h * (double)frames / 1000000. / elapsed);
+
 		printf("\nTesting half-frame send ...\n");
 
 		fill = 0, frames = 0;  timer.start();
 		do
 		{
 			vglconn.synchronize();
-			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false));
+			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false,
+				win));
 			if(fill) memcpy(f->bits, buf, w * h * d);
 			else memcpy(f->bits, buf3, w * h * d);
 			f->hdr.qual = fconfig.qual;  f->hdr.subsamp = fconfig.subsamp;
@@ -217,7 +259,8 @@ int main(int argc, char **argv)
 		do
 		{
 			vglconn.synchronize();
-			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false));
+			ERRIFNOT(f = vglconn.getFrame(w, h, bgr ? PF_BGR : PF_RGB, 0, false,
+				win));
 			memcpy(f->bits, buf, w * h * d);
 			f->hdr.qual = fconfig.qual;  f->hdr.subsamp = fconfig.subsamp;
 			f->hdr.winid = win;  f->hdr.compress = fconfig.compress;
@@ -234,6 +277,7 @@ int main(int argc, char **argv)
 		retval = -1;
 	}
 
+	if(win2) XDestroyWindow(dpy, win2);
 	if(win) XDestroyWindow(dpy, win);
 	if(dpy) XCloseDisplay(dpy);
 	free(buf);
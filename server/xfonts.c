@@ -2,7 +2,7 @@
  * Mesa 3-D graphics library
  *
  * Copyright (C) 1999-2000  Brian Paul   All Rights Reserved.
- * Copyright (C) 2011-2012, 2014-2015, 2017-2021  D. R. Commander
+ * Copyright (C) 2011-2012, 2014-2015, 2017-2021, 2026  D. R. Commander
  *                                                All Rights Reserved.
  *
  * Permission is hereby granted, free of charge, to any person obtaining a
@@ -122,9 +122,12 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
    GLubyte *bm = NULL;
    int i, j, ngroups, groupsize, n;
    faker::VirtualWin *pbw;
+   faker::FontGlyphs *glyphs = NULL;
    typedef struct {
       int bm_width, bm_height, width, height, valid;
       GLfloat x0, y0, dx, dy;
+      XCharStruct *cs;
+      const GLubyte *bits;
    } charinfo;
    charinfo *ci = NULL;
 
@@ -178,14 +181,24 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
       return;
    }
 
-   if (fconfig.trace) {
+   /* Glyphs that were previously rasterized for the same font, either by
+      this process or (if VGL_FONTCACHE is set) by a previous process, are
+      obtained from the glyph cache rather than the 2D X server.  Fonts
+      without a name cannot be cached. */
+   {
       unsigned long name_value;
 
       if (XGetFontProperty(fs, XA_FONT, &name_value)) {
          char *name = XGetAtomName(dpy, name_value);
 
          if (name) {
-            PRARGS(name);  _XFree(name);
+            if (fconfig.trace) PRARGS(name);
+            try {
+               glyphs = fonthash.find(dpy, name);
+            } catch(...) {
+               _XFree(name);  throw;
+            }
+            _XFree(name);
          }
       }
    }
@@ -229,25 +242,13 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
       THROW("Couldn't allocate character info structure in glXUseXFont()");
 
    for (j = 0; j < count; j += groupsize) {
+      int uncached = 0;
+
       n = min(groupsize, count - j);
-      pixmap = XCreatePixmap(dpy, win, 8 * max_bm_width * n, max_bm_height, 1);
-      if (!pixmap)
-         THROW("Couldn't allocate pixmap in glXUseXFont()");
-      values.foreground = BlackPixel(dpy, DefaultScreen(dpy));
-      values.background = WhitePixel(dpy, DefaultScreen(dpy));
-      values.font = fs->fid;
-      valuemask = GCForeground | GCBackground | GCFont;
-      gc = XCreateGC(dpy, pixmap, valuemask, &values);
-
-      XSetForeground(dpy, gc, 0);
-      XFillRectangle(dpy, pixmap, gc, 0, 0, 8 * max_bm_width * n,
-                     max_bm_height);
-      XSetForeground(dpy, gc, 1);
 
       for (i = 0; i < n; i++) {
          XCharStruct *ch;
-         int x, y;
-         unsigned int c = first + i;
+         unsigned int c = first + j + i;
 
          /* check on index validity and get the bounds */
          ch = isvalid(fs, c);
@@ -258,6 +259,7 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
          else {
             ci[i].valid = 1;
          }
+         ci[i].cs = ch;
 
          /* glBitmap()' parameters:
             straight from the glXUseXFont(3) manpage.  */
@@ -269,48 +271,83 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
          ci[i].dx = ch->width;
          ci[i].dy = 0;
 
-         /* X11's starting point.  */
-         x = -ch->lbearing;
-         y = ch->ascent;
-
          /* Round the width to a multiple of eight.  We will use this also
             for the pixmap for capturing the X11 font.  This is slightly
             inefficient, but it makes the OpenGL part real easy.  */
          ci[i].bm_width = (ci[i].width + 7) / 8;
          ci[i].bm_height = ci[i].height;
 
+         ci[i].bits = NULL;
          if (ci[i].valid && (ci[i].bm_width > 0) && (ci[i].bm_height > 0)) {
-            XChar2b char2b;
-
-            char2b.byte1 = (c >> 8) & 0xff;
-            char2b.byte2 = (c & 0xff);
-            XDrawString16(dpy, pixmap, gc, x + i * max_bm_width * 8, y,
-                          &char2b, 1);
+            if (glyphs) ci[i].bits = glyphs->find(c, ch);
+            if (!ci[i].bits) uncached++;
          }
       }
 
-      XFreeGC(dpy, gc);  gc = 0;
-      ERRIFNOT(image = _XGetImage(dpy, pixmap, 0, 0, 8 * max_bm_width * n,
-                                  max_bm_height, 1, XYPixmap));
-      XFreePixmap(dpy, pixmap);  pixmap = 0;
+      /* Rasterize only the glyphs that aren't in the cache. */
+      if (uncached) {
+         pixmap = XCreatePixmap(dpy, win, 8 * max_bm_width * n, max_bm_height,
+                                1);
+         if (!pixmap)
+            THROW("Couldn't allocate pixmap in glXUseXFont()");
+         values.foreground = BlackPixel(dpy, DefaultScreen(dpy));
+         values.background = WhitePixel(dpy, DefaultScreen(dpy));
+         values.font = fs->fid;
+         valuemask = GCForeground | GCBackground | GCFont;
+         gc = XCreateGC(dpy, pixmap, valuemask, &values);
+
+         XSetForeground(dpy, gc, 0);
+         XFillRectangle(dpy, pixmap, gc, 0, 0, 8 * max_bm_width * n,
+                        max_bm_height);
+         XSetForeground(dpy, gc, 1);
+
+         for (i = 0; i < n; i++) {
+            unsigned int c = first + j + i;
+
+            if (ci[i].valid && (ci[i].bm_width > 0) && (ci[i].bm_height > 0)
+                && !ci[i].bits) {
+               XChar2b char2b;
+
+               /* X11's starting point.  */
+               int x = -ci[i].cs->lbearing;
+               int y = ci[i].cs->ascent;
+
+               char2b.byte1 = (c >> 8) & 0xff;
+               char2b.byte2 = (c & 0xff);
+               XDrawString16(dpy, pixmap, gc, x + i * max_bm_width * 8, y,
+                             &char2b, 1);
+            }
+         }
+
+         XFreeGC(dpy, gc);  gc = 0;
+         ERRIFNOT(image = _XGetImage(dpy, pixmap, 0, 0, 8 * max_bm_width * n,
+                                     max_bm_height, 1, XYPixmap));
+         XFreePixmap(dpy, pixmap);  pixmap = 0;
+      }
 
       for (i = 0; i < n; i++) {
          int list = listbase + j + i;
 
          _glNewList(list, GL_COMPILE);
          if (ci[i].valid && (ci[i].bm_width > 0) && (ci[i].bm_height > 0)) {
-            int x, y;
-
-            memset(bm, '\0', ci[i].bm_width * ci[i].bm_height);
-            /* Fill the bitmap (X11 and OpenGL are upside down wrt each
-               other).  */
-            for (y = 0; y < ci[i].bm_height; y++)
-               for (x = 0; x < 8 * ci[i].bm_width; x++)
-                  if (XGetPixel(image, x + i * max_bm_width * 8, y))
-                     bm[ci[i].bm_width * (ci[i].bm_height - y - 1) + x / 8] |=
-                        (1 << (7 - (x % 8)));
+            const GLubyte *bits = ci[i].bits;
+
+            if (!bits) {
+               int x, y;
+
+               memset(bm, '\0', ci[i].bm_width * ci[i].bm_height);
+               /* Fill the bitmap (X11 and OpenGL are upside down wrt each
+                  other).  */
+               for (y = 0; y < ci[i].bm_height; y++)
+                  for (x = 0; x < 8 * ci[i].bm_width; x++)
+                     if (XGetPixel(image, x + i * max_bm_width * 8, y))
+                        bm[ci[i].bm_width * (ci[i].bm_height - y - 1) + x / 8] |=
+                           (1 << (7 - (x % 8)));
+               bits = bm;
+               if (glyphs) glyphs->add(first + j + i, ci[i].cs, bm);
+            }
             _glBitmap(ci[i].width, ci[i].height, ci[i].x0, ci[i].y0, ci[i].dx,
-                      ci[i].dy, bm);
+                      ci[i].dy, bits);
          }
          else {
             _glBitmap(0, 0, 0.0, 0.0, ci[i].dx, ci[i].dy, NULL);
@@ -318,9 +355,14 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
          _glEndList();
       }
 
-      XDestroyImage(image);  image = NULL;
+      if (image) {
+         XDestroyImage(image);  image = NULL;
+      }
    }
 
+   if (glyphs && strlen(fconfig.fontcache) > 0)
+      glyphs->save(fconfig.fontcache);
+
    XFreeFontInfo(NULL, fs, 1);  fs = NULL;
    free(bm);  bm = NULL;
    free(ci);  ci = NULL;
@@ -333,6 +375,8 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
    _glPixelStorei(GL_UNPACK_SKIP_PIXELS, skippixels);
    _glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
 
+   if (newwin) _XDestroyWindow(dpy, win);
+
    } catch(...) {
       if (fs) XFreeFontInfo(NULL, fs, 1);
       if (gc && dpy) XFreeGC(dpy, gc);
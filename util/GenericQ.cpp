@@ -73,6 +73,37 @@ void GenericQ::spoil(void *item, SpoilCallback spoilCallback)
 }
 
 
+// Spoil only the items for which matchCallback(item, newItem) returns true,
+// leaving the others in the queue in their original order
+
+void GenericQ::spoil(void *item, SpoilCallback spoilCallback,
+	MatchCallback matchCallback)
+{
+	if(deadYet) return;
+	if(item == NULL) THROW("NULL argument in GenericQ::spoil()");
+	CriticalSection::SafeLock l(mutex);
+	if(deadYet) return;
+	Entry *prev = NULL, *entry = start;
+	while(entry != NULL)
+	{
+		Entry *next = entry->next;
+		// If the semaphore can't be decremented, then a consumer has already
+		// claimed the remaining items.
+		if(matchCallback(entry->item, item) && hasItem.tryWait())
+		{
+			if(prev) prev->next = next;
+			else start = next;
+			if(entry == end) end = prev;
+			spoilCallback(entry->item);
+			delete entry;
+		}
+		else prev = entry;
+		entry = next;
+	}
+	add(item);
+}
+
+
 void GenericQ::add(void *item)
 {
 	if(deadYet) return;
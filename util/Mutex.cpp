@@ -207,6 +207,103 @@ void CriticalSection::unlock(bool errorCheck)
 }
 
 
+ReadWriteLock::ReadWriteLock(void)
+{
+	#ifdef _WIN32
+
+	InitializeSRWLock(&rwlock);
+
+	#else
+
+	// With many threads performing overlapping reads, a reader-preferring lock
+	// could starve writers indefinitely.
+	pthread_rwlockattr_t rwla;
+	pthread_rwlockattr_init(&rwla);
+	#ifdef __GLIBC__
+	pthread_rwlockattr_setkind_np(&rwla,
+		PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	#endif
+	pthread_rwlock_init(&rwlock, &rwla);
+	pthread_rwlockattr_destroy(&rwla);
+
+	#endif
+}
+
+
+ReadWriteLock::~ReadWriteLock(void)
+{
+	#ifndef _WIN32
+
+	pthread_rwlock_destroy(&rwlock);
+
+	#endif
+}
+
+
+void ReadWriteLock::readLock(void)
+{
+	#ifdef _WIN32
+
+	AcquireSRWLockShared(&rwlock);
+
+	#else
+
+	int ret;
+	if((ret = pthread_rwlock_rdlock(&rwlock)) != 0)
+		throw(Error("ReadWriteLock::readLock()", strerror(ret)));
+
+	#endif
+}
+
+
+void ReadWriteLock::readUnlock(void)
+{
+	#ifdef _WIN32
+
+	ReleaseSRWLockShared(&rwlock);
+
+	#else
+
+	int ret;
+	if((ret = pthread_rwlock_unlock(&rwlock)) != 0)
+		throw(Error("ReadWriteLock::readUnlock()", strerror(ret)));
+
+	#endif
+}
+
+
+void ReadWriteLock::writeLock(void)
+{
+	#ifdef _WIN32
+
+	AcquireSRWLockExclusive(&rwlock);
+
+	#else
+
+	int ret;
+	if((ret = pthread_rwlock_wrlock(&rwlock)) != 0)
+		throw(Error("ReadWriteLock::writeLock()", strerror(ret)));
+
+	#endif
+}
+
+
+void ReadWriteLock::writeUnlock(void)
+{
+	#ifdef _WIN32
+
+	ReleaseSRWLockExclusive(&rwlock);
+
+	#else
+
+	int ret;
+	if((ret = pthread_rwlock_unlock(&rwlock)) != 0)
+		throw(Error("ReadWriteLock::writeUnlock()", strerror(ret)));
+
+	#endif
+}
+
+
 Semaphore::Semaphore(long initialCount)
 {
 	#ifdef _WIN32
@@ -26,6 +26,7 @@
 	#include <arpa/inet.h>
 	#include <netdb.h>
 	#include <netinet/tcp.h>
+	#include <sys/uio.h>
 	#define SOCKET_ERROR  -1
 	#define INVALID_SOCKET  -1
 #endif
@@ -202,6 +203,10 @@ Socket::Socket(bool doSSL_, bool ipv6_) :
 				SSLeay_version(SSLEAY_VERSION));
 	}
 	ssl = NULL;  sslctx = NULL;
+	char *env = NULL;
+	ktls = ((env = getenv("VGL_KTLS")) != NULL && strlen(env) > 0
+		&& !strncmp(env, "1", 1));
+	ktlsSend = ktlsRecv = false;
 	#endif
 
 	sd = INVALID_SOCKET;
@@ -210,9 +215,10 @@ Socket::Socket(bool doSSL_, bool ipv6_) :
 
 #ifdef USESSL
 Socket::Socket(SOCKET sd_, SSL *ssl_) :
-	sslctx(NULL), ssl(ssl_), sd(sd_)
+	sslctx(NULL), ssl(ssl_), ktls(false), sd(sd_)
 {
 	doSSL = ssl ? true : false;
+	checkKTLS();
 	#ifdef _WIN32
 	CriticalSection::SafeLock l(mutex);
 	instanceCount++;
@@ -315,16 +321,41 @@ void Socket::connect(char *serverName, unsigned short port)
 		// overhauled to use a different key exchange algorithm.
 		if(!SSL_CTX_set_max_proto_version(sslctx, TLS1_2_VERSION)) THROW_SSL();
 		#endif
+		#ifdef USEKTLS
+		if(ktls) SSL_CTX_set_options(sslctx, SSL_OP_ENABLE_KTLS);
+		#endif
 		if((ssl = SSL_new(sslctx)) == NULL) THROW_SSL();
 		if(!SSL_set_fd(ssl, (int)sd)) THROW_SSL();
 		int ret = SSL_connect(ssl);
 		if(ret != 1) throw(SSLError("Socket::connect", ssl, ret));
 		SSL_set_connect_state(ssl);
+		checkKTLS();
 	}
 	#endif
 }
 
 
+#ifdef USESSL
+
+// OpenSSL enables kernel TLS offload, on a per-direction basis, once the
+// handshake has completed, but only if the kernel supports the negotiated
+// cipher.  Otherwise, it falls back to user-space encryption.
+
+void Socket::checkKTLS(void)
+{
+	ktlsSend = ktlsRecv = false;
+	#ifdef USEKTLS
+	if(ssl)
+	{
+		ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+		ktlsRecv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+	}
+	#endif
+}
+
+#endif
+
+
 unsigned short Socket::setupListener(unsigned short port, bool reuseAddr)
 {
 	int one = 1, reuse = reuseAddr ? 1 : 0;
@@ -402,6 +433,9 @@ unsigned short Socket::listen(unsigned short port, bool reuseAddr)
 			if(SSL_CTX_use_PrivateKey(sslctx, priv) <= 0)
 				THROW_SSL();
 			if(!SSL_CTX_check_private_key(sslctx)) THROW_SSL();
+			#ifdef USEKTLS
+			if(ktls) SSL_CTX_set_options(sslctx, SSL_OP_ENABLE_KTLS);
+			#endif
 			if(priv) EVP_PKEY_free(priv);
 			if(cert) X509_free(cert);
 		}
@@ -479,9 +513,11 @@ void Socket::send(char *buf, int len)
 	while(bytesSent < len)
 	{
 		#ifdef USESSL
-		if(doSSL)
+		// If the kernel is encrypting outgoing data, then it is safe to bypass
+		// OpenSSL and send the plain text directly.
+		if(doSSL && !ktlsSend)
 		{
-			retval = SSL_write(ssl, &buf[bytesSent], len);
+			retval = SSL_write(ssl, &buf[bytesSent], len - bytesSent);
 			if(retval <= 0) throw(SSLError("Socket::send", ssl, retval));
 		}
 		else
@@ -509,7 +545,7 @@ void Socket::recv(char *buf, int len)
 		#ifdef USESSL
 		if(doSSL)
 		{
-			retval = SSL_read(ssl, &buf[bytesRead], len);
+			retval = SSL_read(ssl, &buf[bytesRead], len - bytesRead);
 			if(retval <= 0) throw(SSLError("Socket::recv", ssl, retval));
 		}
 		else
@@ -523,3 +559,46 @@ void Socket::recv(char *buf, int len)
 	}
 	if(bytesRead != len) THROW("Incomplete receive");
 }
+
+
+// Receive rows of data into a buffer whose rows are pitch bytes apart (pitch
+// can be negative), such as a region of an image.  If the data is not
+// encrypted, then as many rows as possible are received with each system
+// call.
+
+void Socket::recv(char *buf, int rowLen, int pitch, int rows)
+{
+	if(sd == INVALID_SOCKET) THROW("Not connected");
+	if(rowLen < 1 || rows < 1) return;
+	#ifndef _WIN32
+	#ifdef USESSL
+	if(!doSSL)
+	#endif
+	{
+		static const int MAXIOVS = 256;
+		struct iovec iov[MAXIOVS];
+		// The number of rows that have been completely received and the number
+		// of bytes that have been received in the next row
+		int row = 0, offset = 0;
+
+		while(row < rows)
+		{
+			int n;
+			for(n = 0; n < MAXIOVS && row + n < rows; n++)
+			{
+				iov[n].iov_base = &buf[(long)pitch * (row + n)];
+				iov[n].iov_len = rowLen;
+			}
+			iov[0].iov_base = (char *)iov[0].iov_base + offset;
+			iov[0].iov_len -= offset;
+			ssize_t retval = readv(sd, iov, n);
+			if(retval == SOCKET_ERROR) THROW_SOCK();
+			if(retval == 0) THROW("Incomplete receive");
+			offset += (int)retval;
+			row += offset / rowLen;  offset %= rowLen;
+		}
+		return;
+	}
+	#endif
+	for(int i = 0; i < rows; i++) recv(&buf[(long)pitch * i], rowLen);
+}
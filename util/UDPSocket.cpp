@@ -0,0 +1,418 @@
+// Copyright (C)2026 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "UDPSocket.h"
+#include "vglutil.h"
+
+#ifdef _WIN32
+	#include <ws2tcpip.h>
+#else
+	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/select.h>
+	#include <netdb.h>
+	#define SOCKET_ERROR  -1
+	#define INVALID_SOCKET  -1
+#endif
+
+using namespace util;
+
+
+#define TRY_SOCK(f)  { if((f) == SOCKET_ERROR) THROW_SOCK(); }
+
+// A frame is sent as a burst of datagrams, so the default socket buffers are
+// too small to avoid self-inflicted loss.  This is only a request, so the OS
+// is free to clamp it.
+#define DGRAMBUFSIZE  (4 * 1024 * 1024)
+
+
+static void setBufSize(SOCKET sd, int option)
+{
+	int size = DGRAMBUFSIZE;
+	setsockopt(sd, SOL_SOCKET, option, (char *)&size, sizeof(int));
+}
+
+
+// Datagrams can be refused if the receiver has not yet bound its socket or
+// has gone away.  The TCP connection will report the latter.  Winsock reports
+// the ICMP port unreachable message as a connection reset.
+
+static bool dgramRefused(void)
+{
+	#ifdef _WIN32
+	int err = WSAGetLastError();
+	return err == WSAECONNRESET || err == WSAECONNREFUSED || err == WSAENOBUFS;
+	#else
+	return errno == ECONNREFUSED || errno == ENOBUFS;
+	#endif
+}
+
+
+static bool interrupted(void)
+{
+	#ifdef _WIN32
+	return WSAGetLastError() == WSAEINTR;
+	#else
+	return errno == EINTR;
+	#endif
+}
+
+
+// Compare the host portions of two socket addresses, treating an IPv4-mapped
+// IPv6 address as equivalent to the corresponding IPv4 address
+
+static bool getHost(const struct sockaddr_storage &ss, unsigned char *addr,
+	int &len)
+{
+	if(ss.ss_family == AF_INET6)
+	{
+		const unsigned char *a =
+			(const unsigned char *)&((const struct sockaddr_in6 *)&ss)->sin6_addr;
+		static const unsigned char mapped[12] =
+			{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+		if(!memcmp(a, mapped, 12)) { memcpy(addr, &a[12], 4);  len = 4; }
+		else { memcpy(addr, a, 16);  len = 16; }
+		return true;
+	}
+	else if(ss.ss_family == AF_INET)
+	{
+		memcpy(addr, &((const struct sockaddr_in *)&ss)->sin_addr, 4);  len = 4;
+		return true;
+	}
+	return false;
+}
+
+
+static unsigned short getPort(const struct sockaddr_storage &ss)
+{
+	if(ss.ss_family == AF_INET6)
+		return ntohs(((const struct sockaddr_in6 *)&ss)->sin6_port);
+	else if(ss.ss_family == AF_INET)
+		return ntohs(((const struct sockaddr_in *)&ss)->sin_port);
+	return 0;
+}
+
+
+static bool sameHost(const struct sockaddr_storage &ss1,
+	const struct sockaddr_storage &ss2)
+{
+	unsigned char addr1[16], addr2[16];  int len1 = 0, len2 = 0;
+
+	if(!getHost(ss1, addr1, len1) || !getHost(ss2, addr2, len2)) return false;
+	return len1 == len2 && !memcmp(addr1, addr2, len1);
+}
+
+
+UDPSocket::UDPSocket(bool ipv6_) : sd(INVALID_SOCKET), ipv6(ipv6_),
+	lossRate(0.), latency(0.), restrictPeer(false), peerPort(0), start(NULL),
+	end(NULL),
+	thread(NULL), deadYet(false)
+{
+	char *env = NULL;
+
+	if((env = getenv("VGL_UDPLOSS")) != NULL && strlen(env) > 0)
+	{
+		double temp = atof(env);
+		if(temp > 0. && temp <= 100.) lossRate = temp / 100.;
+	}
+	if((env = getenv("VGL_UDPLATENCY")) != NULL && strlen(env) > 0)
+	{
+		double temp = atof(env);
+		if(temp > 0.) latency = temp / 1000.;
+	}
+	seed = (unsigned int)(GetTime() * 1000000.);
+	if(!seed) seed = 1;
+	if(latency > 0.)
+	{
+		thread = new Thread(this);
+		thread->start();
+	}
+}
+
+
+UDPSocket::~UDPSocket(void)
+{
+	deadYet = true;
+	if(thread)
+	{
+		hasDgram.post();  thread->stop();  delete thread;  thread = NULL;
+	}
+	while(start)
+	{
+		DelayedDgram *next = start->next;
+		free(start->buf);  delete start;  start = next;
+	}
+	close();
+}
+
+
+void UDPSocket::close(void)
+{
+	if(sd != INVALID_SOCKET)
+	{
+		#ifdef _WIN32
+		closesocket(sd);
+		#else
+		::close(sd);
+		#endif
+		sd = INVALID_SOCKET;
+	}
+}
+
+
+unsigned short UDPSocket::bind(unsigned short port, const char *peerName)
+{
+	struct sockaddr_storage ss;
+	struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&ss;
+	socklen_t addrlen;
+
+	if(sd != INVALID_SOCKET) THROW("Already bound");
+
+	if(peerName)
+	{
+		struct addrinfo hints, *addr = NULL;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		hints.ai_flags = AI_NUMERICHOST;
+		int err = getaddrinfo(peerName, NULL, &hints, &addr);
+		if(err != 0)
+			throw(Error(__FUNCTION__, gai_strerror(err), __LINE__));
+		memset(&peer, 0, sizeof(peer));
+		memcpy(&peer, addr->ai_addr, addr->ai_addrlen);
+		freeaddrinfo(addr);
+		restrictPeer = true;
+	}
+
+	if((sd = socket(ipv6 ? AF_INET6 : AF_INET, SOCK_DGRAM,
+		IPPROTO_UDP)) == INVALID_SOCKET)
+		THROW_SOCK();
+	setBufSize(sd, SO_RCVBUF);
+
+	memset(&ss, 0, sizeof(ss));
+	if(ipv6)
+	{
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_addr = in6addr_any;
+		sin6->sin6_port = htons(port);
+		addrlen = sizeof(struct sockaddr_in6);
+	}
+	else
+	{
+		sin->sin_family = AF_INET;
+		sin->sin_addr.s_addr = htonl(INADDR_ANY);
+		sin->sin_port = htons(port);
+		addrlen = sizeof(struct sockaddr_in);
+	}
+	TRY_SOCK(::bind(sd, (struct sockaddr *)&ss, addrlen));
+	TRY_SOCK(getsockname(sd, (struct sockaddr *)&ss, &addrlen));
+
+	return ipv6 ? ntohs(sin6->sin6_port) : ntohs(sin->sin_port);
+}
+
+
+void UDPSocket::setPeerPort(unsigned short port)
+{
+	CriticalSection::SafeLock l(mutex);
+	peerPort = port;
+}
+
+
+unsigned short UDPSocket::getPort(void)
+{
+	struct sockaddr_storage ss;
+	socklen_t addrlen = sizeof(ss);
+
+	if(sd == INVALID_SOCKET) THROW("Not connected");
+	memset(&ss, 0, sizeof(ss));
+	TRY_SOCK(getsockname(sd, (struct sockaddr *)&ss, &addrlen));
+	return ::getPort(ss);
+}
+
+
+void UDPSocket::connect(const char *serverName, unsigned short port)
+{
+	struct addrinfo hints, *addr = NULL;
+	char portName[10];
+
+	if(serverName == NULL || strlen(serverName) < 1) THROW("Invalid argument");
+	if(sd != INVALID_SOCKET) THROW("Already connected");
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(portName, 10, "%d", port);
+	int err = getaddrinfo(serverName, portName, &hints, &addr);
+	if(err != 0)
+		throw(Error(__FUNCTION__, gai_strerror(err), __LINE__));
+
+	try
+	{
+		if((sd = socket(addr->ai_family, SOCK_DGRAM,
+			IPPROTO_UDP)) == INVALID_SOCKET)
+			THROW_SOCK();
+		setBufSize(sd, SO_SNDBUF);
+		TRY_SOCK(::connect(sd, addr->ai_addr, (socklen_t)addr->ai_addrlen));
+		freeaddrinfo(addr);
+	}
+	catch(...)
+	{
+		freeaddrinfo(addr);
+		throw;
+	}
+}
+
+
+void UDPSocket::send(char *buf, int len)
+{
+	if(sd == INVALID_SOCKET) THROW("Not connected");
+
+	if(lossRate > 0. && random() < lossRate) return;
+	if(latency > 0.)
+	{
+		DelayedDgram *dgram = new DelayedDgram;
+		if(!(dgram->buf = (char *)malloc(len)))
+		{
+			delete dgram;  THROW("Memory allocation error");
+		}
+		memcpy(dgram->buf, buf, len);
+		dgram->len = len;  dgram->due = GetTime() + latency;
+		dgram->next = NULL;
+		CriticalSection::SafeLock l(mutex);
+		if(end) end->next = dgram;
+		else start = dgram;
+		end = dgram;
+		hasDgram.post();
+		return;
+	}
+	sendNow(buf, len);
+}
+
+
+void UDPSocket::sendNow(char *buf, int len)
+{
+	if(::send(sd, buf, len, 0) == SOCKET_ERROR && !dgramRefused())
+		THROW_SOCK();
+}
+
+
+// Returns a pseudo-random number in [0, 1).  This is a 32-bit xorshift
+// generator, which is more than adequate for simulating packet loss and is
+// available on all platforms.
+
+unsigned int UDPSocket::newToken(void)
+{
+	unsigned int token = 0;
+
+	#ifdef HAVE_DEVURANDOM
+	FILE *file = fopen("/dev/urandom", "rb");
+	if(file)
+	{
+		size_t bytesRead = fread(&token, sizeof(token), 1, file);
+		fclose(file);
+		if(bytesRead == 1 && token != 0) return token;
+	}
+	#endif
+	double t = GetTime();
+	token = (unsigned int)((t - (double)(long)t) * 4294967296.);
+	#ifdef _WIN32
+	token ^= (unsigned int)GetCurrentProcessId() << 16;
+	#else
+	token ^= (unsigned int)getpid() << 16;
+	#endif
+	return token ? token : 1;
+}
+
+
+double UDPSocket::random(void)
+{
+	seed ^= seed << 13;  seed ^= seed >> 17;  seed ^= seed << 5;
+	return (double)seed / 4294967296.;
+}
+
+
+// Delivers datagrams after the simulated latency has elapsed.  Since the
+// latency is constant, datagrams become due in the order in which they were
+// queued.
+
+void UDPSocket::run(void)
+{
+	while(!deadYet)
+	{
+		DelayedDgram *dgram = NULL;
+
+		hasDgram.wait();  if(deadYet) break;
+		{
+			CriticalSection::SafeLock l(mutex);
+			dgram = start;
+			if(!dgram) continue;
+			start = start->next;
+			if(!start) end = NULL;
+		}
+		double wait = dgram->due - GetTime();
+		if(wait > 0.) usleep((long)(wait * 1000000.));
+		try
+		{
+			if(!deadYet) sendNow(dgram->buf, dgram->len);
+		}
+		catch(...) {}
+		free(dgram->buf);  delete dgram;
+	}
+}
+
+
+int UDPSocket::recv(char *buf, int len, double timeout)
+{
+	fd_set readfds;
+	struct timeval tv;
+	int retval;
+
+	if(sd == INVALID_SOCKET) THROW("Not connected");
+
+	FD_ZERO(&readfds);
+	FD_SET(sd, &readfds);
+	tv.tv_sec = (long)timeout;
+	tv.tv_usec = (long)((timeout - (double)tv.tv_sec) * 1000000.);
+	retval = select((int)sd + 1, &readfds, NULL, NULL, &tv);
+	if(retval == SOCKET_ERROR)
+	{
+		if(interrupted()) return 0;
+		THROW_SOCK();
+	}
+	if(retval == 0) return 0;
+
+	struct sockaddr_storage from;
+	socklen_t fromLen = sizeof(from);
+	memset(&from, 0, sizeof(from));
+	if((retval = recvfrom(sd, buf, len, 0, (struct sockaddr *)&from,
+		&fromLen)) == SOCKET_ERROR)
+	{
+		if(dgramRefused()) return 0;
+		THROW_SOCK();
+	}
+	// Discard datagrams from anyone other than the peer.  The source address of
+	// a datagram is easily spoofed, so this only filters out stray datagrams.
+	// It does not prevent another host from injecting datagrams.
+	if(restrictPeer)
+	{
+		if(!sameHost(from, peer)) return 0;
+		CriticalSection::SafeLock l(mutex);
+		if(peerPort && ::getPort(from) != peerPort) return 0;
+	}
+	return retval;
+}
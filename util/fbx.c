@@ -94,6 +94,12 @@ typedef struct _BMINFO
 
 #include <errno.h>
 
+#ifdef USEPRESENT
+#include <poll.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/present.h>
+#endif
+
 #ifdef USESHM
 
 static unsigned long serial = 0;  static int extok = 1;
@@ -111,6 +117,199 @@ static int xhandler(Display *dpy, XErrorEvent *e)
 }
 #endif
 
+
+#ifdef USEPRESENT
+
+/* Create the pixmap swap chain and register for Present events.  If the X
+   Present extension is unavailable, then fb->present is left at 0, and
+   fbx_write() draws directly to the window. */
+
+static void presentInit(fbx_struct *fb, int width, int height, int depth)
+{
+	xcb_connection_t *conn = XGetXCBConnection(fb->wh.dpy);
+	const xcb_query_extension_reply_t *ext;
+	xcb_present_query_version_reply_t *reply;
+	int i;
+
+	ext = xcb_get_extension_data(conn, &xcb_present_id);
+	if(!ext || !ext->present) goto bailout;
+	reply = xcb_present_query_version_reply(conn,
+		xcb_present_query_version(conn, XCB_PRESENT_MAJOR_VERSION,
+			XCB_PRESENT_MINOR_VERSION), NULL);
+	if(!reply) goto bailout;
+	free(reply);
+
+	for(i = 0; i < FBX_PRESENTPIXMAPS; i++)
+	{
+		fb->presentPm[i] = XCreatePixmap(fb->wh.dpy, fb->wh.d, width, height,
+			depth);
+		fb->presentIdle[i] = 1;
+	}
+	fb->presentEID = xcb_generate_id(conn);
+	xcb_present_select_input(conn, fb->presentEID, fb->wh.d,
+		XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY |
+		XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY);
+	fb->presentEvents = xcb_register_for_special_xge(conn, &xcb_present_id,
+		fb->presentEID, NULL);
+	fb->present = 1;
+	{
+		static int alreadyWarned = 0;
+		if(!alreadyWarned && warningFile)
+		{
+			fprintf(warningFile, "[FBX] Using the X Present extension\n");
+			alreadyWarned = 1;
+		}
+	}
+	return;
+
+	bailout:
+	{
+		static int alreadyWarned = 0;
+		if(!alreadyWarned && warningFile)
+		{
+			fprintf(warningFile,
+				"[FBX] WARNING: X Present extension not available.  Will draw directly to\n");
+			fprintf(warningFile, "[FBX]    the window instead.\n");
+			alreadyWarned = 1;
+		}
+	}
+}
+
+
+/* Process the Present events that have been received for the window.  If
+   wait is non-zero, then block until at least one event has been received.
+   If no event is received within PRESENTTIMEOUT seconds (because, for
+   instance, the window was destroyed or the presentation failed), then the
+   X server is synchronized, and the swap chain is treated as idle, so that
+   the caller never blocks indefinitely. */
+
+#define PRESENTTIMEOUT  1.0
+
+static int presentProcessEvents(fbx_struct *fb, int wait)
+{
+	xcb_connection_t *conn = XGetXCBConnection(fb->wh.dpy);
+	xcb_generic_event_t *ev;
+	double start = GetTime();
+	int i;
+
+	xcb_flush(conn);
+	while(1)
+	{
+		if(!(ev = xcb_poll_for_special_event(conn, fb->presentEvents)))
+		{
+			struct pollfd pfd;
+
+			if(!wait) break;
+			if(xcb_connection_has_error(conn))
+				THROW("X11 Error (connection to X server lost)");
+			if(GetTime() - start >= PRESENTTIMEOUT)
+			{
+				static int alreadyWarned = 0;
+				if(!alreadyWarned && warningFile)
+				{
+					fprintf(warningFile,
+						"[FBX] WARNING: Timed out waiting for a Present event.  Window may have\n");
+					fprintf(warningFile, "[FBX]    disappeared.\n");
+					alreadyWarned = 1;
+				}
+				XSync(fb->wh.dpy, False);
+				fb->presentPending = 0;
+				for(i = 0; i < FBX_PRESENTPIXMAPS; i++) fb->presentIdle[i] = 1;
+				break;
+			}
+			pfd.fd = xcb_get_file_descriptor(conn);
+			pfd.events = POLLIN;  pfd.revents = 0;
+			poll(&pfd, 1, 10);
+			continue;
+		}
+		wait = 0;
+
+		switch(((xcb_present_generic_event_t *)ev)->evtype)
+		{
+			case XCB_PRESENT_EVENT_COMPLETE_NOTIFY:
+			{
+				xcb_present_complete_notify_event_t *cn =
+					(xcb_present_complete_notify_event_t *)ev;
+				if(cn->kind == XCB_PRESENT_COMPLETE_KIND_PIXMAP)
+				{
+					fb->presentMSC = cn->msc;
+					if(fb->presentPending > 0) fb->presentPending--;
+				}
+				break;
+			}
+			case XCB_PRESENT_EVENT_IDLE_NOTIFY:
+			{
+				xcb_present_idle_notify_event_t *in =
+					(xcb_present_idle_notify_event_t *)ev;
+				for(i = 0; i < FBX_PRESENTPIXMAPS; i++)
+					if(fb->presentPm[i] == in->pixmap) fb->presentIdle[i] = 1;
+				break;
+			}
+		}
+		free(ev);
+	}
+	return 0;
+
+	finally:
+	return -1;
+}
+
+
+/* Copy the buffer into an idle pixmap from the swap chain, and present the
+   pixmap at the vertical refresh following the last completed presentation.
+   Apart from waiting for the X server to copy a shared memory image into the
+   pixmap, this waits only if a frame is already queued behind the one that is
+   being presented or if no pixmap is idle. */
+
+static int presentWrite(fbx_struct *fb)
+{
+	xcb_connection_t *conn = XGetXCBConnection(fb->wh.dpy);
+	int i, index = -1;
+
+	if(presentProcessEvents(fb, 0) == -1) return -1;
+	while(fb->presentPending > 1)
+		if(presentProcessEvents(fb, 1) == -1) return -1;
+	while(1)
+	{
+		for(i = 0; i < FBX_PRESENTPIXMAPS; i++)
+			if(fb->presentIdle[i]) { index = i;  break; }
+		if(index >= 0) break;
+		if(presentProcessEvents(fb, 1) == -1) return -1;
+	}
+
+	#ifdef USESHM
+	if(fb->shm)
+	{
+		if(!fb->xattach)
+		{
+			TRY_X11(XShmAttach(fb->wh.dpy, &fb->shminfo));  fb->xattach = 1;
+		}
+		TRY_X11(XShmPutImage(fb->wh.dpy, fb->presentPm[index], fb->xgc, fb->xi, 0,
+			0, 0, 0, fb->width, fb->height, False));
+		/* The caller may overwrite the shared memory image as soon as this
+		   function returns, so wait until the X server has copied it into the
+		   pixmap.  This does not wait for the vertical refresh. */
+		XSync(fb->wh.dpy, False);
+	}
+	else
+	#endif
+	XPutImage(fb->wh.dpy, fb->presentPm[index], fb->xgc, fb->xi, 0, 0, 0, 0,
+		fb->width, fb->height);
+
+	fb->presentIdle[index] = 0;
+	xcb_present_pixmap(conn, fb->wh.d, fb->presentPm[index],
+		++fb->presentSerial, 0, 0, 0, 0, 0, 0, 0, XCB_PRESENT_OPTION_NONE,
+		fb->presentMSC ? fb->presentMSC + 1 : 0, 0, 0, 0, NULL);
+	fb->presentPending++;
+	xcb_flush(conn);
+	return 0;
+
+	finally:
+	return -1;
+}
+
+#endif  /* USEPRESENT */
+
 #endif
 
 
@@ -132,14 +331,14 @@ void fbx_printwarnings(FILE *stream)
 }
 
 
-int fbx_init(fbx_struct *fb, fbx_wh wh, int width_, int height_, int useShm)
+int fbx_init(fbx_struct *fb, fbx_wh wh, int width_, int height_, int flags)
 {
 	int width, height, ps, i;
 	unsigned int rmask, gmask, bmask;
 	#ifdef _WIN32
 	BMINFO bminfo;  HBITMAP hmembmp = 0;  RECT rect;  HDC hdc = NULL;
 	#else
-	XWindowAttributes xwa;  int shmok = 1, pixmap = 0;
+	XWindowAttributes xwa;  int shmok = 1, pixmap = 0, useShm = flags & FBX_SHM;
 	#endif
 
 	if(!fb) THROW("Invalid argument");
@@ -400,6 +599,10 @@ int fbx_init(fbx_struct *fb, fbx_wh wh, int width_, int height_, int useShm)
 	TRY_X11(fb->xgc = XCreateGC(fb->wh.dpy, fb->pm ? fb->pm : fb->wh.d, 0,
 		NULL));
 	if(!useShm) XSetGraphicsExposures(fb->wh.dpy, fb->xgc, False);
+	#ifdef USEPRESENT
+	if((flags & FBX_PRESENT) && !pixmap)
+		presentInit(fb, width, height, xwa.depth);
+	#endif
 	return 0;
 
 	finally:
@@ -435,6 +638,11 @@ int fbx_read(fbx_struct *fb, int x_, int y_)
 
 	if(!fb->wh.dpy || !fb->wh.d || !fb->xi || !fb->bits)
 		THROW("Not initialized");
+	#ifdef USEPRESENT
+	/* Ensure that the pixels from previous writes are in the window */
+	while(fb->present && fb->presentPending > 0)
+		if(presentProcessEvents(fb, 1) == -1) return -1;
+	#endif
 	#ifdef USESHM
 	if(!fb->xattach && fb->shm)
 	{
@@ -501,6 +709,17 @@ int fbx_write(fbx_struct *fb, int srcX_, int srcY_, int dstX_, int dstY_,
 
 	#else
 
+	#ifdef USEPRESENT
+	if(fb->present)
+	{
+		if(srcX == 0 && srcY == 0 && dstX == 0 && dstY == 0
+			&& width == fb->width && height == fb->height)
+			return presentWrite(fb);
+		/* A pending presentation could otherwise overwrite this write. */
+		while(fb->presentPending > 0)
+			if(presentProcessEvents(fb, 1) == -1) return -1;
+	}
+	#endif
 	if(!fb->pm || !fb->shm)
 		if(fbx_awrite(fb, srcX, srcY, dstX, dstY, width, height) == -1) return -1;
 	if(fb->pm)
@@ -643,6 +862,25 @@ int fbx_term(fbx_struct *fb)
 	{
 		XFreePixmap(fb->wh.dpy, fb->pm);  fb->pm = 0;
 	}
+	#ifdef USEPRESENT
+	if(fb->presentEvents)
+	{
+		xcb_connection_t *conn = XGetXCBConnection(fb->wh.dpy);
+		xcb_generic_error_t *e;
+
+		/* The window may have already been destroyed, so any error is
+		   discarded rather than passed to the Xlib error handler. */
+		if((e = xcb_request_check(conn, xcb_present_select_input_checked(conn,
+			fb->presentEID, fb->wh.d, 0))) != NULL)
+			free(e);
+		xcb_unregister_for_special_event(conn, fb->presentEvents);
+	}
+	{
+		int i;
+		for(i = 0; i < FBX_PRESENTPIXMAPS; i++)
+			if(fb->presentPm[i]) XFreePixmap(fb->wh.dpy, fb->presentPm[i]);
+	}
+	#endif
 	if(fb->xi)
 	{
 		if(!fb->shm)
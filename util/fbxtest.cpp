@@ -54,6 +54,7 @@ int pixelOffset, retCode = 0;
 double benchTime = 5.0;
 #ifndef _WIN32
 bool checkDB = false;
+int presentFlag = 0;
 Window win = 0;
 #endif
 fbx_wh wh;
@@ -148,7 +149,13 @@ void nativeWrite(bool useShm)
 
 	try
 	{
+		#ifdef _WIN32
 		TRY_FBX(fbx_init(&fb, wh, 0, 0, useShm ? 1 : 0));
+		#else
+		TRY_FBX(fbx_init(&fb, wh, 0, 0, (useShm ? FBX_SHM : 0) | presentFlag));
+		if(presentFlag && !fb.present && !doPixmap)
+			THROW("X Present extension not available");
+		#endif
 		if(useShm && !fb.shm) THROW("MIT-SHM not available");
 		fprintf(stderr, "Native Pixel Format:  %s\n", fb.pf->name);
 		if(fb.width != drawableWidth || fb.height != drawableHeight)
@@ -692,6 +699,8 @@ void usage(char **argv)
 	fprintf(stderr, "-checkdb = Verify that double buffering is working correctly\n");
 	fprintf(stderr, "-noshm = Do not use MIT-SHM extension to accelerate blitting\n");
 	fprintf(stderr, "-pm = Blit to a pixmap rather than to a window\n");
+	fprintf(stderr, "-present = Use the X Present extension to synchronize full-window writes\n");
+	fprintf(stderr, "           with the vertical refresh\n");
 	#endif
 	fprintf(stderr, "-mt = Run multithreaded stress tests\n");
 	fprintf(stderr, "-v = Print all warnings and informational messages from FBX\n");
@@ -738,6 +747,7 @@ int main(int argc, char **argv)
 		{
 			doPixmap = true;  doShm = false;
 		}
+		else if(!stricmp(argv[i], "-present")) presentFlag = FBX_PRESENT;
 		#endif
 		else if(!stricmp(argv[i], "-i")) interactive = true;
 		else if(!stricmp(argv[i], "-mt")) doStress = true;
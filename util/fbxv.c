@@ -70,6 +70,15 @@ static int xhandler(Display *dpy, XErrorEvent *e)
 	if(prevHandler && prevHandler != xhandler) return prevHandler(dpy, e);
 	else return 0;
 }
+
+
+static Bool isCompletion(Display *dpy, XEvent *e, XPointer arg)
+{
+	fbxv_struct *fb = (fbxv_struct *)arg;
+
+	return e->type == fb->shmevent
+		&& ((XShmCompletionEvent *)e)->shmseg == fb->shminfo.shmseg;
+}
 #endif
 
 
@@ -196,6 +205,7 @@ int fbxv_init(fbxv_struct *fb, Display *dpy, Window win, int width_,
 			shmctl(fb->shminfo.shmid, IPC_RMID, 0);  goto noshm;
 		}
 		fb->xattach = 1;  fb->shm = 1;
+		fb->shmevent = XShmGetEventBase(dpy) + ShmCompletion;
 	}
 	else if(useShm)
 	{
@@ -251,16 +261,49 @@ int fbxv_write(fbxv_struct *fb, int srcX_, int srcY_, int srcWidth_,
 		{
 			ERRIFNOT(XShmAttach(fb->dpy, &fb->shminfo));  fb->xattach = 1;
 		}
+		/* Wait for any previous draw of this image to finish, so that completion
+		   events never accumulate. */
+		if(fbxv_sync(fb) == -1) return -1;
 		TRY_X11(XvShmPutImage(fb->dpy, fb->port, fb->win, fb->xgc, fb->xvi, srcX,
-			srcY, srcWidth, srcHeight, dstX, dstY, dstWidth, dstHeight, False));
+			srcY, srcWidth, srcHeight, dstX, dstY, dstWidth, dstHeight, True));
+		fb->pending = 1;
 	}
 	else
 	#endif
 
+	/* XvPutImage() copies the image into the request, so the image can be
+	   modified as soon as the request has been queued. */
 	TRY_X11(XvPutImage(fb->dpy, fb->port, fb->win, fb->xgc, fb->xvi, srcX, srcY,
 		srcWidth, srcHeight, dstX, dstY, dstWidth, dstHeight));
 	XFlush(fb->dpy);
-	XSync(fb->dpy, False);
+	return 0;
+
+	finally:
+	return -1;
+}
+
+
+int fbxv_sync(fbxv_struct *fb)
+{
+	if(!fb) THROW("Invalid argument");
+
+	#ifdef USESHM
+	if(fb->shm && fb->pending)
+	{
+		XEvent e;
+
+		/* If the completion event hasn't arrived yet, then a round trip ensures
+		   that the X server has finished with the image.  The event will also
+		   have been queued by then, unless the request failed (for instance,
+		   because the window was destroyed.) */
+		if(!XCheckIfEvent(fb->dpy, &e, isCompletion, (XPointer)fb))
+		{
+			XSync(fb->dpy, False);
+			XCheckIfEvent(fb->dpy, &e, isCompletion, (XPointer)fb);
+		}
+		fb->pending = 0;
+	}
+	#endif
 	return 0;
 
 	finally:
@@ -279,6 +322,7 @@ int fbxv_term(fbxv_struct *fb)
 	#ifdef USESHM
 	if(fb->shm)
 	{
+		fbxv_sync(fb);
 		if(fb->xattach)
 		{
 			XShmDetach(fb->dpy, &fb->shminfo);  XSync(fb->dpy, False);
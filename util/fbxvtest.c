@@ -157,6 +157,9 @@ static int doTest(int id, char *name)
 		else { TRY_FBXV(fbxv_write(&s1, 0, 0, 0, 0, 0, 0, width, height)); }
 		iter++;
 	} while((elapsed = GetTime() - t) < testTime);
+	TRY_FBXV(fbxv_sync(&s));
+	if(!filename) { TRY_FBXV(fbxv_sync(&s1)); }
+	elapsed = GetTime() - t;
 	printf("%f Mpixels/sec\n",
 		(double)(width * height) / 1000000. * (double)iter / elapsed);
 
@@ -217,6 +220,7 @@ static int doInteractiveTest(int id, char *name)
 		{
 			TRY_FBXV(fbxv_init(&s, dpy, win, width / scale, height / scale, id,
 				useShm));
+			TRY_FBXV(fbxv_sync(&s));
 			initBuf(&s, id, iter);  iter++;
 			TRY_FBXV(fbxv_write(&s, 0, 0, 0, 0, 0, 0, width, height));
 		}
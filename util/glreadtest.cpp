@@ -1,6 +1,6 @@
 // Copyright (C)2004 Landmark Graphics Corporation
 // Copyright (C)2005 Sun Microsystems, Inc.
-// Copyright (C)2010-2011, 2013-2014, 2017-2019, 2021 D. R. Commander
+// Copyright (C)2010-2011, 2013-2014, 2017-2019, 2021, 2026 D. R. Commander
 //
 // This library is free software and may be redistributed and/or modified under
 // the terms of the wxWindows Library License, Version 3.1 or (at your option)
@@ -20,10 +20,17 @@
 #include "vglutil.h"
 #include "Timer.h"
 #include "Error.h"
+#include "Thread.h"
+#include "Mutex.h"
 #include <errno.h>
+#include <sys/resource.h>
 #define GL_GLEXT_PROTOTYPES
 #include <GL/glx.h>
 #include <GL/glu.h>
+#ifdef USEEGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 #include "x11err.h"
 #ifdef USEIFR
 #include "NvIFROpenGL.h"
@@ -52,6 +59,7 @@ const char *formatName[PIXELFORMATS] =
 #define DEFAULT_HEIGHT  701
 #define DEFAULT_ALIGN  1
 #define BENCHTIME  1.0
+#define MAX_RING  16
 
 int drawableWidth = DEFAULT_WIDTH, drawableHeight = DEFAULT_HEIGHT,
 	align = DEFAULT_ALIGN;
@@ -62,16 +70,22 @@ GLXPbuffer pbuffer = 0;
 
 Timer timer;
 bool useWindow = false, usePixmap = false, useFBO = false, useRTT = false,
-	useAlpha = false, usePBO = false;
+	useAlpha = false, usePBO = false, useRenderThread = false;
 unsigned int visualID;
-int loops = 1;
+int loops = 1, ringDepth = 1, msaaSamples = 0;
 #ifdef USEIFR
 bool useIFR = false;
 NvIFRAPI ifr;
 NV_IFROGL_SESSION_HANDLE ifrSession = NULL;
 #endif
 #ifdef GL_EXT_framebuffer_object
-GLuint fbo = 0, rbo = 0, texture = 0;
+GLuint fbo = 0, rbo = 0, texture = 0, resolveFBO = 0, resolveRBO = 0;
+#endif
+bool useEGL = false;
+#ifdef USEEGL
+int eglDevice = 0;
+EGLDisplay edpy = EGL_NO_DISPLAY;  EGLConfig ec = 0;
+EGLContext ectx = EGL_NO_CONTEXT;  EGLSurface epb = EGL_NO_SURFACE;
 #endif
 double benchTime = BENCHTIME;
 
@@ -177,10 +191,160 @@ void findVisual(int bpc)
 }
 
 
+// Returns the buffer that is rendered to and read back
+GLenum getBuffer(void)
+{
+	#ifdef GL_EXT_framebuffer_object
+	if(useFBO) return GL_COLOR_ATTACHMENT0_EXT;
+	#endif
+	#ifdef USEEGL
+	// EGL Pbuffer surfaces have only a back buffer.
+	if(useEGL) return GL_BACK;
+	#endif
+	return GL_FRONT;
+}
+
+
+#ifdef USEEGL
+
+void eglInit(void)
+{
+	EGLDeviceEXT devices[32];  EGLint numDevices = 0, major, minor, nc = 0;
+	int cfgattribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8, EGL_NONE, EGL_NONE, EGL_NONE };
+	int pbattribs[] = { EGL_WIDTH, drawableWidth, EGL_HEIGHT, drawableHeight,
+		EGL_NONE };
+
+	const char *exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if(!exts || !strstr(exts, "EGL_EXT_platform_device"))
+		THROW("EGL_EXT_platform_device extension not available");
+	PFNEGLQUERYDEVICESEXTPROC _eglQueryDevicesEXT =
+		(PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+	PFNEGLGETPLATFORMDISPLAYEXTPROC _eglGetPlatformDisplayEXT =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if(!_eglQueryDevicesEXT || !_eglGetPlatformDisplayEXT)
+		THROW("Could not load EGL device extension functions");
+	if(!_eglQueryDevicesEXT(32, devices, &numDevices) || numDevices < 1)
+		THROW("No EGL devices found");
+	if(eglDevice >= numDevices)
+		THROW("Specified EGL device does not exist");
+
+	edpy = _eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT,
+		devices[eglDevice], NULL);
+	if(edpy == EGL_NO_DISPLAY || !eglInitialize(edpy, &major, &minor))
+		THROW("Could not open EGL display");
+	if(useAlpha)
+	{
+		cfgattribs[10] = EGL_ALPHA_SIZE;  cfgattribs[11] = 8;
+	}
+	if(!eglChooseConfig(edpy, cfgattribs, &ec, 1, &nc) || nc < 1)
+		THROW("Could not obtain EGL config");
+	int configID = -1;
+	eglGetConfigAttrib(edpy, ec, EGL_CONFIG_ID, &configID);
+	printf("EGL device = %d, EGL config = 0x%.2x\n", eglDevice, configID);
+
+	if(!eglBindAPI(EGL_OPENGL_API)) THROW("Could not enable OpenGL API");
+	if(!(ectx = eglCreateContext(edpy, ec, EGL_NO_CONTEXT, NULL)))
+		THROW("Could not create GL context");
+	if(!(epb = eglCreatePbufferSurface(edpy, ec, pbattribs)))
+		THROW("Could not create Pbuffer");
+	if(!eglMakeCurrent(edpy, epb, epb, ectx))
+		THROW("Could not make GL context current");
+}
+
+#endif
+
+
+#ifdef GL_EXT_framebuffer_object
+
+void fboInit(void)
+{
+	GLenum format = useAlpha ? GL_RGBA8 : GL_RGB8;
+	if(v && v->depth == 30) format = useAlpha ? GL_RGB10_A2 : GL_RGB10;
+	glGenFramebuffersEXT(1, &fbo);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+	if(useRTT)
+	{
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB, texture);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER,
+			GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER,
+			GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, format, drawableWidth,
+			drawableHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+			GL_TEXTURE_RECTANGLE_ARB, texture, 0);
+	}
+	else
+	{
+		glGenRenderbuffersEXT(1, &rbo);
+		glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rbo);
+		if(msaaSamples > 0)
+			glRenderbufferStorageMultisampleEXT(GL_RENDERBUFFER_EXT, msaaSamples,
+				format, drawableWidth, drawableHeight);
+		else
+			glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, format, drawableWidth,
+				drawableHeight);
+		glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,
+			GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, rbo);
+	}
+	if(glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT)
+		!= GL_FRAMEBUFFER_COMPLETE_EXT)
+		THROW("Could not create FBO");
+
+	// A multisampled renderbuffer cannot be read directly, so it is resolved
+	// into a single-sampled renderbuffer prior to each readback (which is what
+	// the VirtualGL Faker does when reading back a multisampled drawable.)
+	if(msaaSamples > 0)
+	{
+		glGenFramebuffersEXT(1, &resolveFBO);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, resolveFBO);
+		glGenRenderbuffersEXT(1, &resolveRBO);
+		glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, resolveRBO);
+		glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, format, drawableWidth,
+			drawableHeight);
+		glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,
+			GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, resolveRBO);
+		if(glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT)
+			!= GL_FRAMEBUFFER_COMPLETE_EXT)
+			THROW("Could not create resolve FBO");
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+	}
+}
+
+
+// Resolves the multisampled FBO and binds the resolve FBO for reading
+
+void resolveMSAA(void)
+{
+	glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, fbo);
+	glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, resolveFBO);
+	glBlitFramebufferEXT(0, 0, drawableWidth, drawableHeight, 0, 0,
+		drawableWidth, drawableHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, fbo);
+	glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, resolveFBO);
+}
+
+#endif
+
+
 void drawableInit(void)
 {
 	int pbattribs[] = { GLX_PBUFFER_WIDTH, 0, GLX_PBUFFER_HEIGHT, 0, None };
 
+	#ifdef USEEGL
+	if(useEGL)
+	{
+		eglInit();
+		#ifdef GL_EXT_framebuffer_object
+		if(useFBO) fboInit();
+		#endif
+		return;
+	}
+	#endif
+
 	// Use GLX 1.1 functions here in case we're remotely displaying to
 	// something that doesn't support GLX 1.3
 	if(useWindow || usePixmap || useFBO)
@@ -196,38 +360,7 @@ void drawableInit(void)
 		glXMakeCurrent(dpy, usePixmap ? glxpm : win, ctx);
 
 		#ifdef GL_EXT_framebuffer_object
-		if(useFBO)
-		{
-			GLenum format = useAlpha ? GL_RGBA8 : GL_RGB8;
-			if(v->depth == 30) format = useAlpha ? GL_RGB10_A2 : GL_RGB10;
-			glGenFramebuffersEXT(1, &fbo);
-			glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
-			if(useRTT)
-			{
-				glGenTextures(1, &texture);
-				glBindTexture(GL_TEXTURE_RECTANGLE_ARB, texture);
-				glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER,
-					GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER,
-					GL_LINEAR);
-				glTexImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, format, drawableWidth,
-					drawableHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-				glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
-					GL_TEXTURE_RECTANGLE_ARB, texture, 0);
-			}
-			else
-			{
-				glGenRenderbuffersEXT(1, &rbo);
-				glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rbo);
-				glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, format, drawableWidth,
-					drawableHeight);
-				glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,
-					GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, rbo);
-			}
-			if(glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT)
-				!= GL_FRAMEBUFFER_COMPLETE_EXT)
-				THROW("Could not create FBO");
-		}
+		if(useFBO) fboInit();
 		#endif
 		return;
 	}
@@ -243,6 +376,152 @@ void drawableInit(void)
 }
 
 
+// This thread continuously renders into its own context and drawable while
+// the readback tests are running, in order to measure the effect of GPU
+// contention on readback performance.
+
+class RenderThread : public Runnable
+{
+	public:
+
+		RenderThread(void) : deadYet(false), frames(0), thread(NULL) {}
+
+		virtual ~RenderThread(void)
+		{
+			stop();
+		}
+
+		void start(void)
+		{
+			thread = new Thread(this);
+			thread->start();
+		}
+
+		void stop(void)
+		{
+			if(thread)
+			{
+				deadYet = true;
+				thread->stop();
+				delete thread;  thread = NULL;
+			}
+		}
+
+		void checkError(void)
+		{
+			if(thread) thread->checkError();
+		}
+
+		long getFrames(void)
+		{
+			CriticalSection::SafeLock l(mutex);
+			return frames;
+		}
+
+	private:
+
+		void run(void)
+		{
+			Display *rdpy = NULL;  GLXContext rctx = 0;  GLXPbuffer rpb = 0;
+			#ifdef USEEGL
+			EGLContext rectx = EGL_NO_CONTEXT;  EGLSurface repb = EGL_NO_SURFACE;
+			#endif
+
+			try
+			{
+				#ifdef USEEGL
+				if(useEGL)
+				{
+					int pbattribs[] = { EGL_WIDTH, drawableWidth,
+						EGL_HEIGHT, drawableHeight, EGL_NONE };
+					if(!eglBindAPI(EGL_OPENGL_API))
+						THROW("Could not enable OpenGL API");
+					if(!(rectx = eglCreateContext(edpy, ec, EGL_NO_CONTEXT, NULL)))
+						THROW("Could not create GL context");
+					if(!(repb = eglCreatePbufferSurface(edpy, ec, pbattribs)))
+						THROW("Could not create Pbuffer");
+					if(!eglMakeCurrent(edpy, repb, repb, rectx))
+						THROW("Could not make GL context current");
+				}
+				else
+				#endif
+				{
+					int fbattribs[] = { GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8,
+						GLX_BLUE_SIZE, 8, GLX_RENDER_TYPE, GLX_RGBA_BIT,
+						GLX_DRAWABLE_TYPE, GLX_PBUFFER_BIT, None };
+					int pbattribs[] = { GLX_PBUFFER_WIDTH, drawableWidth,
+						GLX_PBUFFER_HEIGHT, drawableHeight, None };
+					GLXFBConfig *fbconfigs = NULL;  int nelements = 0;
+
+					// Use a separate display connection so that the two threads do
+					// not contend for the same Xlib lock.
+					if(!(rdpy = XOpenDisplay(0)))
+						THROW("Could not open display");
+					fbconfigs = glXChooseFBConfig(rdpy, DefaultScreen(rdpy), fbattribs,
+						&nelements);
+					if(!nelements || !fbconfigs)
+					{
+						if(fbconfigs) XFree(fbconfigs);
+						THROW("Could not obtain FB config for rendering thread");
+					}
+					rctx = glXCreateNewContext(rdpy, fbconfigs[0], GLX_RGBA_TYPE, NULL,
+						True);
+					rpb = glXCreatePbuffer(rdpy, fbconfigs[0], pbattribs);
+					XFree(fbconfigs);
+					if(!rctx) THROW("Could not create GL context");
+					if(!rpb) THROW("Could not create Pbuffer");
+					if(!glXMakeContextCurrent(rdpy, rpb, rpb, rctx))
+						THROW("Could not make GL context current");
+				}
+
+				glDisable(GL_DEPTH_TEST);
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				while(!deadYet)
+				{
+					glClear(GL_COLOR_BUFFER_BIT);
+					for(int i = 0; i < 100; i++)
+					{
+						glColor4f((float)(i % 3) / 2.0f, (float)(i % 5) / 4.0f,
+							(float)(i % 7) / 6.0f, 0.5f);
+						glRectf(-1.0f, -1.0f, 1.0f, 1.0f);
+					}
+					glFinish();
+					CriticalSection::SafeLock l(mutex);
+					frames++;
+				}
+			}
+			catch(std::exception &e)
+			{
+				if(thread) thread->setError(e);
+			}
+
+			#ifdef USEEGL
+			if(useEGL)
+			{
+				eglMakeCurrent(edpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+				if(repb) eglDestroySurface(edpy, repb);
+				if(rectx) eglDestroyContext(edpy, rectx);
+			}
+			#endif
+			if(rdpy)
+			{
+				glXMakeContextCurrent(rdpy, 0, 0, 0);
+				if(rpb) glXDestroyPbuffer(rdpy, rpb);
+				if(rctx) glXDestroyContext(rdpy, rctx);
+				XCloseDisplay(rdpy);
+			}
+		}
+
+		bool deadYet;
+		long frames;
+		CriticalSection mutex;
+		Thread *thread;
+};
+
+RenderThread *renderThread = NULL;
+
+
 char glerrstr[STRLEN] = "No error";
 
 static void check_errors(const char *tag)
@@ -321,22 +600,18 @@ void clearFB(void)
 	memset(buf, 0xFF, bufSize);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-	#ifdef GL_EXT_framebuffer_object
-	if(useFBO)
-	{
-		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
-		glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
-	}
-	else
-	#endif
-	{
-		glDrawBuffer(GL_FRONT);
-		glReadBuffer(GL_FRONT);
-	}
+	glDrawBuffer(getBuffer());
+	glReadBuffer(getBuffer());
 	glClearColor(0., 0., 0., 0.);
 	glClear(GL_COLOR_BUFFER_BIT);
+	#ifdef GL_EXT_framebuffer_object
+	if(msaaSamples > 0) resolveMSAA();
+	#endif
 	glReadPixels(0, 0, drawableWidth, drawableHeight, GL_RGB, GL_UNSIGNED_BYTE,
 		buf);
+	#ifdef GL_EXT_framebuffer_object
+	if(msaaSamples > 0) glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+	#endif
 	check_errors("frame buffer read");
 	for(size_t i = 0; i < bufSize; i++)
 	{
@@ -397,6 +672,56 @@ int writeTest(int format)
 }
 
 
+static double getCPUTime(void)
+{
+	struct rusage usage;
+	// Measure only the CPU time used by the readback thread, so that the
+	// rendering thread (if any) is not included.
+	#ifdef RUSAGE_THREAD
+	if(getrusage(RUSAGE_THREAD, &usage) < 0)
+	#else
+	if(getrusage(RUSAGE_SELF, &usage) < 0)
+	#endif
+		return 0.;
+	return (double)usage.ru_utime.tv_sec +
+		(double)usage.ru_utime.tv_usec * 0.000001 +
+		(double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec * 0.000001;
+}
+
+
+// Per-frame readback latencies (in seconds) from the most recent test
+double *latencies = NULL;
+int nLatencies = 0, maxLatencies = 0;
+
+static void addLatency(double latency)
+{
+	if(nLatencies >= maxLatencies)
+	{
+		int newMax = maxLatencies ? maxLatencies * 2 : 1024;
+		double *newLatencies =
+			(double *)realloc(latencies, sizeof(double) * newMax);
+		if(!newLatencies) THROW("Could not allocate buffer");
+		latencies = newLatencies;  maxLatencies = newMax;
+	}
+	latencies[nLatencies++] = latency;
+}
+
+
+static int compareDouble(const void *arg1, const void *arg2)
+{
+	double d1 = *(const double *)arg1, d2 = *(const double *)arg2;
+	return d1 < d2 ? -1 : (d1 > d2 ? 1 : 0);
+}
+
+
+// Returns the given percentile of the (sorted) latencies
+static double percentile(double pct)
+{
+	if(nLatencies < 1) return 0.;
+	return latencies[(int)(pct / 100. * (double)(nLatencies - 1) + 0.5)];
+}
+
+
 // Generic OpenGL readback test
 int readTest(int format)
 {
@@ -404,12 +729,18 @@ int readTest(int format)
 	unsigned char *rgbaBuffer = NULL;
 	int n, retval = 0;
 	double rbtime, readPixelsTime;  Timer timer2;
-	GLuint bufferID = 0;
+	GLuint bufferIDs[MAX_RING];
 	#ifdef USEIFR
 	NV_IFROGL_TRANSFEROBJECT_HANDLE ifrTransfer = NULL;
 	#endif
 	char temps[STRLEN];
 	size_t bufSize = PAD(drawableWidth * pf->size) * drawableHeight;
+	// Time at which the readback of the frame in each PBO was started
+	double startTime[MAX_RING];
+
+	nLatencies = 0;
+
+	for(int i = 0; i < MAX_RING; i++) bufferIDs[i] = 0;
 
 	try
 	{
@@ -418,30 +749,29 @@ int readTest(int format)
 		glPixelStorei(GL_UNPACK_ALIGNMENT, align);
 		glPixelStorei(GL_PACK_ALIGNMENT, align);
 
-		#ifdef GL_EXT_framebuffer_object
-		if(useFBO) glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
-		else
-		#endif
-		glReadBuffer(GL_FRONT);
+		glReadBuffer(getBuffer());
 
 		if(usePBO)
 		{
 			const char *ext = (const char *)glGetString(GL_EXTENSIONS);
 			if(!ext || !strstr(ext, "GL_ARB_pixel_buffer_object"))
 				THROW("GL_ARB_pixel_buffer_object extension not available");
-			glGenBuffers(1, &bufferID);
-			if(!bufferID) THROW("Could not generate PBO buffer");
-			glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, bufferID);
-			glBufferData(GL_PIXEL_PACK_BUFFER_EXT, bufSize, NULL, GL_STREAM_READ);
-			check_errors("PBO initialization");
-			int temp = 0;
-			glGetBufferParameteriv(GL_PIXEL_PACK_BUFFER_EXT, GL_BUFFER_SIZE,
-				&temp);
-			if((size_t)temp != bufSize)
-				THROW("Could not generate PBO buffer");
-			temp = 0;
-			glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING_EXT, &temp);
-			if(!!temp != usePBO) THROW("Could not bind PBO buffer");
+			glGenBuffers(ringDepth, bufferIDs);
+			for(int i = 0; i < ringDepth; i++)
+			{
+				if(!bufferIDs[i]) THROW("Could not generate PBO buffer");
+				glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, bufferIDs[i]);
+				glBufferData(GL_PIXEL_PACK_BUFFER_EXT, bufSize, NULL, GL_STREAM_READ);
+				check_errors("PBO initialization");
+				int temp = 0;
+				glGetBufferParameteriv(GL_PIXEL_PACK_BUFFER_EXT, GL_BUFFER_SIZE,
+					&temp);
+				if((size_t)temp != bufSize)
+					THROW("Could not generate PBO buffer");
+				temp = 0;
+				glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING_EXT, &temp);
+				if(!!temp != usePBO) THROW("Could not bind PBO buffer");
+			}
 		}
 		#ifdef USEIFR
 		if(useIFR)
@@ -462,22 +792,40 @@ int readTest(int format)
 		memset(rgbaBuffer, 0, bufSize);
 		n = 0;  rbtime = readPixelsTime = 0.;
 		double tmin = 0., tmax = 0., ssq = 0., sum = 0.;  bool first = true;
+		long renderFrames = renderThread ? renderThread->getFrames() : 0;
+		double cpuTime = getCPUTime(), wallTime = timer2.time();
+		// The PBO into which the current frame is read.  With a ring of PBOs,
+		// each PBO is mapped ringDepth - 1 frames after it was read into, which
+		// gives the GPU time to complete the transfer in the background.
+		int ringIndex = 0, pending = 0;
 		do
 		{
 			timer.start();
+			if(usePBO) startTime[ringIndex] = timer.time();
+			#ifdef GL_EXT_framebuffer_object
+			if(msaaSamples > 0) resolveMSAA();
+			#endif
 			if(usePBO)
 			{
 				unsigned char *pixels = NULL;
-				glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, bufferID);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, bufferIDs[ringIndex]);
 				timer2.start();
 				glReadPixels(0, 0, drawableWidth, drawableHeight, glFormat[format],
 					pf_gldatatype[format], NULL);
 				readPixelsTime += timer2.elapsed();
-				pixels = (unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER_EXT,
-					GL_READ_ONLY);
-				if(!pixels) THROW("Could not map buffer");
-				memcpy(rgbaBuffer, pixels, bufSize);
-				glUnmapBuffer(GL_PIXEL_PACK_BUFFER_EXT);
+				ringIndex = (ringIndex + 1) % ringDepth;
+				if(++pending == ringDepth)
+				{
+					// ringIndex now refers to the oldest outstanding frame.
+					glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, bufferIDs[ringIndex]);
+					pixels = (unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER_EXT,
+						GL_READ_ONLY);
+					if(!pixels) THROW("Could not map buffer");
+					memcpy(rgbaBuffer, pixels, bufSize);
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER_EXT);
+					addLatency(timer.time() - startTime[ringIndex]);
+					pending--;
+				}
 			}
 			else
 			#ifdef USEIFR
@@ -487,8 +835,8 @@ int readTest(int format)
 				uintptr_t dataSize = 0;
 
 				timer2.start();
-				if(ifr.nvIFROGLTransferFramebufferToSys(ifrTransfer, useFBO ? fbo : 0,
-					useFBO ? GL_COLOR_ATTACHMENT0_EXT : GL_FRONT,
+				if(ifr.nvIFROGLTransferFramebufferToSys(ifrTransfer,
+					useFBO ? (msaaSamples > 0 ? resolveFBO : fbo) : 0, getBuffer(),
 					NV_IFROGL_TRANSFER_FRAMEBUFFER_FLAG_NONE, 0, 0, 0, 0)
 					!= NV_IFROGL_SUCCESS)
 					THROW("Could not transfer pixels from the framebuffer");
@@ -510,8 +858,12 @@ int readTest(int format)
 					pf_gldatatype[format], rgbaBuffer);
 				readPixelsTime += timer2.elapsed();
 			}
+			#ifdef GL_EXT_framebuffer_object
+			if(msaaSamples > 0) glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+			#endif
 
 			double elapsed = timer.elapsed();
+			if(!usePBO) addLatency(elapsed);
 			if(first)
 			{
 				tmin = tmax = elapsed;  first = false;
@@ -526,7 +878,28 @@ int readTest(int format)
 			ssq += pow((double)(drawableWidth * drawableHeight) /
 				(1000000. * elapsed), 2.0);
 			sum += (double)(drawableWidth * drawableHeight) / (1000000. * elapsed);
-		} while(rbtime < benchTime || n < 2);
+		} while(rbtime < benchTime || n < ringDepth + 1);
+
+		// Retire the frames that are still outstanding in the PBO ring.
+		while(pending > 0)
+		{
+			int index = (ringIndex + ringDepth - pending) % ringDepth;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, bufferIDs[index]);
+			unsigned char *pixels =
+				(unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER_EXT, GL_READ_ONLY);
+			if(!pixels) THROW("Could not map buffer");
+			memcpy(rgbaBuffer, pixels, bufSize);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER_EXT);
+			addLatency(timer.time() - startTime[index]);
+			pending--;
+		}
+		cpuTime = getCPUTime() - cpuTime;
+		wallTime = timer2.time() - wallTime;
+		if(renderThread)
+		{
+			renderThread->checkError();
+			renderFrames = renderThread->getFrames() - renderFrames;
+		}
 
 		if(!cmpBuf(0, 0, drawableWidth, drawableHeight, pf, rgbaBuffer, 0))
 			THROW("ERROR: Bogus data read back.");
@@ -549,6 +922,21 @@ int readTest(int format)
 		fprintf(stderr, "glReadPixels() accounted for %s%% of total readback time\n",
 			sigFig(4, temps, readPixelsTime / rbtime * 100.0));
 
+		qsort(latencies, nLatencies, sizeof(double), compareDouble);
+		fprintf(stderr, "Frame latency (ms): min = %s, ",
+			sigFig(4, temps, percentile(0.) * 1000.));
+		fprintf(stderr, "50%% = %s, ", sigFig(4, temps, percentile(50.) * 1000.));
+		fprintf(stderr, "90%% = %s, ", sigFig(4, temps, percentile(90.) * 1000.));
+		fprintf(stderr, "99%% = %s, ", sigFig(4, temps, percentile(99.) * 1000.));
+		fprintf(stderr, "max = %s\n", sigFig(4, temps, percentile(100.) * 1000.));
+		fprintf(stderr, "CPU time = %s ms/frame ",
+			sigFig(4, temps, cpuTime / (double)nLatencies * 1000.));
+		fprintf(stderr, "(%s%% of wall-clock time)\n",
+			sigFig(4, temps, cpuTime / wallTime * 100.));
+		if(renderThread)
+			fprintf(stderr, "Rendering thread frame rate = %s frames/sec\n",
+				sigFig(4, temps, (double)renderFrames / wallTime));
+
 	}
 	catch(std::exception &e)
 	{
@@ -556,10 +944,11 @@ int readTest(int format)
 	}
 
 	free(rgbaBuffer);
-	if(usePBO && bufferID > 0)
+	if(usePBO)
 	{
 		glBindBuffer(GL_PIXEL_PACK_BUFFER_EXT, 0);
-		glDeleteBuffers(1, &bufferID);
+		for(int i = 0; i < ringDepth; i++)
+			if(bufferIDs[i] > 0) glDeleteBuffers(1, &bufferIDs[i]);
 	}
 	#ifdef USEIFR
 	if(useIFR) ifr.nvIFROGLDestroyTransferObject(ifrTransfer);
@@ -597,6 +986,7 @@ void display(void)
 		fprintf(stderr, "\n");
 	}
 
+	delete renderThread;  renderThread = NULL;
 	exit(status);
 }
 
@@ -610,8 +1000,18 @@ void usage(char **argv)
 	fprintf(stderr, "-fbo = Render to a framebuffer object (FBO) instead of a Pbuffer\n");
 	fprintf(stderr, "-rtt = Render to a texture instead of a renderbuffer object\n");
 	fprintf(stderr, "       (implies -fbo)\n");
+	fprintf(stderr, "-msaa <s> = Render to a multisampled FBO with <s> samples and resolve it into a\n");
+	fprintf(stderr, "            single-sampled FBO prior to each readback (implies -fbo)\n");
+	#endif
+	#ifdef USEEGL
+	fprintf(stderr, "-egl = Render to a Pbuffer on an EGL device rather than using an X server\n");
+	fprintf(stderr, "-device <d> = Use EGL device <d> (default: 0) [implies -egl]\n");
 	#endif
 	fprintf(stderr, "-pbo = Use pixel buffer objects to perform readback\n");
+	fprintf(stderr, "-ring <n> = Use a ring of <n> pixel buffer objects, and map each one <n> - 1\n");
+	fprintf(stderr, "            frames after reading back into it (implies -pbo) [default: 1]\n");
+	fprintf(stderr, "-renderthread = Render continuously in a separate thread (using a separate\n");
+	fprintf(stderr, "                context and drawable) while the tests are running\n");
 	#ifdef USEIFR
 	fprintf(stderr, "-ifr = Use nVidia Inband Frame Readback\n");
 	#endif
@@ -658,8 +1058,30 @@ int main(int argc, char **argv)
 		#ifdef GL_EXT_framebuffer_object
 		else if(!stricmp(argv[i], "-fbo")) useFBO = true;
 		else if(!stricmp(argv[i], "-rtt")) { useRTT = true;  useFBO = true; }
+		else if(!stricmp(argv[i], "-msaa") && i < argc - 1)
+		{
+			msaaSamples = atoi(argv[++i]);
+			if(msaaSamples < 2) usage(argv);
+			useFBO = true;
+		}
+		#endif
+		#ifdef USEEGL
+		else if(!stricmp(argv[i], "-egl")) useEGL = true;
+		else if(!stricmp(argv[i], "-device") && i < argc - 1)
+		{
+			eglDevice = atoi(argv[++i]);
+			if(eglDevice < 0) usage(argv);
+			useEGL = true;
+		}
 		#endif
 		else if(!stricmp(argv[i], "-pbo")) usePBO = true;
+		else if(!stricmp(argv[i], "-ring") && i < argc - 1)
+		{
+			ringDepth = atoi(argv[++i]);
+			if(ringDepth < 1 || ringDepth > MAX_RING) usage(argv);
+			usePBO = true;
+		}
+		else if(!stricmp(argv[i], "-renderthread")) useRenderThread = true;
 		#ifdef USEIFR
 		else if(!stricmp(argv[i], "-ifr")) useIFR = true;
 		#endif
@@ -755,60 +1177,93 @@ int main(int argc, char **argv)
 		usePBO = false;
 	}
 	#endif
+	if(useRTT && msaaSamples > 0)
+	{
+		fprintf(stderr, "Render-to-texture cannot be used with multisampling.  Disabling RTT.\n");
+		useRTT = false;
+	}
+	if(useEGL && (useWindow || usePixmap))
+	{
+		fprintf(stderr, "Windows and pixmaps cannot be used with EGL.  Using a Pbuffer.\n");
+		useWindow = usePixmap = false;
+	}
 
 	if(argc < 2) fprintf(stderr, "\n%s -h for advanced usage.\n", argv[0]);
 
 	try
 	{
-		XSetErrorHandler(xhandler);
-		if(!(dpy = XOpenDisplay(0)))
+		if(!useEGL)
 		{
-			fprintf(stderr, "Could not open display %s\n", XDisplayName(0));
-			exit(1);
+			// The rendering thread uses its own display connection, but Xlib still
+			// has to be thread-safe.
+			if(useRenderThread) XInitThreads();
+			XSetErrorHandler(xhandler);
+			if(!(dpy = XOpenDisplay(0)))
+			{
+				fprintf(stderr, "Could not open display %s\n", XDisplayName(0));
+				exit(1);
+			}
 		}
-		if(usePBO) fprintf(stderr, "Using PBOs for readback\n");
+		if(usePBO)
+		{
+			if(ringDepth > 1)
+				fprintf(stderr, "Using a ring of %d PBOs for readback\n", ringDepth);
+			else fprintf(stderr, "Using PBOs for readback\n");
+		}
+		if(msaaSamples > 0)
+			fprintf(stderr, "Resolving %d-sample FBO prior to readback\n",
+				msaaSamples);
 		#ifdef USEIFR
 		if(useIFR) fprintf(stderr, "Using nVidia Inband Frame Readback\n");
 		#endif
 
-		if((DisplayWidth(dpy, DefaultScreen(dpy)) < drawableWidth
-			|| DisplayHeight(dpy, DefaultScreen(dpy)) < drawableHeight) && useWindow)
-		{
-			fprintf(stderr,
-				"ERROR: Please switch to a screen resolution of at least %d x %d.\n",
-				drawableWidth, drawableHeight);
-			exit(1);
-		}
-
-		int bpc = DefaultDepth(dpy, DefaultScreen(dpy)) == 30 ? 10 : 8;
-		findVisual(bpc);
-		if(bpc != 10)
+		if(useEGL)
 		{
 			for(int format = 0; format < PIXELFORMATS; format++)
 				if(pf_get(format)->bpc == 10) glFormat[format] = GL_NONE;
 		}
-
-		if(useWindow || usePixmap || useFBO)
+		else
 		{
-			XSetWindowAttributes swa;
-			Window root = DefaultRootWindow(dpy);
-			swa.border_pixel = 0;
-			swa.event_mask = 0;
+			if((DisplayWidth(dpy, DefaultScreen(dpy)) < drawableWidth
+				|| DisplayHeight(dpy, DefaultScreen(dpy)) < drawableHeight) && useWindow)
+			{
+				fprintf(stderr,
+					"ERROR: Please switch to a screen resolution of at least %d x %d.\n",
+					drawableWidth, drawableHeight);
+				exit(1);
+			}
 
-			swa.colormap = XCreateColormap(dpy, root, v->visual, AllocNone);
-			ERRIFNOT(win = XCreateWindow(dpy, root, 0, 0,
-				(usePixmap || useFBO) ? 1 : drawableWidth,
-				(usePixmap || useFBO) ? 1 : drawableHeight, 0, v->depth, InputOutput,
-				v->visual, CWBorderPixel | CWColormap | CWEventMask, &swa));
-			if(usePixmap)
+			int bpc = DefaultDepth(dpy, DefaultScreen(dpy)) == 30 ? 10 : 8;
+			findVisual(bpc);
+			if(bpc != 10)
 			{
-				ERRIFNOT(pm = XCreatePixmap(dpy, win, drawableWidth, drawableHeight,
-					v->depth));
+				for(int format = 0; format < PIXELFORMATS; format++)
+					if(pf_get(format)->bpc == 10) glFormat[format] = GL_NONE;
+			}
+
+			if(useWindow || usePixmap || useFBO)
+			{
+				XSetWindowAttributes swa;
+				Window root = DefaultRootWindow(dpy);
+				swa.border_pixel = 0;
+				swa.event_mask = 0;
+
+				swa.colormap = XCreateColormap(dpy, root, v->visual, AllocNone);
+				ERRIFNOT(win = XCreateWindow(dpy, root, 0, 0,
+					(usePixmap || useFBO) ? 1 : drawableWidth,
+					(usePixmap || useFBO) ? 1 : drawableHeight, 0, v->depth, InputOutput,
+					v->visual, CWBorderPixel | CWColormap | CWEventMask, &swa));
+				if(usePixmap)
+				{
+					ERRIFNOT(pm = XCreatePixmap(dpy, win, drawableWidth, drawableHeight,
+						v->depth));
+				}
+				else if(!useFBO) XMapWindow(dpy, win);
+				XSync(dpy, False);
 			}
-			else if(!useFBO) XMapWindow(dpy, win);
-			XSync(dpy, False);
 		}
-		fprintf(stderr, "Rendering to %s (size = %d x %d pixels)\n",
+		fprintf(stderr, "Rendering to %s%s (size = %d x %d pixels)\n",
+			useEGL ? "EGL " : "",
 			(usePixmap ? "Pixmap" :
 				(useWindow ? "Window" :
 					(useFBO ? (useRTT ? "FBO + Texture" : "FBO + RBO") : "Pbuffer"))),
@@ -825,6 +1280,12 @@ int main(int argc, char **argv)
 				THROW("Could not create IFR session");
 		}
 		#endif
+		if(useRenderThread)
+		{
+			fprintf(stderr, "Rendering continuously in a separate thread\n\n");
+			renderThread = new RenderThread;
+			renderThread->start();
+		}
 		display();
 		return 0;
 
@@ -834,17 +1295,29 @@ int main(int argc, char **argv)
 		fprintf(stderr, "%s\n", e.what());
 	}
 
+	delete renderThread;  renderThread = NULL;
+	#ifdef GL_EXT_framebuffer_object
+	if(useFBO && (dpy || useEGL))
+	{
+		if(texture) glDeleteTextures(1, &texture);
+		if(rbo) glDeleteRenderbuffersEXT(1, &rbo);
+		if(resolveRBO) glDeleteRenderbuffersEXT(1, &resolveRBO);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+		if(fbo) glDeleteFramebuffersEXT(1, &fbo);
+		if(resolveFBO) glDeleteFramebuffersEXT(1, &resolveFBO);
+	}
+	#endif
+	#ifdef USEEGL
+	if(edpy != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(edpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if(epb) eglDestroySurface(edpy, epb);
+		if(ectx) eglDestroyContext(edpy, ectx);
+		eglTerminate(edpy);
+	}
+	#endif
 	if(dpy)
 	{
-		#ifdef GL_EXT_framebuffer_object
-		if(useFBO)
-		{
-			if(texture) glDeleteTextures(1, &texture);
-			if(rbo) glDeleteRenderbuffersEXT(1, &rbo);
-			glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
-			if(fbo) glDeleteFramebuffersEXT(1, &fbo);
-		}
-		#endif
 		#ifdef USEIFR
 		if(useIFR)
 		{
@@ -141,6 +141,18 @@ void initBuf(char *buf, int len)
 }
 
 
+#ifdef USESSL
+
+void printKTLSStatus(Socket *socket)
+{
+	printf("Kernel TLS offload:  send %s, receive %s\n",
+		socket->isKTLSSend() ? "enabled" : "disabled",
+		socket->isKTLSRecv() ? "enabled" : "disabled");
+}
+
+#endif
+
+
 int cmpBuf(char *buf, int len)
 {
 	int i;
@@ -154,12 +166,12 @@ void usage(char **argv)
 {
 	fprintf(stderr, "\nUSAGE: %s -client <server name or IP>", argv[0]);
 	#ifdef USESSL
-	fprintf(stderr, " [-ssl]");
+	fprintf(stderr, " [-ssl [-ktls]]");
 	#endif
 	fprintf(stderr, " [-old] [-time <t>]");
 	fprintf(stderr, "\n or    %s -server [-ipv6]", argv[0]);
 	#ifdef USESSL
-	fprintf(stderr, " [-ssl]");
+	fprintf(stderr, " [-ssl [-ktls]]");
 	#endif
 	fprintf(stderr, "\n or    %s -findport\n", argv[0]);
 	#if defined(sun) || defined(linux)
@@ -170,6 +182,9 @@ void usage(char **argv)
 	fprintf(stderr, "\n-old = Communicate with NetTest server v2.1.x or earlier\n");
 	#ifdef USESSL
 	fprintf(stderr, "-ssl = Use secure tunnel\n");
+	fprintf(stderr, "-ktls = Offload SSL encryption to the kernel, if possible (this should\n");
+	fprintf(stderr, "        be specified on both the client and the server in order to\n");
+	fprintf(stderr, "        measure the full effect)\n");
 	#endif
 	fprintf(stderr, "-ipv6 = Use IPv6 sockets\n");
 	fprintf(stderr, "-time <t> = Run each benchmark for <t> seconds (default: %.1f)\n",
@@ -185,6 +200,9 @@ int main(int argc, char **argv)
 	Socket *clientSocket = NULL;
 	char *buf = NULL;  int i, j, size;
 	bool doSSL = false, ipv6 = false, old = false;
+	#ifdef USESSL
+	bool ktls = false;
+	#endif
 	Timer timer;
 	#if defined(sun) || defined(linux)
 	int interval = 2;
@@ -207,6 +225,7 @@ int main(int argc, char **argv)
 					printf("Using %s ...\n", SSLeay_version(SSLEAY_VERSION));
 					doSSL = true;
 				}
+				else if(!stricmp(argv[i], "-ktls")) ktls = true;
 				#endif
 				else if(!stricmp(argv[i], "-old"))
 				{
@@ -233,6 +252,7 @@ int main(int argc, char **argv)
 					doSSL = true;
 					printf("Using %s ...\n", SSLeay_version(SSLEAY_VERSION));
 				}
+				else if(!stricmp(argv[i], "-ktls")) ktls = true;
 				#endif
 				else if(!stricmp(argv[i], "-ipv6"))
 				{
@@ -266,6 +286,10 @@ int main(int argc, char **argv)
 		else usage(argv);
 
 		Socket socket(doSSL, ipv6);
+		#ifdef USESSL
+		if(ktls && !doSSL) usage(argv);
+		socket.setKTLS(ktls);
+		#endif
 		if((buf = (char *)malloc(sizeof(char) * MAXDATASIZE)) == NULL)
 		{
 			printf("Buffer allocation error.\n");  exit(1);
@@ -289,6 +313,9 @@ int main(int argc, char **argv)
 			clientSocket = socket.accept();
 
 			printf("Accepted TCP connection from %s\n", clientSocket->remoteName());
+			#ifdef USESSL
+			if(doSSL) printKTLSStatus(clientSocket);
+			#endif
 
 			clientSocket->recv(buf, 1);
 			if(buf[0] == 'V')
@@ -328,6 +355,9 @@ int main(int argc, char **argv)
 			double elapsed;
 			socket.connect(serverName, PORT);
 
+			#ifdef USESSL
+			if(doSSL) printKTLSStatus(&socket);
+			#endif
 			printf("TCP transfer performance between localhost and %s:\n\n",
 				socket.remoteName());
 			printf("Transfer size  1/2 Round-Trip      Throughput      Throughput\n");
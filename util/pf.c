@@ -1,4 +1,4 @@
-/* Copyright (C)2017-2019, 2021 D. R. Commander
+/* Copyright (C)2017-2019, 2021, 2026 D. R. Commander
  *
  * This library is free software and may be redistributed and/or modified under
  * the terms of the wxWindows Library License, Version 3.1 or (at your option)
@@ -15,6 +15,9 @@
 #include "boost/endian.h"
 #include "vglutil.h"
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 #define PF_RGB_SIZE          3
@@ -152,14 +155,57 @@
 #define PF_X2_RGB10_BINDEX   PF_X2_BGR10_RINDEX
 
 
+/* Copies larger than this use non-temporal stores.  The destination of a
+   large copy (usually an X shared memory image or a network buffer) will not
+   be read again by this CPU core before it is evicted from the cache, so
+   writing it through the cache would only evict the source rows. */
+#define NT_THRESHOLD  (512 * 1024)
+
+static INLINE void copyRows(unsigned char *srcBuf, int wps, int srcStride,
+	int height, unsigned char *dstBuf, int dstStride)
+{
+#ifdef __SSE2__
+	if((size_t)wps * height >= NT_THRESHOLD)
+	{
+		while(height--)
+		{
+			unsigned char *srcPixel = srcBuf, *dstPixel = dstBuf;
+			int n = wps, head = (16 - ((size_t)dstPixel & 15)) & 15;
+
+			if(head > n) head = n;
+			memcpy(dstPixel, srcPixel, head);
+			srcPixel += head;  dstPixel += head;  n -= head;
+			for(; n >= 64; n -= 64, srcPixel += 64, dstPixel += 64)
+			{
+				__m128i v0 = _mm_loadu_si128((__m128i *)srcPixel);
+				__m128i v1 = _mm_loadu_si128((__m128i *)(srcPixel + 16));
+				__m128i v2 = _mm_loadu_si128((__m128i *)(srcPixel + 32));
+				__m128i v3 = _mm_loadu_si128((__m128i *)(srcPixel + 48));
+				_mm_stream_si128((__m128i *)dstPixel, v0);
+				_mm_stream_si128((__m128i *)(dstPixel + 16), v1);
+				_mm_stream_si128((__m128i *)(dstPixel + 32), v2);
+				_mm_stream_si128((__m128i *)(dstPixel + 48), v3);
+			}
+			memcpy(dstPixel, srcPixel, n);
+			srcBuf += srcStride;  dstBuf += dstStride;
+		}
+		/* Non-temporal stores are weakly ordered, so make them visible before
+		   the caller hands the buffer to another thread or process. */
+		_mm_sfence();
+		return;
+	}
+#endif
+	while(height--)
+	{
+		memcpy(dstBuf, srcBuf, wps);
+		srcBuf += srcStride;  dstBuf += dstStride;
+	}
+}
+
 #define CONVERT_FAST(id) \
 { \
-	int wps = width * PF_##id##_SIZE; \
-	while(height--) \
-	{ \
-		memcpy(dstBuf, srcBuf, wps); \
-		srcBuf += srcStride;  dstBuf += dstStride; \
-	} \
+	copyRows(srcBuf, width * PF_##id##_SIZE, srcStride, height, dstBuf, \
+		dstStride); \
 	return; \
 }
 